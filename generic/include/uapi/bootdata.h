@@ -24,6 +24,8 @@ struct bootdata {
 	uint64_t vmap_end;
 	int max_proc;
 	int task_stat_handle;
+	int ipc_stat_handle;
+	int sys_stat_handle;
 };
 
 #endif
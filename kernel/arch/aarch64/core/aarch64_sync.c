@@ -96,8 +96,37 @@ static const char *get_ec_class_string(int ec)
 	return esr_class_str[ec];
 }
 
+/*
+ * the user space is accessed by the unprivileged load/store
+ * in uaccess.S, each of them has a fixup address.
+ */
+struct exception_table_entry {
+	unsigned long insn;
+	unsigned long fixup;
+};
+
+extern struct exception_table_entry __ex_table_start[];
+extern struct exception_table_entry __ex_table_end[];
+
+static int fixup_exception(gp_regs *regs)
+{
+	struct exception_table_entry *ex;
+
+	for (ex = __ex_table_start; ex < __ex_table_end; ex++) {
+		if (ex->insn == regs->pc) {
+			regs->pc = ex->fixup;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
 static int kernel_mem_fault(gp_regs *regs, int ec, uint32_t esr)
 {
+	if ((ec == ESR_ELx_EC_DABT_CUR) && fixup_exception(regs))
+		return 0;
+
 	__panic(regs, "Memory fault in kernel space\n");
 }
 
@@ -122,7 +151,7 @@ static int __handle_user_page_fault(uint64_t addr, int is_write, unsigned long s
 }
 weak_alias(__handle_user_page_fault, handle_user_page_fault);
 
-static int __handle_user_ia_fault(void)
+static int __handle_user_ia_fault(uint64_t addr, unsigned long status)
 {
 	panic("Unsupport User IA Fault\n");
 
@@ -177,12 +206,18 @@ static int user_da_fault(gp_regs *regs, int ec, uint32_t esr)
 
 int user_ia_fault(gp_regs *regs, int ec, uint32_t esr)
 {
+	unsigned long fault_status = esr & ESR_ELx_FSC_TYPE;
 	struct task *task = current;
 
-	pr_err("User instruction abort pid:%d tid:%d ESR:0x%x IP:0x%x\n",
-		task->pid, task->tid, esr, regs->pc);
+	/*
+	 * translation fault may be caused by the text which is
+	 * not paged in yet, the page fault handler will check it.
+	 */
+	if (fault_status != FSC_FAULT)
+		pr_err("User instruction abort pid:%d tid:%d ESR:0x%x IP:0x%x\n",
+			task->pid, task->tid, esr, regs->pc);
 
-	return handle_user_ia_fault();
+	return handle_user_ia_fault(read_sysreg(ARM64_FAR), fault_status);
 }
 
 int user_svc64(gp_regs *regs, int ec, uint32_t esr)
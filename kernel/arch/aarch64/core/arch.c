@@ -140,7 +140,7 @@ static inline uint64_t task_ttbr_value(struct task *task)
 {
 	struct vspace *vs = task->vs;
 
-	return (uint64_t)vtop(vs->pgdp) | ((uint64_t)vs->asid << 48);
+	return (uint64_t)vtop(vs->pgdp) | ((uint64_t)vspace_asid(vs) << 48);
 }
 
 static inline void user_task_sched_out(struct task *task)
@@ -163,6 +163,12 @@ static inline void user_task_sched_in(struct task *task)
 	write_sysreg(c->tpidrro_el0, TPIDRRO_EL0);
 	fpsimd_state_restore(task, &c->fpsimd_state);
 
+	/*
+	 * the asid of the process may be changed when there
+	 * is a rollover, update the ttbr value here.
+	 */
+	vspace_switch_asid(task->vs);
+	c->ttbr_el0 = task_ttbr_value(task);
 	write_sysreg(c->ttbr_el0, TTBR0_EL1);
 }
 
@@ -259,8 +265,17 @@ pgd_t *arch_alloc_process_page_table(void)
 
 int arch_get_asid_size(void)
 {
-       // TBD, get from the register
-       return 256;
+	uint64_t mmfr0 = read_sysreg64(ID_AA64MMFR0_EL1);
+
+	/*
+	 * 16 bit asid can be used only when the cpu supports
+	 * it and TCR_ELx.AS is set.
+	 */
+	if ((((mmfr0 >> 4) & 0xf) == 2) &&
+			(read_sysreg64(ARM64_TCR) & TCR_ASID16))
+		return 65536;
+
+	return 256;
 }
 
 void arch_release_task(struct task *task)
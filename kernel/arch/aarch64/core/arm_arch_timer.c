@@ -92,6 +92,19 @@ unsigned long get_sys_time(void)
 	return ticks_to_ns(read_sysreg64(CNTPCT_EL0));
 }
 
+/*
+ * whether the process can read CNTPCT_EL0 directly, with VHE
+ * bit 0 of CNTHCTL_EL2 is EL0PCTEN.
+ */
+int arch_counter_user_readable(void)
+{
+#if !defined(CONFIG_VIRT) || defined(CONFIG_ARM_VHE)
+	return 1;
+#else
+	return 0;
+#endif
+}
+
 static int __init_text timers_arch_init(void)
 {
 	int i, ret, from_dt;
@@ -183,6 +196,10 @@ static int __init_text timers_init(void)
 
 	sched_timer_info = &timer_info[HYP_TIMER];
 #else
+	/* el0 can read CNTPCT_EL0 and CNTVCT_EL0 */
+	write_sysreg32((1 << 0) | (1 << 1), CNTKCTL_EL1);
+	isb();
+
 	sched_timer_info = &timer_info[VIRT_TIMER];
 #endif
 
@@ -52,12 +52,22 @@ int cpu_has_vhe(void)
 	return vhe_enable;
 }
 
+int cpu_has_tlb_range(void)
+{
+	static int tlb_range = -1;
+
+	if (tlb_range == -1)
+		tlb_range = cpu_has_feature(ARM_FEATURE_TLB_RANGE);
+
+	return tlb_range;
+}
+
 static int arch_cpu_feature_init(void)
 {
 	unsigned long *cf;
 	uint64_t value;
 
-	cf = malloc(BITS_TO_LONGS(CPU_FEATURE_BITS));
+	cf = malloc(BITMAP_SIZE(CPU_FEATURE_BITS));
 	if (!cf)
 		panic("can not allocate memory for cpu feature\n");
 
@@ -68,6 +78,11 @@ static int arch_cpu_feature_init(void)
 	if (value & MPIDR_EL1_MT)
 		set_bit(ARM_FEATURE_MPIDR_SHIFT, cf);
 
+	/* ID_AA64ISAR0_EL1.TLB 0b0010, outer shareable and range tlbi */
+	value = read_sysreg64(ID_AA64ISAR0_EL1);
+	if (((value >> 56) & 0xf) >= 2)
+		set_bit(ARM_FEATURE_TLB_RANGE, cf);
+
 	return 0;
 }
 arch_initcall_percpu(arch_cpu_feature_init);
@@ -17,6 +17,7 @@
 #include <minos/minos.h>
 #include <minos/mm.h>
 #include <asm/tlb.h>
+#include <asm/cpu_feature.h>
 #include <asm/cache.h>
 #include "stage1.h"
 
@@ -300,8 +301,77 @@ static void add_release_page(struct vspace *vs, unsigned long addr)
 	vs->release_pages = page;
 }
 
+/*
+ * the tlb entries are not flushed when each entry is cleared
+ * during the unmap walk, the range is recorded here and flushed
+ * once when the walk is finished. The page table pages and the
+ * memory pages are released after the flush.
+ */
+struct stage1_tlb_gather {
+	unsigned long start;
+	unsigned long end;
+	int global;
+};
+
+/*
+ * flush all the tlb entries of the asid if the range is
+ * larger than this and the cpu does not support range tlbi.
+ */
+#define TLB_GATHER_MAX_PAGES	64
+
+static inline void tlb_gather_init(struct stage1_tlb_gather *tlb)
+{
+	tlb->start = ~0UL;
+	tlb->end = 0;
+	tlb->global = 0;
+}
+
+static inline void tlb_gather_add(struct stage1_tlb_gather *tlb,
+		unsigned long addr, size_t size, uint64_t old)
+{
+	if (addr < tlb->start)
+		tlb->start = addr;
+	if (addr + size > tlb->end)
+		tlb->end = addr + size;
+	if (!(old & S1_nG))
+		tlb->global = 1;
+}
+
+static void tlb_gather_flush(struct vspace *vs, struct stage1_tlb_gather *tlb)
+{
+	unsigned long pages;
+	uint16_t asid = vspace_asid(vs);
+	int range = cpu_has_tlb_range();
+
+	if (tlb->start >= tlb->end)
+		return;
+
+	/* the kernel mappings are global, flush them by va */
+	if (tlb->global) {
+		flush_tlb_va_host(tlb->start, tlb->end - tlb->start);
+		return;
+	}
+
+	/*
+	 * the asid is allocated when the process runs at the first
+	 * time, there is no tlb entry for it before that.
+	 */
+	if (asid == 0) {
+		__dsb(ishst);
+		return;
+	}
+
+	pages = (tlb->end - tlb->start) >> PAGE_SHIFT;
+	if ((range && (pages >= TLBI_RANGE_MAX_PAGES)) ||
+			(!range && (pages > TLB_GATHER_MAX_PAGES)))
+		flush_tlb_asid_all(asid);
+	else
+		flush_tlb_asid_va_range(asid, tlb->start, pages, range);
+}
+
 static void stage1_unmap_pte_range(struct vspace *vs, pte_t *ptep,
-		unsigned long addr, unsigned long end, int flags)
+		unsigned long addr, unsigned long end,
+		struct stage1_tlb_gather *tlb)
 {
 	pte_t *pte;
 
@@ -310,7 +380,10 @@ static void stage1_unmap_pte_range(struct vspace *vs, pte_t *ptep,
 	do {
 		if (!stage1_pte_none(*pte)) {
 			pte_t old_pte = *pte;
-			stage1_set_pte(pte, 0);
+
+			/* the dsb is done once when flush the tlb */
+			WRITE_ONCE(*pte, 0);
+			tlb_gather_add(tlb, addr, PAGE_SIZE, old_pte);
 
 			/* pfnmap and shared page don not free the page */
 			if (!(old_pte & S1_PFNMAP) && !(old_pte & S1_SHARED))
@@ -320,7 +393,8 @@ static void stage1_unmap_pte_range(struct vspace *vs, pte_t *ptep,
 }
 
 static void stage1_unmap_pmd_range(struct vspace *vs, pmd_t *pmdp,
-		unsigned long addr, unsigned long end, int flags)
+		unsigned long addr, unsigned long end,
+		struct stage1_tlb_gather *tlb)
 {
 	unsigned long next;
 	pmd_t *pmd;
@@ -334,40 +408,49 @@ static void stage1_unmap_pmd_range(struct vspace *vs, pmd_t *pmdp,
 			if (stage1_pmd_huge(*pmd)) {
 				pmd_t old_pmd = *pmd;
 				stage1_pmd_clear(pmd);
+				tlb_gather_add(tlb, addr, next - addr, old_pmd);
 				if (!(old_pmd & S1_PFNMAP) && !(old_pmd & S1_SHARED))
 					add_release_page(vs, ptov(stage1_phy_pte(old_pmd)));
 			} else {
 				ptep = (pte_t *)ptov(stage1_pte_table_addr(*pmd));
-				stage1_unmap_pte_range(vs, ptep, addr, next, flags);
-				if (next - addr == S1_PMD_SIZE)
+				stage1_unmap_pte_range(vs, ptep, addr, next, tlb);
+				if (next - addr == S1_PMD_SIZE) {
+					stage1_pmd_clear(pmd);
+					tlb_gather_add(tlb, addr, next - addr, S1_nG);
 					add_release_page(vs, (unsigned long)ptep);
+				}
 			}
 		}
 	} while (pmd++, addr = next, addr != end);
 }
 
 static int stage1_unmap_pud_range(struct vspace *vs,
-		unsigned long addr, unsigned long end, int flags)
+		unsigned long start, unsigned long end, int flags)
 {
-	unsigned long next;
+	struct stage1_tlb_gather tlb;
+	unsigned long next, addr = start;
 	pud_t *pud;
 	pmd_t *pmdp;
 
-	pud = stage1_pud_offset((pud_t *)vs->pgdp, end);
+	tlb_gather_init(&tlb);
+
+	pud = stage1_pud_offset((pud_t *)vs->pgdp, addr);
 	do {
 		next = stage1_pud_addr_end(addr, end);
 		if (!stage1_pud_none(*pud)) {
 			pmdp = (pmd_t *)ptov(stage1_pmd_table_addr(*pud));
-			stage1_unmap_pmd_range(vs, pmdp, addr, next, flags);
-			if (next - addr == S1_PUD_SIZE)
+			stage1_unmap_pmd_range(vs, pmdp, addr, next, &tlb);
+			if (next - addr == S1_PUD_SIZE) {
+				stage1_pud_clear(pud);
 				add_release_page(vs, (unsigned long)pmdp);
+			}
 		}
 	} while (pud++, addr = next, addr != end);
 
-	flush_tlb_asid_all(vs->asid);
+	tlb_gather_flush(vs, &tlb);
 
 	if (vs->notifier_ops && vs->notifier_ops->unmap_range)
-		vs->notifier_ops->unmap_range(vs, addr, end, flags);
+		vs->notifier_ops->unmap_range(vs, start, end, flags);
 
 	return 0;
 }
@@ -549,7 +632,7 @@ static inline phy_addr_t stage1_va_to_pa(struct vspace *vs, unsigned long va)
 
 	if (stage1_pmd_huge(*pmdp)) {
 		phy = ((*pmdp) & S1_PHYSICAL_MASK) + pmd_offset;
-		return 0;
+		return phy;
 	}
 
 	ptep = stage1_pte_offset(ptov(stage1_pte_table_addr(*pmdp)), va);
@@ -97,6 +97,7 @@
  * orr	x1, x1, #(1 << 26)	// ORGN1 : Normal memory, Outer Write-Back Write-Allocate Cacheable
  * orr	x1, x1, #(3 << 28)	// Inner shareable
  * orr	x1, x1, #(2 << 30)	// 4KB Granule size
+ * orr	x1, x1, #(1 << 36)	// 16 bit ASID
  * orr	x1, x1, #(1 << 37)	// Top bit do not used for address caculate for TTBR0_EL1 (user space).
  * orr	x1, x1, #(0 << 38)	// Top bit used for address caculate for TTBR1_EL1 (kernel space).
  * orr	x1, x1, #0x10		// VA 48 bit address range t0sz
@@ -106,6 +107,6 @@
  * ldr	x2, =(5 << 32)		// 256TB IPS
  * orr	x1, x1, x2
  */
-#define ARM64_TCR_VALUE		0x25B5103510
+#define ARM64_TCR_VALUE		0x35B5103510
 
 #endif
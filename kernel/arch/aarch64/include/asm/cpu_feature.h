@@ -2,8 +2,10 @@
 #define __MINOS_CPU_FEATURE_H__
 
 #define ARM_FEATURE_MPIDR_SHIFT	0
+#define ARM_FEATURE_TLB_RANGE	2
 
 int cpu_has_feature(int feature);
 int cpu_has_vhe(void);
+int cpu_has_tlb_range(void);
 
 #endif
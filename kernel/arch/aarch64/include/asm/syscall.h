@@ -29,8 +29,17 @@
 
 #define __NR_clone 20
 
+#define __NR_kobject_send_grant 21
+
+#define __NR_kobject_send_fast 22
+#define __NR_kobject_recv_fast 23
+#define __NR_kobject_reply_fast 24
+
+#define __NR_kobject_recvv 25
+#define __NR_kobject_replyv 26
+
 #undef __NR_syscalls
-#define __NR_syscalls 21
+#define __NR_syscalls 27
 
 struct syscall_regs {
 	unsigned long regs[8];
@@ -10,5 +10,6 @@ unsigned long get_sys_time(void);
 unsigned long get_current_time(void);
 unsigned long get_sys_ticks(void);
 void arch_enable_timer(unsigned long e);
+int arch_counter_user_readable(void);
 
 #endif
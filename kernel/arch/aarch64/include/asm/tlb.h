@@ -41,6 +41,58 @@ static inline void flush_all_tlb_host(void)
 #endif
 }
 
+/*
+ * range tlbi (armv8.4) invalidates (num + 1) << (5 * scale + 1)
+ * pages with one instruction.
+ */
+#define TLBI_RANGE_PAGES(num, scale)	\
+	((unsigned long)((num) + 1) << (5 * (scale) + 1))
+#define TLBI_RANGE_NUM(pages, scale)	\
+	((int)(((pages) >> (5 * (scale) + 1)) & 0x1f) - 1)
+#define TLBI_RANGE_MAX_PAGES		TLBI_RANGE_PAGES(31, 3)
+
+/*
+ * tlbi rvae1is, use the sys encoding since the old assembler
+ * does not know the range tlbi instructions.
+ */
+#define __tlbi_rvae1is(arg)	\
+	asm volatile("sys #0, c8, c2, #1, %0" : : "r" (arg) : "memory")
+
+static inline void flush_tlb_asid_va_range(uint16_t asid,
+		unsigned long va, unsigned long pages, int tlbi_range)
+{
+	unsigned long arg;
+	int scale = 0, num;
+
+	dsb();
+
+	while (pages > 0) {
+		if (!tlbi_range || (pages % 2) == 1) {
+			arg = (va >> PAGE_SHIFT) | ((unsigned long)asid << 48);
+			asm volatile("tlbi vae1is, %0;" : : "r" (arg) : "memory");
+			va += PAGE_SIZE;
+			pages--;
+			continue;
+		}
+
+		num = TLBI_RANGE_NUM(pages, scale);
+		if (num >= 0) {
+			arg = ((va >> PAGE_SHIFT) & ((1UL << 37) - 1)) |
+				((unsigned long)num << 39) |
+				((unsigned long)scale << 44) |
+				(1UL << 46) |	/* 4K granule */
+				((unsigned long)asid << 48);
+			__tlbi_rvae1is(arg);
+			va += TLBI_RANGE_PAGES(num, scale) << PAGE_SHIFT;
+			pages -= TLBI_RANGE_PAGES(num, scale);
+		}
+		scale++;
+	}
+
+	dsb();
+	isb();
+}
+
 static inline void flush_local_tlb_host(void)
 {
 #ifdef CONFIG_VIRT
@@ -54,7 +106,7 @@ static inline void flush_local_tlb_host(void)
 #else
 	asm volatile (
 		"dsb sy;"
-		"tlbi alle2;"
+		"tlbi vmalle1;"
 		"dsb sy;"
 		"isb;"
 		: : : "memory"
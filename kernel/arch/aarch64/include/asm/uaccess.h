@@ -28,4 +28,15 @@ static inline unsigned long user_ranges_ok(const void __user *addr, unsigned lon
 	return ret;
 }
 
+/*
+ * access the user space of current process with ldtr/sttr,
+ * see arch/aarch64/core/uaccess.S. The copy functions return
+ * the number of bytes which are not copied.
+ */
+unsigned long __arch_copy_from_user(void *to,
+		const void __user *from, size_t n);
+unsigned long __arch_copy_to_user(void __user *to,
+		const void *from, size_t n);
+int __arch_get_user_u64(unsigned long *val, const void __user *addr);
+
 #endif
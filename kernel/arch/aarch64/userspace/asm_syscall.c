@@ -21,6 +21,8 @@
 #include <uspace/poll.h>
 #include <uspace/syscall.h>
 #include <uspace/kobject.h>
+#include <uspace/iqueue.h>
+#include <uspace/sysstat.h>
 
 struct aarch64_syscall_reg {
 	unsigned long regs[8];
@@ -72,6 +74,73 @@ static void __sys_kobject_send(gp_regs *regs)
 			(uint32_t)regs->x5);
 }
 
+static void __sys_kobject_send_grant(gp_regs *regs)
+{
+	regs->x0 = sys_kobject_send_grant(
+			(int)regs->x0,
+			(void __user *)regs->x1,
+			(size_t)regs->x2,
+			(struct kobject_grant __user *)regs->x3,
+			(int)regs->x4,
+			(uint32_t)regs->x5);
+}
+
+/*
+ * the fast path ipc use x1 - x6 to pass the message and the
+ * reply, x7 is the timeout or the token.
+ */
+static void __sys_kobject_send_fast(gp_regs *regs)
+{
+	struct ipc_fast fast;
+
+	memcpy(fast.msg, &regs->x1, sizeof(fast.msg));
+	memset(fast.reply, 0, sizeof(fast.reply));
+
+	regs->x0 = sys_kobject_send_fast((handle_t)regs->x0,
+			&fast, (uint32_t)regs->x7);
+
+	memcpy(&regs->x1, fast.reply, sizeof(fast.reply));
+	regs->x6 = 0;
+}
+
+static void __sys_kobject_recv_fast(gp_regs *regs)
+{
+	struct ipc_fast fast;
+
+	memset(fast.msg, 0, sizeof(fast.msg));
+
+	regs->x0 = sys_kobject_recv_fast((handle_t)regs->x0,
+			&fast, (uint32_t)regs->x7);
+
+	memcpy(&regs->x1, fast.msg, sizeof(fast.msg));
+}
+
+static void __sys_kobject_reply_fast(gp_regs *regs)
+{
+	struct ipc_fast fast;
+
+	memcpy(fast.reply, &regs->x2, sizeof(fast.reply));
+
+	regs->x0 = sys_kobject_reply_fast((handle_t)regs->x0,
+			(unsigned long)regs->x7,
+			(long)regs->x1, &fast);
+}
+
+static void __sys_kobject_recvv(gp_regs *regs)
+{
+	regs->x0 = sys_kobject_recvv((handle_t)regs->x0,
+			(struct kobject_recv_vec __user *)regs->x1,
+			(int)regs->x2,
+			(uint32_t)regs->x3);
+}
+
+static void __sys_kobject_replyv(gp_regs *regs)
+{
+	regs->x0 = sys_kobject_replyv((handle_t)regs->x0,
+			(struct kobject_reply_vec __user *)regs->x1,
+			(int)regs->x2);
+}
+
 static void __sys_kobject_reply(gp_regs *regs)
 {
 	regs->x0 = sys_kobject_reply(
@@ -194,7 +263,13 @@ static syscall_handler_t __syscall_table[] = {
 	[__NR_kobject_create]		= __sys_kobject_create,
 	[__NR_kobject_reply]		= __sys_kobject_reply,
 	[__NR_kobject_send]		= __sys_kobject_send,
+	[__NR_kobject_send_grant]	= __sys_kobject_send_grant,
+	[__NR_kobject_send_fast]	= __sys_kobject_send_fast,
+	[__NR_kobject_recv_fast]	= __sys_kobject_recv_fast,
+	[__NR_kobject_reply_fast]	= __sys_kobject_reply_fast,
 	[__NR_kobject_recv]		= __sys_kobject_recv,
+	[__NR_kobject_recvv]		= __sys_kobject_recvv,
+	[__NR_kobject_replyv]		= __sys_kobject_replyv,
 	[__NR_kobject_close]		= __sys_kobject_close,
 	[__NR_kobject_ctl]		= __sys_kobject_ctl,
 	[__NR_kobject_mmap]		= __sys_kobject_mmap,
@@ -220,15 +295,19 @@ static syscall_handler_t __syscall_table[] = {
 
 void aarch64_do_syscall(gp_regs *regs)
 {
-	int nr = regs->x8;
-
-	arch_enable_local_irq();
+	unsigned long nr = regs->x8;
+	unsigned long start;
 
 	if (nr >= __NR_syscalls) {
 		regs->x0 = -EINVAL;
 		return;
 	}
+
+	start = syscall_stat_enter(nr);
+	arch_enable_local_irq();
+
 	__syscall_table[nr](regs);
 
 	arch_disable_local_irq();
+	syscall_stat_exit(nr, start);
 }
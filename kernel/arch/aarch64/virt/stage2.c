@@ -223,16 +223,53 @@ static inline uint64_t stage2_page_attr(unsigned long flags)
 	return pte;
 }
 
+/*
+ * the tlb of the vm is flushed once after the whole unmap walk,
+ * the page table pages are freed after the flush.
+ */
+struct stage2_tlb_gather {
+	int need_flush;
+	struct page *free_pages;
+};
+
+static inline void stage2_tlb_gather_free(struct stage2_tlb_gather *tlb,
+		void *addr)
+{
+	struct page *page = addr_to_page((unsigned long)addr);
+
+	ASSERT(page != NULL);
+	page->next = tlb->free_pages;
+	tlb->free_pages = page;
+}
+
+static void stage2_tlb_gather_finish(struct mm_struct *vs,
+		struct stage2_tlb_gather *tlb)
+{
+	struct page *page = tlb->free_pages, *tmp;
+
+	if (tlb->need_flush)
+		flush_all_tlb_mm(vs);
+
+	while (page) {
+		tmp = page->next;
+		__free_pages(page);
+		page = tmp;
+	}
+}
+
 static void stage2_unmap_pte_range(struct mm_struct *vs, pte_t *ptep,
-		unsigned long addr, unsigned long end)
+		unsigned long addr, unsigned long end,
+		struct stage2_tlb_gather *tlb)
 {
 	pte_t *pte;
 
 	pte = stage2_pte_offset(ptep, addr);
 
 	do {
-		if (!stage2_pte_none(*pte))
+		if (!stage2_pte_none(*pte)) {
 			stage2_set_pte(pte, 0);
+			tlb->need_flush = 1;
+		}
 	} while (pte++, addr += PAGE_SIZE, addr != end);
 }
 
@@ -251,7 +288,8 @@ static inline bool is_pud_range(unsigned long start, unsigned long end)
 }
 
 static void stage2_unmap_pmd_range(struct mm_struct *vs, pmd_t *pmdp,
-		unsigned long addr, unsigned long end)
+		unsigned long addr, unsigned long end,
+		struct stage2_tlb_gather *tlb)
 {
 	unsigned long next;
 	pmd_t *pmd;
@@ -262,14 +300,15 @@ static void stage2_unmap_pmd_range(struct mm_struct *vs, pmd_t *pmdp,
 	do {
 		next = stage2_pmd_addr_end(addr, end);
 		if (!stage2_pmd_none(*pmd)) {
+			tlb->need_flush = 1;
 			if (stage2_pmd_huge(*pmd)) {
 				stage2_pmd_clear(pmd);
 			} else {
 				ptep = (pte_t *)ptov(stage2_pte_table_addr(*pmd));
-				stage2_unmap_pte_range(vs, ptep, addr, next);
+				stage2_unmap_pte_range(vs, ptep, addr, next, tlb);
 				if (is_pmd_range(addr, next)) {
 					stage2_pmd_clear(pmd);
-					free_pages(ptep);
+					stage2_tlb_gather_free(tlb, ptep);
 				}
 			}
 		}
@@ -278,24 +317,25 @@ static void stage2_unmap_pmd_range(struct mm_struct *vs, pmd_t *pmdp,
 
 static int stage2_unmap_pud_range(struct mm_struct *vs, unsigned long addr, unsigned long end)
 {
+	struct stage2_tlb_gather tlb = { 0 };
 	unsigned long next;
 	pud_t *pud;
 	pmd_t *pmdp;
 
-	pud = stage2_pud_offset((pud_t *)vs->pgdp, end);
+	pud = stage2_pud_offset((pud_t *)vs->pgdp, addr);
 	do {
 		next = stage2_pud_addr_end(addr, end);
 		if (!stage2_pud_none(*pud)) {
 			pmdp = (pmd_t *)ptov(stage2_pmd_table_addr(*pud));
-			stage2_unmap_pmd_range(vs, pmdp, addr, next);
+			stage2_unmap_pmd_range(vs, pmdp, addr, next, &tlb);
 			if (is_pud_range(addr, next)) {
 				stage2_pud_clear(pud);
-				free_pages(pmdp);
+				stage2_tlb_gather_free(&tlb, pmdp);
 			}
 		}
 	} while (pud++, addr = next, addr != end);
 
-	flush_all_tlb_mm(vs);
+	stage2_tlb_gather_finish(vs, &tlb);
 
 	return 0;
 }
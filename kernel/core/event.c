@@ -46,6 +46,27 @@ void event_init(struct event *event, int type, void *pdata)
 	init_list(&event->wait_list);
 	event->data = pdata;
 	event->owner = 0;
+	event->flags = 0;
+}
+
+/*
+ * the waiters of a priority event are sorted by the task
+ * priority, the same priority waiters are still in fifo order.
+ */
+static void event_add_waiter(struct event *ev, struct task *task)
+{
+	struct task *tmp;
+
+	if (ev->flags & OS_EVENT_FLAGS_PRIO) {
+		list_for_each_entry(tmp, &ev->wait_list, event_list) {
+			if (tmp->prio > task->prio) {
+				list_insert_before(&tmp->event_list, &task->event_list);
+				return;
+			}
+		}
+	}
+
+	list_add_tail(&ev->wait_list, &task->event_list);
 }
 
 void __wait_event(void *ev, int mode, uint32_t to)
@@ -63,7 +84,7 @@ void __wait_event(void *ev, int mode, uint32_t to)
 		task->flag_node = ev;
 	} else {
 		event = (struct event *)ev;
-		list_add_tail(&event->wait_list, &task->event_list);
+		event_add_waiter(event, task);
 	}
 
 	/*
@@ -147,6 +168,27 @@ struct task *wake_up_one_event_waiter(struct event *ev,
 	return task;
 }
 
+/*
+ * wake up one waiter which last ran on the cpu, if there is no
+ * such waiter, wake up the first one.
+ */
+struct task *wake_up_one_event_waiter_on(struct event *ev,
+		int cpu, long msg, int pend_state)
+{
+	struct task *task, *tmp;
+
+	list_for_each_entry_safe(task, tmp, &ev->wait_list, event_list) {
+		if (task->cpu != cpu)
+			continue;
+
+		list_del(&task->event_list);
+		if (!__wake_up(task, pend_state, (unsigned long)msg))
+			return task;
+	}
+
+	return wake_up_one_event_waiter(ev, msg, pend_state);
+}
+
 void event_pend_down(void)
 {
 	struct task *task = current;
@@ -169,6 +211,24 @@ long __wake(struct event *ev, int pend_state, long retcode)
 	return task ? 0 : -ENOENT;
 }
 
+/*
+ * wake up the waiter and let it run next on this cpu when
+ * the current task sched out.
+ */
+long wake_yield(struct event *ev, long retcode)
+{
+	unsigned long flags;
+	struct task *task;
+
+	spin_lock_irqsave(&ev->lock, flags);
+	task = wake_up_one_event_waiter(ev, retcode, TASK_STATE_PEND_OK);
+	if (task)
+		sched_yield_to(task);
+	spin_unlock_irqrestore(&ev->lock, flags);
+
+	return task ? 0 : -ENOENT;
+}
+
 long do_wait_event(struct event *ev)
 {
 	long ret = 0;
@@ -254,12 +254,17 @@ static struct page *__alloc_pages_from_section(struct mem_section *section,
 	struct page *page;
 	int bit;
 
+	/*
+	 * the alignment is for the physical address, the section
+	 * may not start at an aligned address.
+	 */
 	if (count == 1)
 		bit = find_next_zero_bit_loop(section->bitmap, section->total_cnt,
 				section->bm_current);
 	else
-		bit = bitmap_find_next_zero_area_align(section->bitmap,
-				section->total_cnt, 0, count, align);
+		bit = bitmap_find_next_zero_area_off(section->bitmap,
+				section->total_cnt, 0, count, align - 1,
+				(section->phy_base >> PAGE_SHIFT) & (align - 1));
 	if (bit >= section->total_cnt)
 		return NULL;
 
@@ -328,7 +333,8 @@ struct page *__alloc_pages(int pages, int align, int flags)
 
 	page = alloc_pages_from_section(pages, align, flags);
 	if (!page) {
-		pr_warn("no more pages\n");
+		if (!(flags & __GFP_NOWARN))
+			pr_warn("no more pages\n");
 		return NULL;
 	}
 
@@ -262,6 +262,24 @@ static struct task *pick_next_task(struct pcpu *pcpu)
 	 */
 	prio = ffs_one_table[pcpu->local_rdy_grp];
 	ASSERT(prio != -1);
+
+	/*
+	 * the task which the current task handed the cpu to, it
+	 * can run if there is no higher priority task ready. the
+	 * task may have blocked, migrated or exited after the hint
+	 * was set, only use it when it is still ready on this cpu.
+	 */
+	task = pcpu->yield_to;
+	pcpu->yield_to = NULL;
+	if (task && (task->state == TASK_STATE_READY) &&
+			(task->cpu == pcpu->pcpu_id) &&
+			(task->state_list.next != NULL) &&
+			(task->prio <= prio)) {
+		list_del(&task->state_list);
+		list_add_tail(&pcpu->ready_list[task->prio], &task->state_list);
+		return task;
+	}
+
 	head = &pcpu->ready_list[prio];
 
 	/*
@@ -327,6 +345,62 @@ static void switch_to_task(struct task *cur, struct task *next)
 	arch_task_sched_in(next);
 }
 
+/*
+ * hand the cpu to the task which is just waked up by the current
+ * task, it will be picked up at the next sched on this cpu. if the
+ * task is not ready on this cpu, it will be ignored.
+ */
+void sched_yield_to(struct task *task)
+{
+	struct pcpu *pcpu;
+
+	preempt_disable();
+	pcpu = get_pcpu();
+	if ((task != current) && (task->cpu == pcpu->pcpu_id) &&
+			(task->state_list.next != NULL))
+		pcpu->yield_to = task;
+	preempt_enable();
+}
+
+/*
+ * change the priority of the current task, the server thread
+ * runs at the priority of the client which it is serving.
+ */
+void sched_set_prio(int prio)
+{
+	struct task *task = current;
+	unsigned long flags;
+	struct pcpu *pcpu;
+
+	if (task->prio == prio)
+		return;
+
+	local_irq_save(flags);
+	pcpu = get_pcpu();
+
+	list_del(&task->state_list);
+	if (is_list_empty(&pcpu->ready_list[task->prio]))
+		pcpu->local_rdy_grp &= ~BIT(task->prio);
+	pcpu->tasks_in_prio[task->prio]--;
+
+	task->prio = prio;
+	pcpu->tasks_in_prio[prio]++;
+	list_add_tail(&pcpu->ready_list[prio], &task->state_list);
+	mb();
+	pcpu->local_rdy_grp |= BIT(prio);
+
+	sched_update_sched_timer();
+
+	/*
+	 * a higher priority task may be ready if the priority
+	 * of the current task is lowered.
+	 */
+	if (ffs_one_table[pcpu->local_rdy_grp] < prio)
+		set_need_resched();
+
+	local_irq_restore(flags);
+}
+
 static void sched_tick_handler(unsigned long data)
 {
 	struct task *task = current;
@@ -74,6 +74,56 @@ static int sem_post_opt(sem_t *sem, int pend_state, int opt)
 	return ret;
 }
 
+/*
+ * post the sem, if a waiter is waked up on this cpu, let it
+ * run next when the current task sched out.
+ */
+int sem_post_yield(sem_t *sem)
+{
+	unsigned long flags;
+	struct task *task;
+	int ret = 0;
+
+	spin_lock_irqsave(&sem->lock, flags);
+	task = wake_up_one_event_waiter(TO_EVENT(sem), 0, TASK_STATE_PEND_OK);
+	if (task)
+		sched_yield_to(task);
+	else if (sem->cnt < INT_MAX)
+		sem->cnt++;
+	else
+		ret = -EOVERFLOW;
+	spin_unlock_irqrestore(&sem->lock, flags);
+
+	return ret;
+}
+
+/*
+ * post the sem, prefer the waiter which last ran on this cpu,
+ * then the data it will touch may be still in the cache.
+ */
+int sem_post_local(sem_t *sem)
+{
+	unsigned long flags;
+	struct task *task;
+	int ret = 0;
+
+	spin_lock_irqsave(&sem->lock, flags);
+	task = wake_up_one_event_waiter_on(TO_EVENT(sem),
+			smp_processor_id(), 0, TASK_STATE_PEND_OK);
+	if (!task) {
+		if (sem->cnt < INT_MAX)
+			sem->cnt++;
+		else
+			ret = -EOVERFLOW;
+	}
+	spin_unlock_irqrestore(&sem->lock, flags);
+
+	if (task)
+		cond_resched();
+
+	return ret;
+}
+
 /*
  * the sem is broken, wake up all the waiter.
  */
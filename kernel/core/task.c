@@ -104,6 +104,7 @@ static void task_init(struct task *task, char *name,
 
 	task->tid = tid;
 	task->prio = prio;
+	task->orig_prio = prio;
 	task->pend_state = 0;
 	task->flags = opt;
 	task->pdata = arg;
@@ -164,9 +165,18 @@ static void task_create_hook(struct task *task, void *pdata)
 
 void task_exit_from_user(gp_regs *regs)
 {
+       extern void iqueue_prio_exit_from_user(struct task *task);
        struct task *task = current;
 
        ASSERT(!(task->flags & TASK_FLAGS_KERNEL));
+
+       /*
+        * the task is running at the priority inherited from an
+        * ipc sender, check whether the request is finished.
+        */
+       if (task->prio_iqueue)
+               iqueue_prio_exit_from_user(task);
+
        if (task->exit_from_user)
                task->exit_from_user(task, regs);
 }
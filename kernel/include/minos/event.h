@@ -10,6 +10,8 @@
 
 #define WAKEUP_ALL (-1)
 
+#define OS_EVENT_FLAGS_PRIO 0x1		/* waiters are sorted by task priority */
+
 enum {
 	OS_EVENT_TYPE_NORMAL,
 	OS_EVENT_TYPE_MBOX,
@@ -30,6 +32,7 @@ struct event {
 	int type;				/* event type */
 	tid_t owner;				/* event owner the tid */
 	uint32_t cnt;				/* event cnt */
+	int flags;				/* event flags */
 	void *data;				/* event pdata for transfer */
 	spinlock_t lock;			/* the lock of the event for smp */
 	struct list_head wait_list;		/* non realtime task waitting list */
@@ -52,6 +55,9 @@ int __wake_up_event_waiter(struct event *ev,
 struct task *wake_up_one_event_waiter(struct event *ev,
 		long msg, int pend_state);
 
+struct task *wake_up_one_event_waiter_on(struct event *ev,
+		int cpu, long msg, int pend_state);
+
 #define wake_up_event_waiter(ev, msg, pend_state, num) \
 	__wake_up_event_waiter(TO_EVENT(ev), msg, pend_state, num)
 
@@ -92,6 +98,7 @@ __out1: __ret;							\
 })
 
 long __wake(struct event *ev, int pend_state, long retcode);
+long wake_yield(struct event *ev, long retcode);
 
 #define wake(ev, retcode) __wake(ev, TASK_STATE_PEND_OK, retcode)
 #define wake_abort(ev) __wake(ev, TASK_STATE_PEND_ABORT, -EABORT)
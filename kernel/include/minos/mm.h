@@ -18,7 +18,12 @@ struct mm_notifier_ops {
 struct vspace {
 	pgd_t *pgdp;
 	spinlock_t lock;
-	uint16_t asid;
+
+	/*
+	 * low 16 bits is the hardware asid, the high bits is the
+	 * generation of the asid, see vspace_switch_asid().
+	 */
+	unsigned long asid;
 
 	/*
 	 * indicate that the vspace is used in kernel, means
@@ -31,8 +36,12 @@ struct vspace {
 	void *pdata;
 };
 
+#define vspace_asid(vs)		((uint16_t)((vs)->asid & 0xffff))
+
 void release_vspace_pages(struct vspace *vs);
 
+void vspace_switch_asid(struct vspace *vs);
+
 int create_host_mapping(unsigned long vir, unsigned long phy,
 		size_t size, unsigned long flags);
 
@@ -13,6 +13,7 @@
 #define __GFP_SLAB		0x00000020
 #define __GFP_HUGE		0x00000040
 #define __GFP_IO		0x00000080
+#define __GFP_NOWARN		0x00010000	/* caller will fallback, not record in page */
 
 #define GFP_KERNEL		__GFP_KERNEL
 #define GFP_USER		__GFP_USER
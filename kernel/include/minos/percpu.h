@@ -40,6 +40,7 @@ struct pcpu {
 	struct list_head stop_list;
 	struct task *running_task;
 	struct task *idle_task;
+	struct task *yield_to;
 	uint32_t nr_pcpu_task;
 
 	uint8_t local_rdy_grp;
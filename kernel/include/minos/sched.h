@@ -12,6 +12,8 @@ struct process;
 
 void sched(void);
 void cond_resched(void);
+void sched_yield_to(struct task *task);
+void sched_set_prio(int prio);
 int sched_init(void);
 int local_sched_init(void);
 void pcpu_resched(int pcpu_id);
@@ -14,6 +14,8 @@ uint32_t sem_accept(sem_t *sem);
 int sem_pend(sem_t *sem, uint32_t timeout);
 int sem_pend_abort(sem_t *sem, int opt);
 int sem_post(sem_t *sem);
+int sem_post_yield(sem_t *sem);
+int sem_post_local(sem_t *sem);
 
 static void inline sem_init(sem_t *sem, uint32_t cnt)
 {
@@ -119,6 +119,7 @@ struct task {
 	void *wait_event;		// the event instance which the task is waitting.
 	struct list_head event_list;
 	struct flag_node *flag_node;	// used for the flag event.
+	void *futex_q;			// the futex queue entry, may be moved by requeue.
 	union {
 		unsigned long ipcdata;
 		long retcode;
@@ -133,6 +134,9 @@ struct task {
 	int last_cpu;
 	int affinity;
 	int prio;
+	int orig_prio;			// the priority before inheriting the ipc sender's.
+	void *prio_iqueue;		// iqueue of the request which raised the priority.
+	long prio_token;		// token of the request which raised the priority.
 
 	unsigned long run_time;
 
@@ -147,6 +151,9 @@ struct task {
 	struct vspace *vs;		// the virtual memory space of this task.
 
 	void *pdata;			// the private data of this task for vcpu or process.
+	void *ipc_grant;		// the pages granted with the ipc message in sending.
+	void *ipc_fast;			// the register message of the fast path ipc.
+	void *ipc_buf;			// the ipc buffer not passed by the syscall registers.
 
 	struct cpu_context cpu_context;
 } __cache_line_align;
@@ -13,6 +13,7 @@
 #define TIF_NEED_STOP		10
 #define TIF_NEED_FREEZE		11
 #define TIF_WAIT_INTERRUPTED	12
+#define TIF_WAIT_ABORTABLE	13
 
 #define __TIF_NEED_RESCHED	(UL(1) << TIF_NEED_RESCHED)
 #define __TIF_32BIT		(UL(1) << TIF_32BIT)
@@ -24,6 +25,7 @@
 #define __TIF_NEED_STOP		(UL(1) << TIF_NEED_STOP)
 #define __TIF_NEED_FREEZE	(UL(1) << TIF_NEED_FREEZE) // only used for VCPU.
 #define __TIF_WAIT_INTERRUPTED	(UL(1) << TIF_WAIT_INTERRUPTED)
+#define __TIF_WAIT_ABORTABLE	(UL(1) << TIF_WAIT_ABORTABLE)	// the wait can be aborted by stop.
 
 #define __TIF_IN_INTERRUPT	(__TIF_HARDIRQ_MASK | __TIF_SOFTIRQ_MASK)
 
@@ -33,7 +33,7 @@ typedef unsigned long virt_addr_t;
 typedef unsigned long paddr_t;
 typedef unsigned long vaddr_t;
 
-typedef int16_t handle_t;
+typedef int32_t handle_t;
 typedef uint32_t right_t;
 
 typedef int16_t tid_t;
@@ -0,0 +1,57 @@
+#ifndef __MINOS_IPCSTAT_UAPI_H__
+#define __MINOS_IPCSTAT_UAPI_H__
+
+/*
+ * the ipc statistics memory is shared to the process which get
+ * its handle from the root service, the statistics of each ipc
+ * kobject is in one slot, followed by the trace ring.
+ */
+#define IPC_STAT_MAX		256
+#define IPC_LAT_BUCKETS		16
+#define IPC_TRACE_ENTRIES	4096
+
+/*
+ * bucket 0 counts the latency less than 1us, bucket n counts
+ * [2^(n-1), 2^n) us, the last bucket counts all the others.
+ */
+struct ipc_stat {
+	int type;			/* kobject type, 0 means the slot is free */
+	int owner;			/* pid of the process which created it */
+	unsigned int depth;		/* requests in the pending list now */
+	unsigned int depth_max;
+	unsigned long long msgs;
+	unsigned long long bytes;
+	unsigned long long queue_lat[IPC_LAT_BUCKETS];	/* send -> recv */
+	unsigned long long serve_lat[IPC_LAT_BUCKETS];	/* recv -> reply */
+};
+
+enum {
+	IPC_TRACE_SEND,
+	IPC_TRACE_RECV,
+	IPC_TRACE_REPLY,
+};
+
+struct ipc_trace_event {
+	unsigned long long ts;
+	int type;
+	int stat_id;			/* slot of the kobject in the stat table */
+	int sender;			/* tid */
+	int receiver;			/* tid, 0 if not received yet */
+	long token;
+};
+
+/*
+ * the trace is off by default, the user tool asks the root
+ * service to set enabled to start it, the memory is read only
+ * for the others. head is the number of events which have been written.
+ */
+struct ipc_trace_ring {
+	unsigned int enabled;
+	unsigned int entries;
+	unsigned long long head;
+	struct ipc_trace_event events[IPC_TRACE_ENTRIES];
+};
+
+#define IPC_TRACE_OFFSET	(sizeof(struct ipc_stat) * IPC_STAT_MAX)
+
+#endif
@@ -28,6 +28,7 @@ enum {
 	KOBJ_TYPE_STDIO,	// dedicated for system debuging
 	KOBJ_TYPE_POLLHUB,	// hub for events need to send.
 	KOBJ_TYPE_PORT,
+	KOBJ_TYPE_ASYNC,	// submission and completion ring.
 	KOBJ_TYPE_MAX
 };
 
@@ -46,6 +47,7 @@ enum {
 	KOBJ_PROCESS_KILL,
 	KOBJ_PROCESS_GRANT_RIGHT,
 	KOBJ_PROCESS_SET_NAME,
+	KOBJ_PROCESS_SET_MAX_HANDLE,
 };
 
 struct process_create_arg {
@@ -72,6 +74,7 @@ enum {
 enum {
 	KOBJ_PMA_ADD_PAGES = 0x4000,
 	KOBJ_PMA_GET_SIZE,
+	KOBJ_PMA_GET_PADDR,
 };
 
 struct pma_create_arg {
@@ -82,6 +85,153 @@ struct pma_create_arg {
 	unsigned long size;
 };
 
+/*
+ * for socket kobject, the shared memory starts with the control
+ * block and the data ring follows it. head is only moved by the
+ * writer and tail only by the reader, both are free running. the
+ * side going to sleep sets its wait flag, the other side only
+ * need to notify when the flag is set or the ring goes from empty
+ * to non-empty (full to non-full).
+ */
+#define SOCKET_RING_DATA_OFFSET	4096
+
+struct socket_ring {
+	volatile unsigned long head;
+	unsigned long __pad0[7];
+	volatile unsigned long tail;
+	unsigned long __pad1[7];
+	volatile int rwait;
+	volatile int wwait;
+	unsigned long size;
+};
+
+enum {
+	KOBJ_SOCKET_NOTIFY = 0x5000,
+};
+
+#define SOCKET_NOTIFY_READER	(1 << 0)
+#define SOCKET_NOTIFY_WRITER	(1 << 1)
+
+/*
+ * page ranges granted to the receiver with an ipc message, the
+ * pages are mapped to the receiver until the message is replied.
+ */
+#define KOBJ_GRANT_MAX		4
+#define KOBJ_GRANT_MAX_SIZE	0x200000
+
+struct kobject_grant {
+	unsigned long addr;
+	unsigned long size;
+	int right;
+};
+
+/*
+ * the fast path ipc only pass the message by registers, the
+ * request can carry 6 words and the reply can carry 5 words
+ * besides the return code.
+ */
+#define KOBJ_FAST_WORDS		6
+#define KOBJ_FAST_REPLY_WORDS	5
+
+/*
+ * vectored receive and reply, the first receive wait with the
+ * timeout, others only get the pending messages. token is the
+ * token or the error code of each message, ret is the result of
+ * each reply.
+ */
+#define KOBJ_IOV_MAX		16
+
+struct kobject_recv_vec {
+	void *data;
+	size_t data_size;
+	size_t actual_data;
+	void *extra;
+	size_t extra_size;
+	size_t actual_extra;
+	long token;
+};
+
+struct kobject_reply_vec {
+	long token;
+	long err_code;
+	int handle;
+	int right;
+	long ret;
+};
+
+/*
+ * async ring, the shared memory starts with the control block,
+ * the submission entries and the completion entries follow it.
+ * sq_tail and cq_head are moved by the user, sq_head and cq_tail
+ * are moved by the kernel, all of them are free running. the
+ * kernel only drains the submission queue when KOBJ_ASYNC_ENTER
+ * is called, and recv on the kobject waits for the completions.
+ */
+#define ASYNC_MAX_ENTRIES	256
+#define ASYNC_RING_SQ_OFFSET	4096
+
+struct async_ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	uint32_t sq_entries;
+	uint32_t cq_entries;
+	uint32_t sq_off;
+	uint32_t cq_off;
+};
+
+enum {
+	ASYNC_OP_NOP = 0,
+	ASYNC_OP_SEND,		// addr/len data, addr2/len2 extra.
+	ASYNC_OP_REPLY,		// addr token, len err, arg fd, len2 fd right.
+	ASYNC_OP_NOTIFY,	// addr2/len2 the notify message.
+	ASYNC_OP_FUTEX,		// arg op, addr uaddr, len val, addr2 timeout,
+				// addr3 uaddr2, len2 val3.
+	ASYNC_OP_MAX,
+};
+
+struct async_sqe {
+	uint8_t op;
+	uint8_t flags;
+	uint16_t __pad;
+	int handle;
+	int arg;
+	uint32_t timeout;
+	unsigned long addr;
+	unsigned long len;
+	unsigned long addr2;
+	unsigned long len2;
+	unsigned long addr3;
+	unsigned long user_data;
+};
+
+struct async_cqe {
+	unsigned long user_data;
+	long res;
+};
+
+enum {
+	KOBJ_ASYNC_ENTER = 0x6000,
+};
+
+/*
+ * the reader threads of one process can wait on the same endpoint
+ * or port, each request is handed to one of them. the local dispatch
+ * prefers the reader which last ran on the sender's cpu.
+ *
+ * with priority enabled, the pending requests and the waiting
+ * readers are sorted by task priority, and the reader runs at the
+ * sender's priority until it replies.
+ */
+enum {
+	KOBJ_IQUEUE_SET_DISPATCH = 0x7000,
+	KOBJ_IQUEUE_SET_PRIO,
+};
+
+#define IQUEUE_DISPATCH_FIFO	0
+#define IQUEUE_DISPATCH_LOCAL	1
+
 /*
  * for kobject poll
  */
@@ -90,6 +240,21 @@ enum {
 	KOBJ_POLL_OP_ADD,
 	KOBJ_POLL_OP_DEL,
 	KOBJ_POLL_OP_MOD,
+	KOBJ_POLL_OP_WAIT,
+};
+
+/*
+ * wait for the poll events with a nanosecond timeout, timeout
+ * less than 0 means wait forever. with POLL_WAIT_ABSTIME the
+ * timeout is the CLOCK_MONOTONIC time to wait until.
+ */
+#define POLL_WAIT_ABSTIME	(1 << 0)
+
+struct poll_wait_arg {
+	void *events;
+	int max_event;
+	int flags;
+	long timeout;
 };
 
 #endif
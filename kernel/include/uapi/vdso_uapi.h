@@ -0,0 +1,27 @@
+#ifndef __MINOS_VDSO_UAPI_H__
+#define __MINOS_VDSO_UAPI_H__
+
+/*
+ * the time data page is mapped read only to every process at
+ * this address, it is the last page below the shared region.
+ */
+#define VDSO_TIME_BASE		0x3ffffff000UL
+
+#define VDSO_TIME_F_COUNTER	(1 << 0)	/* CNTPCT_EL0 is readable in EL0 */
+
+/*
+ * seq is odd when the kernel is updating the data, the reader
+ * need to retry if seq is odd or changed after reading.
+ *
+ * CLOCK_MONOTONIC = (cntpct - boot_tick) * 1000000000 / freq
+ * CLOCK_REALTIME  = CLOCK_MONOTONIC + realtime_offset
+ */
+struct vdso_time_data {
+	unsigned int seq;
+	unsigned int flags;
+	unsigned long long freq;
+	unsigned long long boot_tick;
+	long long realtime_offset;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __MINOS_GRANT_H__
+#define __MINOS_GRANT_H__
+
+#include <minos/types.h>
+#include <minos/compiler.h>
+#include <uapi/kobject_uapi.h>
+
+struct vspace;
+struct process;
+
+struct ipc_grant {
+	int nr;
+	struct vspace *vs;		// vspace of the sender.
+	struct process *target;		// process which the pages mapped to.
+	struct kobject_grant grant[KOBJ_GRANT_MAX];
+	unsigned long map[KOBJ_GRANT_MAX];
+};
+
+int ipc_grant_setup(struct ipc_grant *ig,
+		struct kobject_grant __user *grant, int nr);
+
+void ipc_grant_release(struct ipc_grant *ig);
+
+int ipc_grant_map(struct ipc_grant *ig, struct process *proc,
+		void __user *extra, size_t extra_size, size_t *actual_extra);
+
+void ipc_grant_revoke(struct ipc_grant *ig);
+
+#endif
@@ -9,22 +9,50 @@ struct kobject;
 struct handle_desc {
 	struct kobject *kobj;
 	int right;
-	int padding;
+	int gen;
 } __packed;
 
-struct handle_table_desc {
-	uint32_t index;
-	uint32_t left;
-	struct handle_desc *next;
-} __packed;
+/*
+ * the handle value is the index in the handle table and the
+ * generation of the descriptor, the generation is increased
+ * when the handle is released, so a closed handle which has
+ * been reused can not get the new kobject.
+ */
+#define HANDLE_INDEX_BITS	17
+#define HANDLE_INDEX_MASK	((1 << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GEN_BITS		14
+#define HANDLE_GEN_MASK		((1 << HANDLE_GEN_BITS) - 1)
+
+#define handle_index(handle)	((handle) & HANDLE_INDEX_MASK)
+#define handle_gen(handle)	(((handle) >> HANDLE_INDEX_BITS) & HANDLE_GEN_MASK)
+#define make_handle(idx, gen)	\
+	((handle_t)((((gen) & HANDLE_GEN_MASK) << HANDLE_INDEX_BITS) | (idx)))
+
+#define NR_DESC_PER_PAGE	(PAGE_SIZE / sizeof(struct handle_desc))
+#define HANDLE_TABLE_PAGES	((1 << HANDLE_INDEX_BITS) / NR_DESC_PER_PAGE)
+
+/*
+ * the default limit of the handles for each process, the root
+ * service can change it by KOBJ_PROCESS_SET_MAX_HANDLE.
+ */
+#define PROC_MAX_HANDLE		(1 << HANDLE_INDEX_BITS)
+#define PROC_DEFAULT_MAX_HANDLE	(NR_DESC_PER_PAGE * 128)
+
+/*
+ * the pages of the handle table are allocated on demand and
+ * never freed until the process exit, so the lookup can read
+ * them without the lock of the process.
+ */
+struct handle_table {
+	struct handle_desc *pages[HANDLE_TABLE_PAGES];
+	uint16_t left[HANDLE_TABLE_PAGES];
+	uint32_t nr_pages;
+	uint32_t max_handle;
+};
 
 #define HANDLE_NULL	(-1)
 
-#define NR_DESC_PER_PAGE (PAGE_SIZE / sizeof(struct handle_desc) - 1)
-#define PROC_MAX_HANDLE	(NR_DESC_PER_PAGE * 128)
-
-#define WRONG_HANDLE(handle)	\
-	((handle == HANDLE_NULL) || (handle >= PROC_MAX_HANDLE))
+#define WRONG_HANDLE(handle)	((handle) < 0)
 
 void __release_handle(struct process *proc, handle_t handle);
 int release_handle(handle_t handle, struct kobject **kobj, right_t *right);
@@ -46,6 +74,8 @@ void process_handles_deinit(struct process *proc);
 
 int init_proc_handles(struct process *proc);
 
+int set_process_handle_limit(struct process *proc, uint32_t max);
+
 handle_t send_handle(struct process *psrc, struct process *pdst,
 		handle_t handle, right_t right_send);
 
@@ -0,0 +1,46 @@
+#ifndef __MINOS_IPCSTAT_H__
+#define __MINOS_IPCSTAT_H__
+
+#include <minos/types.h>
+#include <uapi/ipcstat_uapi.h>
+
+struct kobject;
+
+#ifdef CONFIG_IPC_STAT
+
+int ipc_stat_init(void);
+struct kobject *ipc_stat_kobject(void);
+struct ipc_stat *ipc_stat_alloc(int type);
+void ipc_stat_free(struct ipc_stat *stat);
+void ipc_stat_latency(unsigned long long *hist, unsigned long ns);
+void ipc_trace(struct ipc_stat *stat, int type, int sender,
+		int receiver, long token);
+
+#else
+
+static inline int ipc_stat_init(void)
+{
+	return 0;
+}
+
+static inline struct kobject *ipc_stat_kobject(void)
+{
+	return NULL;
+}
+
+static inline struct ipc_stat *ipc_stat_alloc(int type)
+{
+	return NULL;
+}
+
+static inline void ipc_stat_free(struct ipc_stat *stat) {}
+
+static inline void ipc_stat_latency(unsigned long long *hist,
+		unsigned long ns) {}
+
+static inline void ipc_trace(struct ipc_stat *stat, int type,
+		int sender, int receiver, long token) {}
+
+#endif
+
+#endif
@@ -4,6 +4,8 @@
 #include <minos/list.h>
 #include <minos/sem.h>
 #include <minos/current.h>
+#include <uapi/kobject_uapi.h>
+#include <uspace/ipcstat.h>
 
 struct kobject;
 struct task;
@@ -12,25 +14,58 @@ struct task;
 #define IMSG_STATE_IN_PROCESS 1
 #define IMSG_STATE_ERROR 2
 
+/*
+ * in-flight messages are kept in a small slot table, the token
+ * which returned to the receiver is the slot index tagged with
+ * the generation of the slot, so a stale token can be detected.
+ */
+#define IQUEUE_NR_SLOTS		BITS_PER_LONG
+#define IQUEUE_SLOT_SHIFT	8
+#define IQUEUE_SLOT_MASK	((1UL << IQUEUE_SLOT_SHIFT) - 1)
+
 struct imsg {
 	void *data;
 	long token;
 	long retcode;
 	int state;
 	int submit;
+	int slot;
+	unsigned long send_ns;
+	unsigned long recv_ns;
 	struct list_head list;
 	struct event ievent;
 };
 
+/*
+ * the message of the fast path ipc, which is copied from and
+ * to the user registers by the syscall handler.
+ */
+struct ipc_fast {
+	unsigned long msg[KOBJ_FAST_WORDS];
+	unsigned long reply[KOBJ_FAST_REPLY_WORDS];
+};
+
+struct iqueue_slot {
+	struct imsg *imsg;
+	uint32_t gen;
+};
+
 struct iqueue {
 	int mutil_writer;
 	int rstate;
 	int wstate;
+	int dispatch;
+	int prio;
 
 	spinlock_t lock;
 	struct list_head pending_list;
-	struct list_head processing_list;
 	struct kobject *kobj;
+	struct ipc_stat *stat;
+
+	unsigned long slot_map;
+	struct iqueue_slot slots[IQUEUE_NR_SLOTS];
+	int slot_waiters;
+	struct event slot_event;		// kernel waitting for a free slot.
 
 	sem_t isem;
 };
@@ -42,6 +77,11 @@ static void inline imsg_init(struct imsg *imsg, struct task *task)
 	imsg->token = new_event_token();
 	imsg->state = IMSG_STATE_INIT;
 	imsg->submit = 0;
+	imsg->slot = -1;
+	imsg->send_ns = 0;
+	imsg->recv_ns = 0;
+	imsg->list.next = NULL;
+	imsg->list.pre = NULL;
 	event_init(&imsg->ievent, OS_EVENT_TYPE_NORMAL, task);
 }
 
@@ -55,8 +95,18 @@ long iqueue_send(struct iqueue *iqueue, void __user *data, size_t data_size,
 int iqueue_reply(struct iqueue *iqueue, right_t right,
 		long token, long errno, handle_t fd, right_t fd_right);
 
+int iqueue_submit(struct iqueue *iqueue, struct imsg *imsg);
+
+void iqueue_cancel(struct iqueue *iqueue, struct imsg *imsg);
+
 int iqueue_close(struct iqueue *iqueue, right_t right, struct process *proc);
 
+int iqueue_poll_ready(struct iqueue *iqueue, int event);
+
+long iqueue_ctl(struct iqueue *iqueue, int req, unsigned long data);
+
 void iqueue_init(struct iqueue *iq, int mutil_writer, struct kobject *kobj);
 
+void iqueue_deinit(struct iqueue *iq);
+
 #endif
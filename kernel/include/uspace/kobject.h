@@ -56,6 +56,12 @@ struct kobject_ops {
 
 	int (*poll)(struct kobject *ksrc, struct kobject *kdst, int event, bool enable);
 
+	/*
+	 * whether the event is still ready, used by the level
+	 * triggered poll to report the event again.
+	 */
+	int (*poll_ready)(struct kobject *kobj, int event);
+
 	int (*close)(struct kobject *kobj, right_t right, struct process *proc);
 
 	int (*reply)(struct kobject *kobj, right_t right, long token,
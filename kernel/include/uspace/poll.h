@@ -12,6 +12,21 @@
 #define POLLWCLOSE 0x020
 #define POLLKERNEL 0x040
 
+/*
+ * by default each send of the event is reported once (counted).
+ * POLLET reports the event once when it happens, the sends before
+ * the poller reads it are merged. POLLLT reports the event as long
+ * as the kobject is ready.
+ */
+#define POLLLT (1U << 27)
+#define POLLET (1U << 31)
+
+enum {
+	PEVENT_MODE_COUNT = 0,
+	PEVENT_MODE_EDGE,
+	PEVENT_MODE_LEVEL,
+};
+
 enum {
 	EV_IN = 0,
 	EV_OUT,
@@ -41,23 +56,6 @@ enum {
 #define POLL_KEV_PAGE_FAULT 0x1
 #define POLL_KEV_PROCESS_EXIT 0x2
 
-struct poll_hub {
-	struct list_head event_list;
-	spinlock_t lock;
-	struct kobject kobj;
-	struct event event;
-};
-
-struct pevent_item {
-	struct poll_hub *poller;
-	unsigned long data;
-	struct pevent_item *next;
-};
-
-struct poll_struct {
-	struct pevent_item *pevents[EV_MAX];
-};
-
 struct poll_data {
 	union {
 		void *ptr;
@@ -75,12 +73,43 @@ struct poll_event {
 	struct poll_data data;
 };
 
+struct poll_hub {
+	struct list_head event_list;
+	spinlock_t lock;
+	int closed;
+	struct kobject kobj;
+	struct event event;
+};
+
 struct poll_event_kernel {
 	struct poll_event event;
 	struct list_head list;
+	struct pevent_item *pi;		// the coalesced event of the pevent_item.
 	int release;
 };
 
+/*
+ * one pevent_item for each (poll_hub, kobject, event). the event
+ * without data is coalesced to the event embedded in the item,
+ * queued is set when it is in the event list of the poll_hub, and
+ * only changed with the poll_hub's lock.
+ */
+struct pevent_item {
+	struct poll_hub *poller;
+	struct kobject *kobj;
+	unsigned long data;
+	int ev;
+	int mode;			/* PEVENT_MODE_xxx */
+	int queued;
+	int pending;			/* sends not reported yet */
+	struct poll_event_kernel pek;
+	struct pevent_item *next;
+};
+
+struct poll_struct {
+	struct pevent_item *pevents[EV_MAX];
+};
+
 static inline int event_is_polled(struct poll_struct *ps, int ev)
 {
 	return (ps && (ps->pevents[ev]));
@@ -25,19 +25,21 @@ struct process {
 	struct vspace vspace;
 
 	/*
-	 * handle_desc_table will store all the kobjects created
+	 * handle_table will store all the kobjects created
 	 * and kobjects connected by this process. and
 	 *
 	 * when close or open kobject, it will only clear or
 	 * set the right for related kobject in kobj_table.
 	 */
-	struct handle_desc *handle_desc_table;
+	struct handle_table *handle_table;
 	struct task *root_task;
 	struct list_head task_list;
 	spinlock_t lock;
 
 	struct kobject kobj;
 	struct iqueue iqueue;
+
+	DECLARE_BITMAP(grant_slot, PROC_GRANT_SLOTS);
 };
 
 #define current_proc		(struct process *)current->vs->pdata
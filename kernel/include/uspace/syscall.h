@@ -4,6 +4,11 @@
 #include <minos/types.h>
 #include <asm/syscall.h>
 
+struct kobject_grant;
+struct ipc_fast;
+struct kobject_recv_vec;
+struct kobject_reply_vec;
+
 extern void sys_sched_yield(void);
 
 extern int sys_kobject_connect(char __user *path, right_t right);
@@ -19,9 +24,28 @@ extern ssize_t sys_kobject_recv(handle_t handle, void __user *data, size_t data_
 extern ssize_t sys_kobject_send(handle_t handle, void __user *data, size_t data_size,
 		void __user *extra, size_t extra_size, uint32_t timeout);
 
+extern long sys_kobject_send_grant(handle_t handle, void __user *data,
+		size_t data_size, struct kobject_grant __user *grant,
+		int nr_grant, uint32_t timeout);
+
 extern int sys_kobject_reply(handle_t handle, long token,
 		long err_code, handle_t fd, right_t fd_right);
 
+extern long sys_kobject_recvv(handle_t handle,
+		struct kobject_recv_vec __user *uvec, int nr, uint32_t timeout);
+
+extern long sys_kobject_replyv(handle_t handle,
+		struct kobject_reply_vec __user *uvec, int nr);
+
+extern long sys_kobject_send_fast(handle_t handle,
+		struct ipc_fast *fast, uint32_t timeout);
+
+extern long sys_kobject_recv_fast(handle_t handle,
+		struct ipc_fast *fast, uint32_t timeout);
+
+extern long sys_kobject_reply_fast(handle_t handle, unsigned long token,
+		long err_code, struct ipc_fast *fast);
+
 extern long sys_futex(uint32_t __user *uaddr, int op, uint32_t val,
 		struct timespec __user *utime,
 		uint32_t __user *uaddr2, uint32_t val3);
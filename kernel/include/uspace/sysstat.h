@@ -0,0 +1,37 @@
+#ifndef __MINOS_SYSSTAT_H__
+#define __MINOS_SYSSTAT_H__
+
+#include <minos/types.h>
+#include <uapi/sysstat_uapi.h>
+
+struct kobject;
+
+#ifdef CONFIG_SYSCALL_STAT
+
+int syscall_stat_init(void);
+struct kobject *syscall_stat_kobject(void);
+unsigned long syscall_stat_enter(unsigned int nr);
+void syscall_stat_exit(unsigned int nr, unsigned long start);
+
+#else
+
+static inline int syscall_stat_init(void)
+{
+	return 0;
+}
+
+static inline struct kobject *syscall_stat_kobject(void)
+{
+	return NULL;
+}
+
+static inline unsigned long syscall_stat_enter(unsigned int nr)
+{
+	return 0;
+}
+
+static inline void syscall_stat_exit(unsigned int nr, unsigned long start) {}
+
+#endif
+
+#endif
@@ -1,11 +1,15 @@
 #ifndef __MINOS_ACCESS_H__
 #define __MINOS_ACCESS_H__
 
+#include <minos/types.h>
 #include <minos/compiler.h>
 #include <asm/uaccess.h>
 
 struct vspace;
 
+phy_addr_t uaccess_va_to_pa(struct vspace *vs, unsigned long va, int write);
+void uaccess_prefault(void __user *addr, size_t size);
+
 int copy_string_from_user(char *dst, char __user *src, int max);
 int __copy_from_user(void *dst, struct vspace *vsrc, void __user *src, size_t size);
 int __copy_to_user(struct vspace *vdst, void __user *dst, void *src, size_t size);
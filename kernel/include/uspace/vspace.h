@@ -21,6 +21,7 @@
 /*
  * 0    - (256G - 1) user space memory region
  * 256G - (512G - 1) shared memory mapping space.
+ * 511G - (512G - 1) pages granted by other process.
  *
  * 0    - ( 64G - 1) ELF (text data bss and other)
  * 64G -> (64G + 256M) heap area
@@ -38,6 +39,14 @@
 #define SYS_PROC_VMAP_BASE	(65UL * 1024 * 1024 * 1024)
 #define SYS_PROC_VMAP_END	(255UL * 1024 * 1024 * 1024)
 
+/*
+ * the pages granted with an ipc message are mapped to the
+ * last 1G of the shared region, each grant use one 2M slot.
+ */
+#define PROC_GRANT_BASE		(USER_PROCESS_ADDR_LIMIT - (1UL << 30))
+#define PROC_GRANT_SLOT_SIZE	HUGE_PAGE_SIZE
+#define PROC_GRANT_SLOTS	512
+
 #define MIN_ELF_LOAD_BASE	0x1000
 #define ROOTSRV_USTACK_TOP	(PROCESS_TOP_HALF_BASE - PAGE_SIZE * 8)
 #define ROOTSRV_USTACK_BOTTOM	(ROOTSRV_USTACK_TOP - ROOTSRV_USTACK_PAGES * PAGE_SIZE)
@@ -56,6 +65,8 @@ int map_process_memory(struct process *proc,
 int unmap_process_memory(struct process *proc,
 		unsigned long vaddr, size_t size);
 
+int map_vdso_time(struct process *proc);
+
 unsigned long translate_va_to_pa(struct vspace *vs, unsigned long va);
 
 void *uva_to_kva(struct vspace *vs, unsigned long va,
@@ -63,6 +74,8 @@ void *uva_to_kva(struct vspace *vs, unsigned long va,
 
 int handle_page_fault(unsigned long virt, int write, unsigned long flags);
 
+int user_page_fault_in(struct vspace *vs, unsigned long virt, int write);
+
 void inc_vspace_usage(struct vspace *vs);
 void dec_vspace_usage(struct vspace *vs);
 void add_released_page_to_vspace(struct vspace *vs, unsigned long addr);
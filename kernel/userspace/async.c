@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <minos/minos.h>
+#include <minos/mm.h>
+#include <minos/sched.h>
+#include <minos/event.h>
+#include <minos/atomic.h>
+#include <minos/time.h>
+#include <uspace/poll.h>
+#include <uspace/kobject.h>
+#include <uspace/uaccess.h>
+#include <uspace/vspace.h>
+#include <uspace/proc.h>
+#include <uspace/handle.h>
+#include <uspace/syscall.h>
+
+#include "kobject_copy.h"
+
+/*
+ * async ring is a submission queue and a completion queue shared
+ * with the process. the entries are executed in the context of
+ * the thread which calls KOBJ_ASYNC_ENTER, so a blocking entry
+ * will block the following entries. the kernel keeps its own copy
+ * of sq_head and cq_tail, the values in the shared memory are only
+ * for the user.
+ */
+#define ASYNC_RIGHT_MASK	(KOBJ_RIGHT_MMAP | KOBJ_RIGHT_CTL)
+#define ASYNC_RIGHT		(KOBJ_RIGHT_RW | KOBJ_RIGHT_MMAP | KOBJ_RIGHT_CTL)
+
+struct async {
+	void *shmem;
+	size_t shmem_size;
+
+	struct async_ring *ring;
+	struct async_sqe *sqes;
+	struct async_cqe *cqes;
+
+	uint32_t sq_entries;
+	uint32_t cq_entries;
+	uint32_t sq_head;
+	uint32_t cq_tail;
+
+	atomic_t busy;
+	struct event cqevent;			// waitting for completions.
+
+	struct kobject kobj;
+};
+
+#define kobject_to_async(kobj)	\
+	(struct async *)((kobj)->data)
+
+static inline int async_cq_ready(struct async *as)
+{
+	return (as->cq_tail != as->ring->cq_head);
+}
+
+static long async_send(struct async_sqe *sqe)
+{
+	struct ipc_buf buf;
+	long ret;
+
+	/*
+	 * the receiver copies the message from the sender's
+	 * ipc buffer, which is not in the registers here.
+	 */
+	buf.data = (void __user *)sqe->addr;
+	buf.data_size = sqe->len;
+	buf.extra = (void __user *)sqe->addr2;
+	buf.extra_size = sqe->len2;
+
+	current->ipc_buf = &buf;
+	ret = sys_kobject_send(sqe->handle, buf.data, buf.data_size,
+			buf.extra, buf.extra_size, sqe->timeout);
+	current->ipc_buf = NULL;
+
+	return ret;
+}
+
+static long async_notify(struct async_sqe *sqe)
+{
+	struct kobject *kobj;
+	right_t right;
+	long ret;
+
+	ret = get_kobject(sqe->handle, &kobj, &right);
+	if (ret)
+		return ret;
+
+	if (kobj->type != KOBJ_TYPE_NOTIFY) {
+		ret = -EBADF;
+		goto out;
+	}
+
+	if (!(right & KOBJ_RIGHT_WRITE)) {
+		ret = -EPERM;
+		goto out;
+	}
+
+	ret = kobject_send(kobj, NULL, 0, (void __user *)sqe->addr2,
+			sqe->len2, 0);
+out:
+	put_kobject(kobj);
+	return ret;
+}
+
+static long async_execute(struct async_sqe *sqe)
+{
+	switch (sqe->op) {
+	case ASYNC_OP_NOP:
+		return 0;
+	case ASYNC_OP_SEND:
+		return async_send(sqe);
+	case ASYNC_OP_REPLY:
+		return sys_kobject_reply(sqe->handle, sqe->addr,
+				(long)sqe->len, sqe->arg, (right_t)sqe->len2);
+	case ASYNC_OP_NOTIFY:
+		return async_notify(sqe);
+	case ASYNC_OP_FUTEX:
+		return sys_futex((uint32_t __user *)sqe->addr, sqe->arg,
+				(uint32_t)sqe->len,
+				(struct timespec __user *)sqe->addr2,
+				(uint32_t __user *)sqe->addr3,
+				(uint32_t)sqe->len2);
+	default:
+		break;
+	}
+
+	return -ENOSYS;
+}
+
+static long async_enter(struct async *as, uint32_t to_submit)
+{
+	struct async_ring *ring = as->ring;
+	struct async_sqe sqe;
+	struct async_cqe *cqe;
+	uint32_t tail, cq_head;
+	long submitted = 0;
+
+	/*
+	 * only one thread can drain the ring at the same time,
+	 * the others need to wait the completion.
+	 */
+	if (atomic_cmpxchg(&as->busy, 0, 1) != 0)
+		return -EBUSY;
+
+	tail = ring->sq_tail;
+	smp_rmb();
+	if ((uint32_t)(tail - as->sq_head) > as->sq_entries) {
+		submitted = -EIO;
+		goto out;
+	}
+
+	to_submit = MIN(to_submit, tail - as->sq_head);
+
+	while (submitted < to_submit) {
+		/*
+		 * stop if there is no space in the completion queue,
+		 * the user need to consume the completions first.
+		 */
+		cq_head = ring->cq_head;
+		if ((uint32_t)(as->cq_tail - cq_head) >= as->cq_entries)
+			break;
+
+		/*
+		 * copy the entry first, the user may change it when
+		 * the kernel is executing it.
+		 */
+		memcpy(&sqe, &as->sqes[as->sq_head & (as->sq_entries - 1)],
+				sizeof(struct async_sqe));
+		as->sq_head++;
+		ring->sq_head = as->sq_head;
+
+		cqe = &as->cqes[as->cq_tail & (as->cq_entries - 1)];
+		cqe->user_data = sqe.user_data;
+		cqe->res = async_execute(&sqe);
+		smp_wmb();
+		as->cq_tail++;
+		ring->cq_tail = as->cq_tail;
+
+		submitted++;
+	}
+out:
+	atomic_set(0, &as->busy);
+
+	if (submitted > 0) {
+		smp_mb();
+		wake(&as->cqevent, 0);
+		poll_event_send(as->kobj.poll_struct, EV_IN);
+	}
+
+	return submitted;
+}
+
+/*
+ * wait for the completions, return the number of completions
+ * which can be consumed.
+ */
+static long async_recv(struct kobject *kobj, void __user *data,
+		size_t data_size, size_t *actual_data, void __user *extra,
+		size_t extra_size, size_t *actual_extra, uint32_t timeout)
+{
+	struct async *as = kobject_to_async(kobj);
+	long ret;
+
+	ret = wait_event(&as->cqevent, async_cq_ready(as), timeout);
+	if (ret)
+		return ret;
+
+	return (uint32_t)(as->cq_tail - as->ring->cq_head);
+}
+
+static long async_ctl(struct kobject *kobj, int req, unsigned long data)
+{
+	struct async *as = kobject_to_async(kobj);
+
+	switch (req) {
+	case KOBJ_ASYNC_ENTER:
+		return async_enter(as, (uint32_t)data);
+	default:
+		break;
+	}
+
+	return -EINVAL;
+}
+
+static int async_poll_ready(struct kobject *kobj, int event)
+{
+	struct async *as = kobject_to_async(kobj);
+
+	return (event == EV_IN) ? async_cq_ready(as) : 0;
+}
+
+static int async_mmap(struct kobject *kobj, right_t right,
+		void **addr, unsigned long *msize)
+{
+	struct async *as = kobject_to_async(kobj);
+	unsigned long base = va2sva(as->shmem);
+	int ret;
+
+	ret = map_process_memory(current_proc, base, as->shmem_size,
+			vtop(as->shmem), VM_RW | VM_SHARED);
+	if (ret)
+		return ret;
+
+	*addr = (void *)base;
+	*msize = as->shmem_size;
+
+	return 0;
+}
+
+static int async_munmap(struct kobject *kobj, right_t right)
+{
+	struct async *as = kobject_to_async(kobj);
+
+	return unmap_process_memory(current_proc,
+			va2sva(as->shmem), as->shmem_size);
+}
+
+static int async_close(struct kobject *kobj, right_t right, struct process *proc)
+{
+	struct async *as = kobject_to_async(kobj);
+	unsigned long flags;
+
+	spin_lock_irqsave(&as->cqevent.lock, flags);
+	wake_up_event_waiter(&as->cqevent, 0, TASK_STATE_PEND_ABORT, WAKEUP_ALL);
+	spin_unlock_irqrestore(&as->cqevent.lock, flags);
+
+	return unmap_process_memory(proc, va2sva(as->shmem), as->shmem_size);
+}
+
+static void async_release(struct kobject *kobj)
+{
+	struct async *as = kobject_to_async(kobj);
+
+	free_pages(as->shmem);
+	free(as);
+}
+
+static struct kobject_ops async_kobject_ops = {
+	.recv		= async_recv,
+	.release	= async_release,
+	.close		= async_close,
+	.mmap		= async_mmap,
+	.munmap		= async_munmap,
+	.ctl		= async_ctl,
+	.poll_ready	= async_poll_ready,
+};
+
+static int async_create(struct kobject **kobj, right_t *right, unsigned long data)
+{
+	uint32_t entries = data;
+	struct async *as;
+	size_t size;
+
+	if ((entries == 0) || (entries > ASYNC_MAX_ENTRIES) ||
+			(entries & (entries - 1)))
+		return -EINVAL;
+
+	as = zalloc(sizeof(struct async));
+	if (!as)
+		return -ENOMEM;
+
+	/*
+	 * the completion queue is twice the size of the submission
+	 * queue, then the user can submit again before reaping.
+	 */
+	size = ASYNC_RING_SQ_OFFSET + entries * sizeof(struct async_sqe) +
+		entries * 2 * sizeof(struct async_cqe);
+	as->shmem_size = PAGE_BALIGN(size);
+	as->shmem = get_free_pages(as->shmem_size >> PAGE_SHIFT, GFP_USER);
+	if (!as->shmem) {
+		free(as);
+		return -ENOMEM;
+	}
+
+	as->sq_entries = entries;
+	as->cq_entries = entries * 2;
+	as->ring = (struct async_ring *)as->shmem;
+	as->sqes = as->shmem + ASYNC_RING_SQ_OFFSET;
+	as->cqes = (struct async_cqe *)(as->sqes + entries);
+
+	as->ring->sq_entries = as->sq_entries;
+	as->ring->cq_entries = as->cq_entries;
+	as->ring->sq_off = ASYNC_RING_SQ_OFFSET;
+	as->ring->cq_off = (void *)as->cqes - as->shmem;
+
+	atomic_set(0, &as->busy);
+	event_init(&as->cqevent, OS_EVENT_TYPE_NORMAL, as);
+
+	kobject_init(&as->kobj, KOBJ_TYPE_ASYNC, ASYNC_RIGHT_MASK, (unsigned long)as);
+	as->kobj.ops = &async_kobject_ops;
+	as->kobj.flags |= KOBJ_FLAGS_NON_SHARED;
+	*kobj = &as->kobj;
+	*right = ASYNC_RIGHT;
+
+	return 0;
+}
+DEFINE_KOBJECT(async, KOBJ_TYPE_ASYNC, async_create);
@@ -72,10 +72,24 @@ static int endpoint_reply(struct kobject *kobj, right_t right,
 	return iqueue_reply(&ep->iqueue, right, token, errno, fd, fd_right);
 }
 
+static long endpoint_ctl(struct kobject *kobj, int req, unsigned long data)
+{
+	struct endpoint *ep = kobject_to_endpoint(kobj);
+	return iqueue_ctl(&ep->iqueue, req, data);
+}
+
+static int endpoint_poll_ready(struct kobject *kobj, int event)
+{
+	struct endpoint *ep = kobject_to_endpoint(kobj);
+	return iqueue_poll_ready(&ep->iqueue, event);
+}
+
 static void endpoint_release(struct kobject *kobj)
 {
 	struct endpoint *ep = kobject_to_endpoint(kobj);
 
+	iqueue_deinit(&ep->iqueue);
+
 	if (ep->shmem)
 		free_pages(ep->shmem);
 
@@ -122,6 +136,8 @@ static struct kobject_ops endpoint_kobject_ops = {
 	.mmap		= endpoint_mmap,
 	.munmap		= endpoint_munmap,
 	.reply		= endpoint_reply,
+	.poll_ready	= endpoint_poll_ready,
+	.ctl		= endpoint_ctl,
 };
 
 static int endpoint_create(struct kobject **kobj, right_t *right, unsigned long data)
@@ -147,8 +163,8 @@ static int endpoint_create(struct kobject **kobj, right_t *right, unsigned long
 		right_ep |= KOBJ_RIGHT_MMAP;
 	}
 
-	iqueue_init(&ep->iqueue, 0, &ep->kobj);
 	kobject_init(&ep->kobj, KOBJ_TYPE_ENDPOINT, EP_RIGHT_MASK, (unsigned long)ep);
+	iqueue_init(&ep->iqueue, 0, &ep->kobj);
 
 	ep->shmem_size = shmem_size;
 	ep->kobj.ops = &endpoint_kobject_ops;
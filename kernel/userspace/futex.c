@@ -19,6 +19,7 @@
 #include <minos/time.h>
 #include <minos/task.h>
 #include <minos/sched.h>
+#include <minos/atomic.h>
 #include <uspace/vspace.h>
 #include <uspace/proc.h>
 
@@ -57,73 +58,475 @@
                                          FUTEX_PRIVATE_FLAG)
 #define FUTEX_SWAP_PRIVATE              (FUTEX_SWAP | FUTEX_PRIVATE_FLAG)
 
+/*
+ * the private futex is keyed by the address space and the user
+ * address, the shared one is keyed by the physical address, so
+ * the futexes in one page use different buckets.
+ */
+struct futex_key {
+	struct vspace *vs;
+	unsigned long addr;
+};
+
 struct futex {
 	pid_t owner;
-	unsigned long paddr;
+	int ref;			// the users of this futex, protected by the bucket lock.
+	struct futex_key key;
 	struct list_head list;
 	struct event event;
 };
 
 struct futex_queue {
-	int cnt;
 	spinlock_t lock;
 	struct list_head head;
 };
 
-#define FUTEX_KEY_SIZE	10
-static struct futex_queue ft_queue[FUTEX_KEY_SIZE];
+/*
+ * the waiter's entry on its stack, requeue will move the waiter
+ * to another futex and update this entry with both bucket locks
+ * held, the waiter reads it back after it is waked up.
+ */
+struct futex_q {
+	struct futex *ft;
+	struct futex_queue *ftq;
+};
+
+#define FUTEX_OP_SET		0	/* *(int *)UADDR2 = OPARG; */
+#define FUTEX_OP_ADD		1	/* *(int *)UADDR2 += OPARG; */
+#define FUTEX_OP_OR		2	/* *(int *)UADDR2 |= OPARG; */
+#define FUTEX_OP_ANDN		3	/* *(int *)UADDR2 &= ~OPARG; */
+#define FUTEX_OP_XOR		4	/* *(int *)UADDR2 ^= OPARG; */
+#define FUTEX_OP_OPARG_SHIFT	8	/* use (1 << OPARG) instead of OPARG. */
+
+#define FUTEX_OP_CMP_EQ		0	/* if (oldval == CMPARG) wake */
+#define FUTEX_OP_CMP_NE		1	/* if (oldval != CMPARG) wake */
+#define FUTEX_OP_CMP_LT		2	/* if (oldval < CMPARG) wake */
+#define FUTEX_OP_CMP_LE		3	/* if (oldval <= CMPARG) wake */
+#define FUTEX_OP_CMP_GT		4	/* if (oldval > CMPARG) wake */
+#define FUTEX_OP_CMP_GE		5	/* if (oldval >= CMPARG) wake */
+
+#define FUTEX_HASH_PER_CPU	256
+#define GOLDEN_RATIO_64		0x61C8864680B583EBUL
+
+static struct futex_queue *ft_queue;
+static unsigned int ft_hash_bits;
 
 static unsigned long futex_timeout_val(struct timespec *ktime)
 {
-	// TBD overfolw check
-	return (ktime->tv_sec * 1000ULL) + (ktime->tv_nsec / 1000000ULL);
+	unsigned long ms;
+
+	if ((ktime->tv_sec < 0) || (ktime->tv_nsec < 0))
+		return 1;
+
+	/*
+	 * the timeout of wait_event is a 32 bit value in ms, 0 means
+	 * wait forever, so round the timeout to [1, -2].
+	 */
+	if (ktime->tv_sec >= ((uint32_t)-2 / 1000))
+		return (uint32_t)-2;
+
+	ms = (ktime->tv_sec * 1000UL) + (ktime->tv_nsec / 1000000UL);
+
+	return ms ? ms : 1;
+}
+
+static inline int futex_wake_num(uint32_t val)
+{
+	return (val >= INT_MAX) ? WAKEUP_ALL : (int)val;
 }
 
-static long sys_do_futex_wait(struct futex *ft, uint32_t *kaddr,
-		uint32_t val, struct timespec *ktime,
-		uint32_t *kaddr2, uint32_t val3)
+static inline struct futex_queue *futex_hash(struct futex_key *key)
 {
+	unsigned long v = key->addr ^ ((unsigned long)key->vs >> 4);
+
+	return &ft_queue[(v * GOLDEN_RATIO_64) >> (64 - ft_hash_bits)];
+}
+
+static int futex_get_key(uint32_t __user *uaddr, uint32_t *kaddr,
+		int op, struct futex_key *key)
+{
+	if (op & FUTEX_PRIVATE_FLAG) {
+		key->vs = current->vs;
+		key->addr = ULONG(uaddr);
+	} else {
+		key->vs = NULL;
+		key->addr = vtop(kaddr);
+	}
+
+	return 0;
+}
+
+static inline int futex_key_equal(struct futex_key *k1, struct futex_key *k2)
+{
+	return (k1->vs == k2->vs) && (k1->addr == k2->addr);
+}
+
+static struct futex *futex_lookup(struct futex_queue *ftq, struct futex_key *key)
+{
+	struct futex *ft;
+
+	list_for_each_entry(ft, &ftq->head, list) {
+		if (futex_key_equal(&ft->key, key))
+			return ft;
+	}
+
+	return NULL;
+}
+
+/*
+ * find or create the futex for the key, called with the bucket
+ * lock held, the caller need to take its reference.
+ */
+static struct futex *futex_lookup_create(struct futex_queue *ftq,
+		struct futex_key *key)
+{
+	struct futex *ft;
+
+	ft = futex_lookup(ftq, key);
+	if (ft)
+		return ft;
+
+	ft = zalloc(sizeof(struct futex));
+	if (!ft)
+		return NULL;
+
+	event_init(&ft->event, OS_EVENT_TYPE_FUTEX, ft);
+	ft->owner = current_pid;
+	ft->key = *key;
+	list_add(&ftq->head, &ft->list);
+
+	return ft;
+}
+
+/*
+ * the futex is only kept when there are waiters on it.
+ */
+static inline void futex_release_locked(struct futex *ft)
+{
+	if (ft->ref == 0) {
+		list_del(&ft->list);
+		free(ft);
+	}
+}
+
+static void futex_lock_pair(struct futex_queue *ftq1, struct futex_queue *ftq2)
+{
+	if (ftq1 == ftq2) {
+		spin_lock(&ftq1->lock);
+	} else if (ftq1 < ftq2) {
+		spin_lock(&ftq1->lock);
+		spin_lock(&ftq2->lock);
+	} else {
+		spin_lock(&ftq2->lock);
+		spin_lock(&ftq1->lock);
+	}
+}
+
+static void futex_unlock_pair(struct futex_queue *ftq1, struct futex_queue *ftq2)
+{
+	spin_unlock(&ftq1->lock);
+	if (ftq1 != ftq2)
+		spin_unlock(&ftq2->lock);
+}
+
+/*
+ * lock the bucket which the waiter is queued on now, the waiter
+ * may be requeued before it gets the lock, so check it again.
+ */
+static struct futex_queue *futex_q_lock(struct futex_q *q)
+{
+	struct futex_queue *ftq;
+
+	for (;;) {
+		ftq = *(struct futex_queue * volatile *)&q->ftq;
+		spin_lock(&ftq->lock);
+		if (ftq == q->ftq)
+			return ftq;
+		spin_unlock(&ftq->lock);
+	}
+}
+
+static long futex_wait(struct futex_queue *ftq, struct futex_key *key,
+		uint32_t *kaddr, uint32_t val, struct timespec *ktime)
+{
+	struct task *task = current;
 	unsigned long timeout;
+	struct futex_q q;
+	struct futex *ft;
+	long ret;
 
 	timeout = ktime ? futex_timeout_val(ktime) : 0;
 
 	/*
 	 * the lock may has been released, return to userspace
 	 * again to require the lock at userspace. else wait on
-	 * this futex's wiat list.
+	 * this futex's wait list. the value is checked with the
+	 * bucket lock held, then cmp_requeue can see the waiter.
 	 */
-	spin_lock(&ft->event.lock);
+	spin_lock(&ftq->lock);
 	if (*kaddr != val) {
-		spin_unlock(&ft->event.lock);
-		return 0;
+		spin_unlock(&ftq->lock);
+		return -EAGAIN;
+	}
+
+	ft = futex_lookup_create(ftq, key);
+	if (!ft) {
+		spin_unlock(&ftq->lock);
+		return -ENOMEM;
 	}
-	__wait_event(ft, OS_EVENT_TYPE_FUTEX, timeout);
+
+	ft->ref++;
+	q.ft = ft;
+	q.ftq = ftq;
+	task->futex_q = &q;
+
+	spin_lock(&ft->event.lock);
+	__wait_event(&ft->event, OS_EVENT_TYPE_FUTEX, timeout);
 	spin_unlock(&ft->event.lock);
+	spin_unlock(&ftq->lock);
+
+	sched();
+
+	/*
+	 * remove the task from the wait list if it is waked up
+	 * by timeout or abort, it may have been requeued to
+	 * another futex.
+	 */
+	ftq = futex_q_lock(&q);
+	ft = q.ft;
+
+	if (task->pend_state != TASK_STATE_PEND_OK) {
+		spin_lock(&ft->event.lock);
+		if (task->event_list.next != NULL) {
+			list_del(&task->event_list);
+			task->event_list.next = NULL;
+		}
+		spin_unlock(&ft->event.lock);
+	}
+
+	ret = task->retcode;
+	event_pend_down();
+	task->futex_q = NULL;
 
-	return do_wait_event(&ft->event);
+	ft->ref--;
+	futex_release_locked(ft);
+	spin_unlock(&ftq->lock);
+
+	return ret;
 }
 
-static long sys_do_futex_wake(struct futex *ft, uint32_t *kaddr,
-		uint32_t val, struct timespec *ktime,
-		uint32_t *kaddr2, uint32_t val3)
+/*
+ * wake up to num waiters, called with the bucket lock held so
+ * the futex can not be released.
+ */
+static int futex_wake_locked(struct futex *ft, int num)
 {
-	int wakecnt = 0;
+	int wakecnt;
 
-	if ((val != 1) && (val != INT_MAX)) {
-		pr_warn("bad value for futex wake %d\n", val);
-		return -EINVAL;
-	}
+	if (num == 0)
+		return 0;
 
 	spin_lock(&ft->event.lock);
-	wakecnt = __wake_up_event_waiter(&ft->event, 0, TASK_STATE_PEND_OK, val);
+	wakecnt = __wake_up_event_waiter(&ft->event, 0, TASK_STATE_PEND_OK, num);
 	spin_unlock(&ft->event.lock);
 
 	return wakecnt;
 }
 
-static inline int futex_key(unsigned long phy)
+static long futex_wake(struct futex_queue *ftq, struct futex_key *key, uint32_t val)
 {
-	return (phy >> PAGE_SHIFT) % 10;
+	struct futex *ft;
+	long ret;
+
+	/*
+	 * no futex means no waiter on this address.
+	 */
+	spin_lock(&ftq->lock);
+	ft = futex_lookup(ftq, key);
+	ret = ft ? futex_wake_locked(ft, futex_wake_num(val)) : 0;
+	spin_unlock(&ftq->lock);
+
+	return ret;
+}
+
+/*
+ * move up to num waiters from ft1 to ft2, both bucket locks are
+ * held by the caller.
+ */
+static int futex_requeue_locked(struct futex *ft1, struct futex *ft2,
+		struct futex_queue *ftq2, int num)
+{
+	struct task *task, *tmp;
+	struct futex_q *q;
+	int cnt = 0;
+
+	spin_lock(&ft1->event.lock);
+	spin_lock(&ft2->event.lock);
+
+	list_for_each_entry_safe(task, tmp, &ft1->event.wait_list, event_list) {
+		if ((num != WAKEUP_ALL) && (cnt >= num))
+			break;
+
+		list_del(&task->event_list);
+		list_add_tail(&ft2->event.wait_list, &task->event_list);
+		task->wait_event = &ft2->event;
+
+		q = task->futex_q;
+		q->ft = ft2;
+		q->ftq = ftq2;
+		cnt++;
+	}
+
+	spin_unlock(&ft2->event.lock);
+	spin_unlock(&ft1->event.lock);
+
+	ft1->ref -= cnt;
+	ft2->ref += cnt;
+
+	return cnt;
+}
+
+static long futex_requeue(struct futex_queue *ftq1, struct futex_key *key1,
+		uint32_t *kaddr, struct futex_key *key2, uint32_t nr_wake,
+		uint32_t nr_requeue, int cmp, uint32_t cmpval)
+{
+	struct futex_queue *ftq2 = futex_hash(key2);
+	struct futex *ft1, *ft2;
+	long ret = 0;
+
+	futex_lock_pair(ftq1, ftq2);
+
+	if (cmp && (*kaddr != cmpval)) {
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	ft1 = futex_lookup(ftq1, key1);
+	if (!ft1)
+		goto out;
+
+	ret = futex_wake_locked(ft1, futex_wake_num(nr_wake));
+	if ((nr_requeue == 0) || futex_key_equal(key1, key2))
+		goto out;
+
+	ft2 = futex_lookup_create(ftq2, key2);
+	if (!ft2) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret += futex_requeue_locked(ft1, ft2, ftq2, futex_wake_num(nr_requeue));
+	futex_release_locked(ft2);
+	futex_release_locked(ft1);
+out:
+	futex_unlock_pair(ftq1, ftq2);
+
+	return ret;
+}
+
+static int futex_atomic_op(uint32_t *kaddr, uint32_t encoded_op, int *oldval)
+{
+	int op = (encoded_op >> 28) & 7;
+	int oparg = (int)(encoded_op << 8) >> 20;
+	int old, new;
+
+	if (encoded_op & (FUTEX_OP_OPARG_SHIFT << 28)) {
+		if ((oparg < 0) || (oparg > 31))
+			return -EINVAL;
+		oparg = 1 << oparg;
+	}
+
+	do {
+		old = *(volatile int *)kaddr;
+
+		switch (op) {
+		case FUTEX_OP_SET:
+			new = oparg;
+			break;
+		case FUTEX_OP_ADD:
+			new = old + oparg;
+			break;
+		case FUTEX_OP_OR:
+			new = old | oparg;
+			break;
+		case FUTEX_OP_ANDN:
+			new = old & ~oparg;
+			break;
+		case FUTEX_OP_XOR:
+			new = old ^ oparg;
+			break;
+		default:
+			return -ENOSYS;
+		}
+	} while (cmpxchg((int *)kaddr, old, new) != old);
+
+	*oldval = old;
+
+	return 0;
+}
+
+static int futex_op_cmp(uint32_t encoded_op, int oldval)
+{
+	int cmp = (encoded_op >> 24) & 15;
+	int cmparg = (int)(encoded_op << 20) >> 20;
+
+	switch (cmp) {
+	case FUTEX_OP_CMP_EQ:
+		return (oldval == cmparg);
+	case FUTEX_OP_CMP_NE:
+		return (oldval != cmparg);
+	case FUTEX_OP_CMP_LT:
+		return (oldval < cmparg);
+	case FUTEX_OP_CMP_LE:
+		return (oldval <= cmparg);
+	case FUTEX_OP_CMP_GT:
+		return (oldval > cmparg);
+	case FUTEX_OP_CMP_GE:
+		return (oldval >= cmparg);
+	default:
+		return -ENOSYS;
+	}
+}
+
+/*
+ * update the value at uaddr2, wake up nr_wake waiters on uaddr,
+ * and nr_wake2 waiters on uaddr2 if the old value of uaddr2
+ * matches the compare in the op.
+ */
+static long futex_wake_op(struct futex_queue *ftq1, struct futex_key *key1,
+		uint32_t *kaddr2, struct futex_key *key2, uint32_t nr_wake,
+		uint32_t nr_wake2, uint32_t op)
+{
+	struct futex_queue *ftq2 = futex_hash(key2);
+	struct futex *ft1, *ft2;
+	int oldval, cmp;
+	long ret;
+
+	futex_lock_pair(ftq1, ftq2);
+
+	ret = futex_atomic_op(kaddr2, op, &oldval);
+	if (ret)
+		goto out;
+
+	cmp = futex_op_cmp(op, oldval);
+	if (cmp < 0) {
+		ret = cmp;
+		goto out;
+	}
+
+	ft1 = futex_lookup(ftq1, key1);
+	if (ft1)
+		ret = futex_wake_locked(ft1, futex_wake_num(nr_wake));
+
+	if (cmp) {
+		ft2 = futex_lookup(ftq2, key2);
+		if (ft2)
+			ret += futex_wake_locked(ft2, futex_wake_num(nr_wake2));
+	}
+out:
+	futex_unlock_pair(ftq1, ftq2);
+
+	return ret;
 }
 
 static inline int is_wait_cmd(int cmd)
@@ -143,19 +546,16 @@ long sys_futex(uint32_t __user *uaddr, int op, uint32_t val,
 	struct vspace *vs = current->vs;
 	struct timespec *ktime = NULL;
 	struct futex_queue *ftq;
-	struct futex *ft = NULL, *tmp;
+	struct futex_key key, key2;
 	uint32_t *kaddr, *kaddr2 = NULL;
-	unsigned long paddr;
-	unsigned int key;
 	int cmd = op & FUTEX_CMD_MASK;
+	uint32_t val2;
 
 	kaddr = uva_to_kva(vs, ULONG(uaddr), sizeof(uint32_t), VM_RW);
 	if (kaddr == NULL)
 		return -EFAULT;
 
-	if (utime && (cmd == FUTEX_WAIT || cmd == FUTEX_LOCK_PI ||
-                      cmd == FUTEX_WAIT_BITSET ||
-                      cmd == FUTEX_WAIT_REQUEUE_PI)) {
+	if (utime && is_wait_cmd(cmd)) {
 		ktime = uva_to_kva(vs, ULONG(utime), sizeof(struct timespec), VM_RW);
 		if (ktime == NULL)
 			return -EFAULT;
@@ -165,46 +565,33 @@ long sys_futex(uint32_t __user *uaddr, int op, uint32_t val,
 		kaddr2 = uva_to_kva(vs, ULONG(uaddr2), sizeof(uint32_t), VM_RW);
 		if (kaddr2 == NULL)
 			return -EFAULT;
+		futex_get_key(uaddr2, kaddr2, op, &key2);
 	}
 
-	paddr = vtop(kaddr);
-	key = futex_key(paddr);
-	ASSERT(key < FUTEX_KEY_SIZE);
-	ftq = &ft_queue[key];
-
-	spin_lock(&ftq->lock);
-	list_for_each_entry(tmp, &ftq->head, list) {
-		if (tmp->paddr == paddr) {
-			ft = tmp;
-			break;
-		}
-	}
-
-	if (!ft && !is_wait_cmd(cmd)) {
-		spin_unlock(&ftq->lock);
-		return -ENOENT;
-	}
+	futex_get_key(uaddr, kaddr, op, &key);
+	ftq = futex_hash(&key);
 
-	if (!ft) {
-		ft = zalloc(sizeof(struct futex));
-		if (!ft) {
-			spin_unlock(&ftq->lock);
-			return -ENOMEM;
-		}
-
-		event_init(&ft->event, OS_EVENT_TYPE_FUTEX, ft);
-		ft->owner = current_pid;
-		ft->paddr = paddr;
-
-		list_add(&ftq->head, &ft->list);
-	}
-	spin_unlock(&ftq->lock);
+	/*
+	 * for requeue and wake_op, the timeout argument is the
+	 * second count.
+	 */
+	val2 = (uint32_t)ULONG(utime);
 
 	switch (cmd) {
 	case FUTEX_WAIT:
-		return sys_do_futex_wait(ft, kaddr, val, ktime, kaddr2, val3);
+		return futex_wait(ftq, &key, kaddr, val, ktime);
 	case FUTEX_WAKE:
-		return sys_do_futex_wake(ft, kaddr, val, ktime, kaddr2, val3);
+		return futex_wake(ftq, &key, val);
+	case FUTEX_REQUEUE:
+	case FUTEX_CMP_REQUEUE:
+		if (!kaddr2)
+			return -EINVAL;
+		return futex_requeue(ftq, &key, kaddr, &key2, val, val2,
+				cmd == FUTEX_CMP_REQUEUE, val3);
+	case FUTEX_WAKE_OP:
+		if (!kaddr2)
+			return -EINVAL;
+		return futex_wake_op(ftq, &key, kaddr2, &key2, val, val2, val3);
 	default:
 		break;
 	}
@@ -214,9 +601,23 @@ long sys_futex(uint32_t __user *uaddr, int op, uint32_t val,
 
 static int futex_subsys_init(void)
 {
+	unsigned int size = 1;
 	int i;
 
-	for (i = 0; i < FUTEX_KEY_SIZE; i++) {
+	/*
+	 * NR_CPUS * FUTEX_HASH_PER_CPU buckets, round up to power of 2.
+	 */
+	ft_hash_bits = 0;
+	while (size < NR_CPUS * FUTEX_HASH_PER_CPU) {
+		size <<= 1;
+		ft_hash_bits++;
+	}
+
+	ft_queue = get_free_pages(PAGE_BALIGN(size * sizeof(struct futex_queue))
+			>> PAGE_SHIFT, GFP_KERNEL);
+	ASSERT(ft_queue != NULL);
+
+	for (i = 0; i < size; i++) {
 		init_list(&ft_queue[i].head);
 		spin_lock_init(&ft_queue[i].lock);
 	}
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <minos/minos.h>
+#include <minos/mm.h>
+#include <minos/bitops.h>
+#include <uspace/kobject.h>
+#include <uspace/uaccess.h>
+#include <uspace/vspace.h>
+#include <uspace/proc.h>
+#include <uspace/grant.h>
+
+static inline unsigned long grant_vm_flags(int right)
+{
+	return ((right & KOBJ_RIGHT_WRITE) ? VM_RW : VM_RO) | VM_SHARED;
+}
+
+static int grant_alloc_slot(struct process *proc, unsigned long *base)
+{
+	int slot;
+
+	spin_lock(&proc->lock);
+	slot = find_first_zero_bit(proc->grant_slot, PROC_GRANT_SLOTS);
+	if (slot < PROC_GRANT_SLOTS)
+		set_bit(slot, proc->grant_slot);
+	spin_unlock(&proc->lock);
+
+	if (slot >= PROC_GRANT_SLOTS)
+		return -ENOSPC;
+
+	*base = PROC_GRANT_BASE + slot * PROC_GRANT_SLOT_SIZE;
+
+	return 0;
+}
+
+static void grant_free_slot(struct process *proc, unsigned long base)
+{
+	int slot = (base - PROC_GRANT_BASE) / PROC_GRANT_SLOT_SIZE;
+
+	spin_lock(&proc->lock);
+	clear_bit(slot, proc->grant_slot);
+	spin_unlock(&proc->lock);
+}
+
+static int grant_map_range(struct ipc_grant *ig, struct process *proc,
+		struct kobject_grant *kg, unsigned long base)
+{
+	unsigned long flags = grant_vm_flags(kg->right);
+	unsigned long offset;
+	phy_addr_t pa;
+	int ret = 0;
+
+	for (offset = 0; offset < kg->size; offset += PAGE_SIZE) {
+		pa = arch_translate_va_to_pa(ig->vs, kg->addr + offset);
+		if (pa == INVALID_ADDR) {
+			ret = -EFAULT;
+			break;
+		}
+
+		ret = map_process_memory(proc, base + offset, PAGE_SIZE, pa, flags);
+		if (ret)
+			break;
+	}
+
+	if (ret && offset)
+		unmap_process_memory(proc, base, offset);
+
+	return ret;
+}
+
+static void grant_unmap(struct ipc_grant *ig, struct process *proc, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		unmap_process_memory(proc, ig->map[i], ig->grant[i].size);
+		grant_free_slot(proc, ig->map[i]);
+	}
+}
+
+/*
+ * copy the grant table from the sender and fault in all the
+ * granted pages. the vspace of the sender is marked as in use
+ * until the grant is released, so the pages will not be freed
+ * even the sender unmap them when they are still granted.
+ */
+int ipc_grant_setup(struct ipc_grant *ig,
+		struct kobject_grant __user *grant, int nr)
+{
+	struct vspace *vs = current->vs;
+	struct kobject_grant *kg;
+	unsigned long va;
+	int i, ret;
+
+	if ((nr <= 0) || (nr > KOBJ_GRANT_MAX))
+		return -EINVAL;
+
+	ret = copy_from_user(ig->grant, grant,
+			nr * sizeof(struct kobject_grant));
+	if (ret <= 0)
+		return -EFAULT;
+
+	for (i = 0; i < nr; i++) {
+		kg = &ig->grant[i];
+		if (!IS_PAGE_ALIGN(kg->addr) || !IS_PAGE_ALIGN(kg->size) ||
+				(kg->size == 0) || (kg->size > KOBJ_GRANT_MAX_SIZE))
+			return -EINVAL;
+
+		/*
+		 * only the private memory of the process can be
+		 * granted, the shared region is not allowed.
+		 */
+		if ((kg->addr >= PROCESS_TOP_HALF_BASE) ||
+				(kg->addr + kg->size > PROCESS_TOP_HALF_BASE))
+			return -EINVAL;
+
+		if (!(kg->right & KOBJ_RIGHT_READ) ||
+				(kg->right & ~KOBJ_RIGHT_RW))
+			return -EINVAL;
+
+		for (va = kg->addr; va < kg->addr + kg->size; va += PAGE_SIZE) {
+			if (uaccess_va_to_pa(vs, va, kg->right &
+					KOBJ_RIGHT_WRITE) == INVALID_ADDR)
+				return -EFAULT;
+		}
+	}
+
+	ig->nr = nr;
+	ig->vs = vs;
+	ig->target = NULL;
+	inc_vspace_usage(vs);
+
+	return 0;
+}
+
+/*
+ * map the granted pages to the receiver, the address of each
+ * range in the receiver is returned by the extra buffer.
+ */
+int ipc_grant_map(struct ipc_grant *ig, struct process *proc,
+		void __user *extra, size_t extra_size, size_t *actual_extra)
+{
+	size_t size = ig->nr * sizeof(struct kobject_grant);
+	struct kobject_grant kg[KOBJ_GRANT_MAX];
+	int i, ret = 0;
+
+	if (extra_size < size)
+		return -EINVAL;
+
+	for (i = 0; i < ig->nr; i++) {
+		ret = grant_alloc_slot(proc, &ig->map[i]);
+		if (ret)
+			goto out;
+
+		ret = grant_map_range(ig, proc, &ig->grant[i], ig->map[i]);
+		if (ret) {
+			grant_free_slot(proc, ig->map[i]);
+			goto out;
+		}
+
+		kg[i] = ig->grant[i];
+		kg[i].addr = ig->map[i];
+	}
+
+	if (copy_to_user(extra, kg, size) <= 0) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	kobject_get(&proc->kobj);
+	*actual_extra = size;
+	smp_wmb();
+	ig->target = proc;
+
+	return 0;
+out:
+	grant_unmap(ig, proc, i);
+	return ret;
+}
+
+/*
+ * called when the message is replied or the sender finished
+ * the sending, whoever comes first unmaps the pages.
+ */
+void ipc_grant_revoke(struct ipc_grant *ig)
+{
+	struct process *proc;
+
+	proc = xchg(&ig->target, NULL);
+	if (!proc)
+		return;
+
+	grant_unmap(ig, proc, ig->nr);
+	kobject_put(&proc->kobj);
+}
+
+void ipc_grant_release(struct ipc_grant *ig)
+{
+	ipc_grant_revoke(ig);
+	dec_vspace_usage(ig->vs);
+}
@@ -16,111 +16,132 @@
 
 #include <minos/minos.h>
 #include <minos/mm.h>
+#include <minos/percpu.h>
+#include <minos/smp.h>
 #include <uspace/kobject.h>
 #include <uspace/handle.h>
 #include <uspace/proc.h>
 
 #define KOBJ_PLACEHOLDER	(struct kobject *)(-1)
 
-#define to_handle_table_desc(hdesc)	\
-	(struct handle_table_desc *)&hdesc[NR_DESC_PER_PAGE]
+/*
+ * the handle lookup does not take the lock of the process. the
+ * reader increases the sequence of this cpu when it enters and
+ * leaves the read side, so the sequence is odd inside. before the
+ * kobject of a released handle is put, the releaser waits each
+ * cpu which was inside to leave once, then no reader can still
+ * see the old kobject. a cpu which enters again in the meantime
+ * does not block the releaser.
+ */
+static DEFINE_PER_CPU(unsigned long, handle_read_seq);
 
-static struct handle_desc *new_handle_desc_table(uint32_t index)
+static inline void handle_read_lock(void)
 {
-	struct handle_desc *dt;
-	struct handle_table_desc *htd;
-
-	if (index >= PROC_MAX_HANDLE) {
-		pr_err("handle table too big exceed %d\n", PROC_MAX_HANDLE);
-		return NULL;
-	}
-
-	dt = get_free_page(GFP_KERNEL);
-	if (!dt)
-		return NULL;
-	memset(dt, 0, PAGE_SIZE);
+	preempt_disable();
+	get_cpu_var(handle_read_seq)++;
+	smp_mb();
+}
 
-	htd = to_handle_table_desc(dt);
-	htd->left = NR_DESC_PER_PAGE;
-	htd->index = index;
-	htd->next = NULL;
+static inline void handle_read_unlock(void)
+{
+	smp_mb();
+	get_cpu_var(handle_read_seq)++;
+	preempt_enable();
+}
 
-	return dt;
+static inline unsigned long handle_read_seq_of(int cpu)
+{
+	return *(volatile unsigned long *)&get_per_cpu(handle_read_seq, cpu);
 }
 
-static int __alloc_new_handle(struct handle_table_desc *htd,
-		handle_t *handle, struct handle_desc **hd)
+static void handle_sync_readers(void)
 {
-	struct handle_desc *table;
-	struct handle_table_desc *new_htd;
+	unsigned long seq[NR_CPUS];
+	int cpu;
 
-	table = new_handle_desc_table(htd->index + NR_DESC_PER_PAGE);
-	if (!table)
-		return -ENOMEM;
+	smp_mb();
 
-	htd->next = table;
-	new_htd = to_handle_table_desc(table);
-	new_htd->left -= 1;
+	for_each_online_cpu(cpu)
+		seq[cpu] = handle_read_seq_of(cpu);
 
-	*handle = new_htd->index;
-	*hd = &table[0];
+	for_each_online_cpu(cpu) {
+		if (!(seq[cpu] & 1))
+			continue;
 
-	return 0;
+		while (handle_read_seq_of(cpu) == seq[cpu])
+			cpu_relax();
+	}
+
+	smp_mb();
 }
 
-static int lookup_handle_desc(struct process *proc, handle_t handle,
-		struct handle_desc **hd,
-		struct handle_table_desc **htd)
+static inline struct handle_desc *handle_to_desc(struct handle_table *ht,
+		handle_t handle)
 {
-	struct handle_desc *table = proc->handle_desc_table;
-	struct handle_table_desc *tdesc = to_handle_table_desc(table);
+	uint32_t idx = handle_index(handle);
+	struct handle_desc *page;
 
-	while (handle >= NR_DESC_PER_PAGE) {
-		handle -= NR_DESC_PER_PAGE;
-		table = tdesc->next;
-		tdesc = to_handle_table_desc(table);
-	}
+	if (idx >= ht->max_handle)
+		return NULL;
 
-	*hd = &table[handle];
-	*htd = tdesc;
+	page = ht->pages[idx / NR_DESC_PER_PAGE];
+	if (!page)
+		return NULL;
+	smp_rmb();
 
-	return 0;
+	return &page[idx % NR_DESC_PER_PAGE];
 }
 
-void __release_handle(struct process *proc, handle_t handle)
+/*
+ * find the descriptor with the lock of the process, the
+ * generation of the handle must match.
+ */
+static struct handle_desc *lookup_handle_desc(struct process *proc,
+		handle_t handle)
 {
 	struct handle_desc *hd;
-	struct handle_table_desc *htd;
-	int ret;
 
-	spin_lock(&proc->lock);
-	ret = lookup_handle_desc(proc, handle, &hd, &htd);
-	if (ret)
-		goto out;
+	hd = handle_to_desc(proc->handle_table, handle);
+	if (!hd || (hd->gen != handle_gen(handle)))
+		return NULL;
 
-	if (hd->kobj == NULL)
-		goto out;
+	return hd;
+}
 
+static inline void handle_desc_clear(struct handle_table *ht,
+		handle_t handle, struct handle_desc *hd)
+{
 	hd->kobj = NULL;
 	hd->right = KOBJ_RIGHT_NONE;
-	htd->left++;
-out:
+	hd->gen = (hd->gen + 1) & HANDLE_GEN_MASK;
+	ht->left[handle_index(handle) / NR_DESC_PER_PAGE]++;
+}
+
+void __release_handle(struct process *proc, handle_t handle)
+{
+	struct handle_desc *hd;
+
+	spin_lock(&proc->lock);
+	hd = lookup_handle_desc(proc, handle);
+	if (hd && (hd->kobj != NULL))
+		handle_desc_clear(proc->handle_table, handle, hd);
 	spin_unlock(&proc->lock);
 }
 
 int release_process_handle(struct process *proc, handle_t handle, struct kobject **kobj, right_t *right)
 {
 	struct handle_desc *hd;
-	struct handle_table_desc *htd;
-	int ret = -ENOENT;
+	int ret = 0;
 
 	if (WRONG_HANDLE(handle) || !proc)
 		return -ENOENT;
 
 	spin_lock(&proc->lock);
-	ret = lookup_handle_desc(proc, handle, &hd, &htd);
-	if (ret)
+	hd = lookup_handle_desc(proc, handle);
+	if (!hd) {
+		ret = -ENOENT;
 		goto out;
+	}
 
 	if (hd->kobj == NULL || hd->kobj == KOBJ_PLACEHOLDER) {
 		ret = -EPERM;
@@ -129,13 +150,17 @@ int release_process_handle(struct process *proc, handle_t handle, struct kobject
 
 	*kobj = hd->kobj;
 	*right = hd->right;
-
-	hd->kobj = NULL;
-	hd->right = KOBJ_RIGHT_NONE;
-	htd->left++;
+	handle_desc_clear(proc->handle_table, handle, hd);
 out:
 	spin_unlock(&proc->lock);
 
+	/*
+	 * the caller will put the kobject, wait the lockless
+	 * readers which may still see it.
+	 */
+	if (ret == 0)
+		handle_sync_readers();
+
 	return ret;
 }
 
@@ -144,21 +169,47 @@ int release_handle(handle_t handle, struct kobject **kobj, right_t *right)
 	return release_process_handle(current_proc, handle, kobj, right);
 }
 
-static inline int __alloc_handle_internal(struct handle_desc *desc,
-		struct handle_table_desc *htd, handle_t *handle,
-		struct handle_desc **hd)
+static int new_handle_page(struct handle_table *ht)
 {
-	int i;
+	struct handle_desc *page;
 
-	if (htd->left == 0)
+	if ((ht->nr_pages >= HANDLE_TABLE_PAGES) ||
+			(ht->nr_pages * NR_DESC_PER_PAGE >= ht->max_handle)) {
+		pr_err("handle table too big exceed %d\n", ht->max_handle);
 		return -ENOSPC;
+	}
+
+	page = get_free_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+	memset(page, 0, PAGE_SIZE);
+
+	ht->left[ht->nr_pages] = NR_DESC_PER_PAGE;
+	smp_wmb();
+	ht->pages[ht->nr_pages++] = page;
+
+	return 0;
+}
+
+static int __alloc_handle_internal(struct handle_table *ht, int pidx,
+		handle_t *handle, struct handle_desc **hd)
+{
+	struct handle_desc *page = ht->pages[pidx];
+	uint32_t idx;
+	int i;
 
 	for (i = 0; i < NR_DESC_PER_PAGE; i++) {
-		if (desc[i].kobj == NULL) {
-			*handle = i + htd->index;
-			*hd = &desc[i];
-			return 0;
-		}
+		if (page[i].kobj != NULL)
+			continue;
+
+		idx = pidx * NR_DESC_PER_PAGE + i;
+		if (idx >= ht->max_handle)
+			return -ENOSPC;
+
+		ht->left[pidx]--;
+		*handle = make_handle(idx, page[i].gen);
+		*hd = &page[i];
+		return 0;
 	}
 
 	ASSERT(0);
@@ -167,40 +218,44 @@ static inline int __alloc_handle_internal(struct handle_desc *desc,
 
 handle_t __alloc_handle(struct process *proc, struct kobject *kobj, right_t right)
 {
-	struct handle_desc *hd = proc->handle_desc_table;
-	struct handle_table_desc *htd = to_handle_table_desc(hd);
+	struct handle_table *ht = proc->handle_table;
 	handle_t handle = HANDLE_NULL;
 	struct handle_desc *hdesc;
-	int ret = -ENOSPC;
+	int ret = -ENOSPC, i;
 
 	ASSERT(kobj != NULL);
 	ASSERT(proc != NULL);
 
 	spin_lock(&proc->lock);
 
-	do {
-		ret = __alloc_handle_internal(hd, htd, &handle, &hdesc);
+	for (i = 0; i < ht->nr_pages; i++) {
+		if (ht->left[i] == 0)
+			continue;
+
+		ret = __alloc_handle_internal(ht, i, &handle, &hdesc);
 		if (ret == 0)
 			break;
-		hd = htd->next;
-	} while (hd != NULL);
+	}
 
 	if (ret != 0) {
-		ret = __alloc_new_handle(htd, &handle, &hdesc);
+		ret = new_handle_page(ht);
+		if (ret == 0)
+			ret = __alloc_handle_internal(ht, ht->nr_pages - 1,
+					&handle, &hdesc);
 		if (ret) {
 			handle = HANDLE_NULL;
 			goto out;
 		}
 	}
 
-	hdesc->kobj = kobj;
 	hdesc->right = right;
-
 	if (kobj != KOBJ_PLACEHOLDER)
 		kobject_get(kobj);
+	smp_wmb();
+	hdesc->kobj = kobj;
 out:
 	spin_unlock(&proc->lock);
-	
+
 	return handle;
 }
 
@@ -213,20 +268,22 @@ static int setup_handle(struct process *proc, handle_t handle,
 		struct kobject *kobj, right_t right)
 {
 	struct handle_desc *hd;
-	struct handle_table_desc *htd;
-	int ret;
+	int ret = 0;
 
 	ASSERT(!WRONG_HANDLE(handle));
 
 	spin_lock(&proc->lock);
-	ret = lookup_handle_desc(proc, handle, &hd, &htd);
-	if (ret)
+	hd = lookup_handle_desc(proc, handle);
+	if (!hd) {
+		ret = -ENOENT;
 		goto out;
+	}
 
 	ASSERT(hd->kobj == KOBJ_PLACEHOLDER);
-	hd->kobj = kobj;
 	hd->right = right;
 	kobject_get(kobj);
+	smp_wmb();
+	hd->kobj = kobj;
 out:
 	spin_unlock(&proc->lock);
 	return ret;
@@ -235,12 +292,11 @@ out:
 handle_t send_handle(struct process *proc, struct process *pdst,
 		handle_t handle, right_t right_send)
 {
-	struct handle_table_desc *htd;
 	struct handle_desc *hdesc;
 	struct kobject *kobj;
 	int handle_ret;
 	int right;
-	int ret;
+	int ret = 0;
 
 	if (WRONG_HANDLE(handle))
 		return -EINVAL;
@@ -256,9 +312,11 @@ handle_t send_handle(struct process *proc, struct process *pdst,
 		return handle_ret;
 
 	spin_lock(&proc->lock);
-	ret = lookup_handle_desc(proc, handle, &hdesc, &htd);
-	if (ret)
+	hdesc = lookup_handle_desc(proc, handle);
+	if (!hdesc) {
+		ret = -ENOENT;
 		goto out;
+	}
 
 	kobj = hdesc->kobj;
 	right = hdesc->right;
@@ -280,10 +338,16 @@ handle_t send_handle(struct process *proc, struct process *pdst,
 		goto out;
 	}
 
+	/*
+	 * take the reference for the target before unlock, the
+	 * handle may be closed by other thread after that.
+	 */
 	hdesc->right = right & (~right_send | kobj->right_mask);
+	kobject_get(kobj);
 	spin_unlock(&proc->lock);
 
 	setup_handle(pdst, handle_ret, kobj, right_send);
+	kobject_put(kobj);
 
 	return handle_ret;
 
@@ -320,33 +384,54 @@ out:
 	return ret;
 }
 
+/*
+ * lockless lookup, the kobject and the right are read again after
+ * getting the kobject, if the descriptor has been changed, the
+ * handle has been released or granted at the same time, retry.
+ */
 int get_kobject_from_process(struct process *proc, handle_t handle,
 			struct kobject **kobj, right_t *right)
 {
-	int ret;
-	struct kobject *tmp;
 	struct handle_desc *hd;
-	struct handle_table_desc *htd;
+	struct kobject *tmp;
+	int gen, ret = -ENOENT;
+	right_t r;
 
 	if (WRONG_HANDLE(handle) || !proc)
 		return -ENOENT;
 
-	spin_lock(&proc->lock);
-	ret = lookup_handle_desc(proc, handle, &hd, &htd);
-	if (ret)
+	handle_read_lock();
+
+	hd = handle_to_desc(proc->handle_table, handle);
+	if (!hd)
 		goto out;
 
-	tmp = hd->kobj;
+	do {
+		gen = hd->gen;
+		smp_rmb();
+		tmp = hd->kobj;
+		r = hd->right;
+		smp_rmb();
+
+		if ((gen != handle_gen(handle)) || (tmp == NULL) ||
+				(tmp == KOBJ_PLACEHOLDER))
+			goto out;
 
-	if ((tmp != NULL) && (tmp != KOBJ_PLACEHOLDER)) {
-		if (kobject_get(tmp)) {
-			*kobj = tmp;
-			*right = hd->right;
-			ret = 0;
-		}
-	}
+		if (!kobject_get(tmp))
+			goto out;
+
+		smp_rmb();
+		if ((hd->gen == gen) && (hd->kobj == tmp) && (hd->right == r))
+			break;
+
+		kobject_put(tmp);
+	} while (1);
+
+	*kobj = tmp;
+	*right = r;
+	ret = 0;
 out:
-	spin_unlock(&proc->lock);
+	handle_read_unlock();
 	return ret;
 }
 
@@ -362,53 +447,72 @@ int put_kobject(struct kobject *kobj)
 
 void process_handles_deinit(struct process *proc)
 {
-	struct handle_desc *table = proc->handle_desc_table;
-	struct handle_table_desc *tdesc = to_handle_table_desc(table);
-	struct handle_desc *tmp;
-
-	while (table != NULL) {
-		tmp = tdesc->next;
-		tdesc = to_handle_table_desc(tmp);
-		free_pages(table);
-		table = tmp;
-	}
+	struct handle_table *ht = proc->handle_table;
+	int i;
+
+	for (i = 0; i < ht->nr_pages; i++)
+		free_pages(ht->pages[i]);
+
+	free(ht);
+	proc->handle_table = NULL;
 }
 
-static void release_handle_table(struct process *proc, struct handle_desc *table)
+void release_proc_kobjects(struct process *proc)
 {
-	struct handle_desc *hdesc = table;
-	int i;
+	struct handle_table *ht = proc->handle_table;
+	struct handle_desc *hdesc;
+	int i, j;
 
-	for (i = 0; i < NR_DESC_PER_PAGE; i++) {
-		if ((hdesc->kobj) && (hdesc->kobj != KOBJ_PLACEHOLDER))
-			kobject_close(hdesc->kobj, hdesc->right, proc);
-		hdesc++;
+	for (i = 0; i < ht->nr_pages; i++) {
+		hdesc = ht->pages[i];
+		for (j = 0; j < NR_DESC_PER_PAGE; j++, hdesc++) {
+			if ((hdesc->kobj) && (hdesc->kobj != KOBJ_PLACEHOLDER))
+				kobject_close(hdesc->kobj, hdesc->right, proc);
+		}
 	}
 }
 
-void release_proc_kobjects(struct process *proc)
+/*
+ * the limit can not be less than the handles which have been
+ * allocated, since the pages of the table are never freed.
+ */
+int set_process_handle_limit(struct process *proc, uint32_t max)
 {
-	struct handle_desc *table = proc->handle_desc_table;
-	struct handle_table_desc *tdesc = to_handle_table_desc(table);
-	struct handle_desc *tmp;
-
-	while (table != NULL) {
-		tmp = tdesc->next;
-		tdesc = to_handle_table_desc(tmp);
-		release_handle_table(proc, table);
-		table = tmp;
-	}
+	struct handle_table *ht = proc->handle_table;
+	int ret = 0;
+
+	if ((max == 0) || (max > PROC_MAX_HANDLE))
+		return -EINVAL;
+
+	spin_lock(&proc->lock);
+	if (max < ht->nr_pages * NR_DESC_PER_PAGE)
+		ret = -EBUSY;
+	else
+		ht->max_handle = max;
+	spin_unlock(&proc->lock);
+
+	return ret;
 }
 
 int init_proc_handles(struct process *proc)
 {
 	extern struct kobject stdio_kobj;
+	struct handle_table *ht;
 	handle_t handle;
 
-	proc->handle_desc_table = new_handle_desc_table(0);
-	if (!proc->handle_desc_table)
+	ht = zalloc(sizeof(struct handle_table));
+	if (!ht)
 		return -ENOMEM;
 
+	ht->max_handle = PROC_DEFAULT_MAX_HANDLE;
+	proc->handle_table = ht;
+
+	if (new_handle_page(ht)) {
+		free(ht);
+		proc->handle_table = NULL;
+		return -ENOMEM;
+	}
+
 	/*
 	 * Main task kobj is 0, process can use this handle
 	 * to control itself.
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <minos/minos.h>
+#include <minos/mm.h>
+#include <minos/time.h>
+#include <minos/atomic.h>
+#include <minos/sched.h>
+#include <minos/bitmap.h>
+#include <uspace/kobject.h>
+#include <uspace/ipcstat.h>
+
+static struct kobject *ipc_stat_pma;
+static struct ipc_stat *ipc_stats;
+static struct ipc_trace_ring *ipc_trace_ring;
+static atomic_t ipc_trace_head;
+static DEFINE_SPIN_LOCK(ipc_stat_lock);
+
+/*
+ * the stat memory is mapped to the user space, the slot owner
+ * is tracked here, not by the type in the slot.
+ */
+static DECLARE_BITMAP(ipc_stat_bitmap, IPC_STAT_MAX);
+
+struct ipc_stat *ipc_stat_alloc(int type)
+{
+	struct ipc_stat *stat = NULL;
+	int id;
+
+	if (!ipc_stats)
+		return NULL;
+
+	spin_lock(&ipc_stat_lock);
+	id = find_first_zero_bit(ipc_stat_bitmap, IPC_STAT_MAX);
+	if (id < IPC_STAT_MAX) {
+		set_bit(id, ipc_stat_bitmap);
+		stat = &ipc_stats[id];
+		memset(stat, 0, sizeof(struct ipc_stat));
+		stat->owner = current_pid;
+		stat->type = type;
+	}
+	spin_unlock(&ipc_stat_lock);
+
+	return stat;
+}
+
+void ipc_stat_free(struct ipc_stat *stat)
+{
+	if (!stat)
+		return;
+
+	spin_lock(&ipc_stat_lock);
+	stat->type = 0;
+	clear_bit(stat - ipc_stats, ipc_stat_bitmap);
+	spin_unlock(&ipc_stat_lock);
+}
+
+void ipc_stat_latency(unsigned long long *hist, unsigned long ns)
+{
+	unsigned long us = ns / 1000;
+	int idx;
+
+	idx = us ? (fls_long(us)) : 0;
+	if (idx >= IPC_LAT_BUCKETS)
+		idx = IPC_LAT_BUCKETS - 1;
+
+	hist[idx]++;
+}
+
+/*
+ * the entry may be overwritten when the ring is wrapped, the
+ * reader need to drop the entries older than head - entries.
+ */
+void ipc_trace(struct ipc_stat *stat, int type, int sender,
+		int receiver, long token)
+{
+	struct ipc_trace_event *ev;
+	unsigned int idx;
+
+	if (!stat || !ipc_trace_ring || !ipc_trace_ring->enabled)
+		return;
+
+	idx = (unsigned int)atomic_inc_return_old(&ipc_trace_head);
+	ev = &ipc_trace_ring->events[idx & (IPC_TRACE_ENTRIES - 1)];
+	ev->ts = get_current_time();
+	ev->type = type;
+	ev->stat_id = stat - ipc_stats;
+	ev->sender = sender;
+	ev->receiver = receiver;
+	ev->token = token;
+	smp_wmb();
+	ipc_trace_ring->head = idx + 1;
+}
+
+struct kobject *ipc_stat_kobject(void)
+{
+	return ipc_stat_pma;
+}
+
+int ipc_stat_init(void)
+{
+	struct pma_create_arg args;
+	uint32_t memsz;
+	right_t right;
+	void *addr;
+	int ret;
+
+	memsz = IPC_TRACE_OFFSET + sizeof(struct ipc_trace_ring);
+	memsz = PAGE_BALIGN(memsz);
+	addr = get_free_pages(memsz >> PAGE_SHIFT, GFP_USER);
+	if (!addr)
+		return -ENOMEM;
+
+	memset(addr, 0, memsz);
+	args.type = PMA_TYPE_PMEM;
+	args.right = KOBJ_RIGHT_RW;
+	args.consequent = 1;
+	args.start = vtop(addr);
+	args.size = memsz;
+	ret = create_new_pma(&ipc_stat_pma, &right, &args);
+	if (ret) {
+		free_pages(addr);
+		return ret;
+	}
+
+	ipc_trace_ring = addr + IPC_TRACE_OFFSET;
+	ipc_trace_ring->entries = IPC_TRACE_ENTRIES;
+	smp_wmb();
+	ipc_stats = addr;
+	pr_info("ipc stat memory size 0x%x\n", memsz);
+
+	return 0;
+}
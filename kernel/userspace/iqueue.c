@@ -17,11 +17,13 @@
 #include <minos/minos.h>
 #include <minos/mm.h>
 #include <minos/sched.h>
+#include <minos/time.h>
 #include <uspace/poll.h>
 #include <uspace/kobject.h>
 #include <uspace/uaccess.h>
 #include <uspace/iqueue.h>
 #include <uspace/proc.h>
+#include <uspace/grant.h>
 
 #include "kobject_copy.h"
 
@@ -30,6 +32,226 @@
 
 #define KOBJ_IN_PROCESSING ((void *)-1)
 
+/*
+ * if the sender granted pages with this message, map them to
+ * the receiver and return the grant table by the extra buffer.
+ */
+static long iqueue_copy_payload(struct task *sender, size_t *actual_data,
+		void __user *extra, size_t extra_size, size_t *actual_extra)
+{
+	long ret;
+
+	if (sender->ipc_grant && current->ipc_fast)
+		return -EINVAL;
+
+	if (sender->ipc_fast || current->ipc_fast)
+		return kobject_copy_ipc_fast(current, sender,
+				actual_data, actual_extra);
+
+	if (!sender->ipc_grant)
+		return kobject_copy_ipc_payload(current, sender,
+				actual_data, actual_extra, 1, 0);
+
+	ret = kobject_copy_ipc_data(current, sender, 1);
+	if (ret < 0)
+		return ret;
+	*actual_data = ret;
+
+	return ipc_grant_map(sender->ipc_grant, current_proc,
+			extra, extra_size, actual_extra);
+}
+
+/*
+ * the statistics are updated with the lock of the iqueue held.
+ */
+static void iqueue_stat_send(struct iqueue *iqueue,
+		struct imsg *imsg, size_t size)
+{
+	struct ipc_stat *stat = iqueue->stat;
+
+	if (!stat)
+		return;
+
+	imsg->send_ns = get_current_time();
+	stat->msgs++;
+	stat->bytes += size;
+	if (++stat->depth > stat->depth_max)
+		stat->depth_max = stat->depth;
+
+	ipc_trace(stat, IPC_TRACE_SEND, current_tid, 0, 0);
+}
+
+static void iqueue_stat_recv(struct iqueue *iqueue, struct imsg *imsg)
+{
+	struct ipc_stat *stat = iqueue->stat;
+
+	if (!stat)
+		return;
+
+	imsg->recv_ns = get_current_time();
+	ipc_stat_latency(stat->queue_lat, imsg->recv_ns - imsg->send_ns);
+	ipc_trace(stat, IPC_TRACE_RECV, ((struct task *)imsg->data)->tid,
+			current_tid, imsg->token);
+}
+
+static void iqueue_stat_reply(struct iqueue *iqueue, struct imsg *imsg, long token)
+{
+	struct ipc_stat *stat = iqueue->stat;
+
+	if (!stat)
+		return;
+
+	/*
+	 * the request submitted by the kernel is not received
+	 * by iqueue_recv, there is no receive time for it.
+	 */
+	if (imsg->recv_ns)
+		ipc_stat_latency(stat->serve_lat, get_current_time() - imsg->recv_ns);
+	ipc_trace(stat, IPC_TRACE_REPLY, ((struct task *)imsg->data)->tid,
+			current_tid, token);
+}
+
+static void iqueue_del_pending(struct iqueue *iqueue, struct imsg *imsg)
+{
+	list_del(&imsg->list);
+	if (iqueue->stat)
+		iqueue->stat->depth--;
+}
+
+static int iqueue_alloc_slot(struct iqueue *iqueue, struct imsg *imsg)
+{
+	struct iqueue_slot *slot;
+	int idx;
+
+	if (iqueue->slot_map == ~0UL)
+		return -EBUSY;
+
+	idx = ffz(iqueue->slot_map);
+	iqueue->slot_map |= (1UL << idx);
+
+	slot = &iqueue->slots[idx];
+	if (++slot->gen == 0)
+		slot->gen = 1;
+	slot->imsg = imsg;
+
+	imsg->slot = idx;
+	imsg->token = ((long)slot->gen << IQUEUE_SLOT_SHIFT) | idx;
+
+	return 0;
+}
+
+static void iqueue_free_slot(struct iqueue *iqueue, struct imsg *imsg)
+{
+	iqueue->slots[imsg->slot].imsg = NULL;
+	iqueue->slot_map &= ~(1UL << imsg->slot);
+	imsg->slot = -1;
+
+	if (iqueue->slot_waiters)
+		wake(&iqueue->slot_event, 0);
+}
+
+static struct imsg *iqueue_token_to_imsg(struct iqueue *iqueue, long token)
+{
+	unsigned long idx = token & IQUEUE_SLOT_MASK;
+	struct iqueue_slot *slot;
+
+	if ((token <= 0) || (idx >= IQUEUE_NR_SLOTS))
+		return NULL;
+
+	/*
+	 * the generation is not matched means the request has
+	 * been replied or cancelled, the token is stale.
+	 */
+	slot = &iqueue->slots[idx];
+	if (slot->gen != (uint32_t)(token >> IQUEUE_SLOT_SHIFT))
+		return NULL;
+
+	return slot->imsg;
+}
+
+/*
+ * the request from a higher priority sender is handled first,
+ * the same priority requests are still in fifo order.
+ */
+static void iqueue_add_pending(struct iqueue *iqueue, struct imsg *imsg)
+{
+	struct task *task = imsg->data;
+	struct imsg *tmp;
+
+	if (iqueue->prio) {
+		list_for_each_entry(tmp, &iqueue->pending_list, list) {
+			if (((struct task *)tmp->data)->prio > task->prio) {
+				list_insert_before(&tmp->list, &imsg->list);
+				return;
+			}
+		}
+	}
+
+	list_add_tail(&iqueue->pending_list, &imsg->list);
+}
+
+/*
+ * the reader which inherited the sender's priority keeps the
+ * iqueue and the token of that request, and runs at the raised
+ * priority until the request is finished, by its own reply, by
+ * the reply of another thread which the token was handed to, or
+ * by the sender being cancelled. the token is checked when the
+ * reader replies and each time it enters the kernel.
+ */
+static void iqueue_drop_prio(struct task *task)
+{
+	struct iqueue *iqueue = task->prio_iqueue;
+
+	task->prio_iqueue = NULL;
+	task->prio_token = 0;
+	kobject_put(iqueue->kobj);
+}
+
+static void iqueue_check_prio(void)
+{
+	struct iqueue *iqueue = current->prio_iqueue;
+
+	if (!iqueue || iqueue_token_to_imsg(iqueue, current->prio_token))
+		return;
+
+	iqueue_drop_prio(current);
+	sched_set_prio(current->orig_prio);
+}
+
+/*
+ * called by task_exit_from_user() when the task is running at
+ * the inherited priority, the task is always current.
+ */
+void iqueue_prio_exit_from_user(struct task *task)
+{
+	iqueue_check_prio();
+}
+
+static void iqueue_inherit_prio(struct iqueue *iqueue,
+		struct task *sender, long token)
+{
+	if (!iqueue->prio || (sender->prio >= current->prio))
+		return;
+
+	if (current->prio_iqueue)
+		iqueue_drop_prio(current);
+
+	kobject_get(iqueue->kobj);
+	current->prio_iqueue = iqueue;
+	current->prio_token = token;
+	sched_set_prio(sender->prio);
+}
+
+static int iqueue_release_task(void *item, void *data)
+{
+	struct task *task = (struct task *)item;
+
+	if (task->prio_iqueue)
+		iqueue_drop_prio(task);
+
+	return 0;
+}
+
 long iqueue_recv(struct iqueue *iqueue, void __user *data,
 		size_t data_size, size_t *actual_data, void __user *extra,
 		size_t extra_size, size_t *actual_extra, uint32_t timeout)
@@ -37,29 +259,86 @@ long iqueue_recv(struct iqueue *iqueue, void __user *data,
 	struct imsg *imsg = NULL;
 	long ret = 0;
 
-	if (iqueue->wstate == IQ_STAT_CLOSED)
+	if ((iqueue->wstate == IQ_STAT_CLOSED) ||
+			(iqueue->rstate == IQ_STAT_CLOSED))
 		return -EIO;
 
+	/*
+	 * more than one reader thread can wait here, each post
+	 * only wakes up one of them. the non-blocking reader also
+	 * consumes the count, otherwise a blocked reader will be
+	 * waked up for the request which has been taken. if there
+	 * is no count, the request has been handed to a blocked
+	 * reader, do not steal it.
+	 */
 	if (timeout != 0) {
 		ret = sem_pend(&iqueue->isem, timeout);
 		if (ret < 0)
 			return ret;
+	} else if ((int)sem_accept(&iqueue->isem) < 0) {
+		return -EAGAIN;
 	}
 
 	spin_lock(&iqueue->lock);
-	if (!is_list_empty(&iqueue->pending_list)) {
-		imsg = list_first_entry(&iqueue->pending_list, struct imsg, list);
-		list_del(&imsg->list);
-	} else {
-		ret = -EAGAIN;
+	for (;;) {
+		if ((iqueue->wstate == IQ_STAT_CLOSED) ||
+				(iqueue->rstate == IQ_STAT_CLOSED)) {
+			ret = -EIO;
+		} else if (is_list_empty(&iqueue->pending_list)) {
+			ret = -EAGAIN;
+		} else {
+			imsg = list_first_entry(&iqueue->pending_list,
+					struct imsg, list);
+			ret = iqueue_alloc_slot(iqueue, imsg);
+			if (ret == 0) {
+				iqueue_del_pending(iqueue, imsg);
+				iqueue_stat_recv(iqueue, imsg);
+			}
+		}
+
+		if ((ret != -EBUSY) || (timeout == 0))
+			break;
+
+		/*
+		 * all the slots are used by the requests which are not
+		 * replied yet, the blocking reader keeps the count and
+		 * waits one of them to be freed.
+		 */
+		iqueue->slot_waiters++;
+		spin_unlock(&iqueue->lock);
+
+		ret = wait_event(&iqueue->slot_event,
+				iqueue->slot_map != ~0UL, timeout);
+
+		spin_lock(&iqueue->lock);
+		iqueue->slot_waiters--;
+		if (ret)
+			break;
 	}
+
+	/*
+	 * only one waiter is waked up for each freed slot, pass it
+	 * to the next one if this reader does not use it.
+	 */
+	if (ret && iqueue->slot_waiters && (iqueue->slot_map != ~0UL))
+		wake(&iqueue->slot_event, 0);
 	spin_unlock(&iqueue->lock);
-	if (ret)
+
+	/*
+	 * the request is still pending or the writer has been closed,
+	 * give the count back, so the next reader can see it. -EAGAIN
+	 * means the request has been taken or cancelled.
+	 */
+	if (ret == -EAGAIN) {
+		return ret;
+	} else if (ret) {
+		sem_post(&iqueue->isem);
 		return ret;
+	}
 
 	/*
 	 * change the imsg's state then also check whether it
-	 * meets error.
+	 * meets error. the writer will release the slot.
 	 */
 	ret = cmpxchg(&imsg->state, IMSG_STATE_INIT, IMSG_STATE_IN_PROCESS);
 	if (ret != IMSG_STATE_INIT)
@@ -70,26 +349,76 @@ long iqueue_recv(struct iqueue *iqueue, void __user *data,
 	 * wake up this write task directly. otherwise mask this task
 	 * as current pending task and waitting for reply.
 	 */
-	ret = kobject_copy_ipc_payload(current, imsg->data,
-			actual_data, actual_extra, 1, 0);
+	ret = iqueue_copy_payload(imsg->data, actual_data,
+			extra, extra_size, actual_extra);
+
+	spin_lock(&iqueue->lock);
+	if ((ret >= 0) && (iqueue->rstate == IQ_STAT_CLOSED))
+		ret = -EIO;
+
 	if (ret < 0) {
+		iqueue_free_slot(iqueue, imsg);
 		imsg->retcode = ret;
 		smp_wmb();
+		imsg->token = 0;
 		imsg->submit = 1;
+		spin_unlock(&iqueue->lock);
 
 		wake(&imsg->ievent, 0);
 		return -EAGAIN;
 	}
 
-	spin_lock(&iqueue->lock);
-	list_add_tail(&iqueue->processing_list, &imsg->list);
 	ret = imsg->token;
 	imsg->submit = 1;
 	spin_unlock(&iqueue->lock);
 
+	iqueue_inherit_prio(iqueue, imsg->data, ret);
+
 	return ret;
 }
 
+/*
+ * the request from the kernel can not fail when all the slots
+ * are in use, wait until one of them is freed.
+ */
+int iqueue_submit(struct iqueue *iqueue, struct imsg *imsg)
+{
+	int ret;
+
+	for (;;) {
+		spin_lock(&iqueue->lock);
+		ret = iqueue_alloc_slot(iqueue, imsg);
+		if (ret == 0) {
+			imsg->state = IMSG_STATE_IN_PROCESS;
+			imsg->submit = 1;
+			spin_unlock(&iqueue->lock);
+			return 0;
+		}
+		iqueue->slot_waiters++;
+		spin_unlock(&iqueue->lock);
+
+		ret = wait_event(&iqueue->slot_event,
+				iqueue->slot_map != ~0UL, -1);
+
+		spin_lock(&iqueue->lock);
+		iqueue->slot_waiters--;
+		spin_unlock(&iqueue->lock);
+
+		if (ret)
+			return ret;
+	}
+}
+
+void iqueue_cancel(struct iqueue *iqueue, struct imsg *imsg)
+{
+	spin_lock(&iqueue->lock);
+	if (imsg->list.next != NULL)
+		iqueue_del_pending(iqueue, imsg);
+	else if (imsg->slot >= 0)
+		iqueue_free_slot(iqueue, imsg);
+	spin_unlock(&iqueue->lock);
+}
+
 long iqueue_send(struct iqueue *iqueue, void __user *data, size_t data_size,
 		void __user *extra, size_t extra_size, uint32_t timeout)
 {
@@ -107,7 +436,8 @@ long iqueue_send(struct iqueue *iqueue, void __user *data, size_t data_size,
 		return -EOTHERSIDECLOSED;
 	}
 	imsg_init(&imsg, current);
-	list_add_tail(&iqueue->pending_list, &imsg.list);
+	iqueue_add_pending(iqueue, &imsg);
+	iqueue_stat_send(iqueue, &imsg, data_size + extra_size);
 	spin_unlock(&iqueue->lock);
 
 	/*
@@ -115,8 +445,18 @@ long iqueue_send(struct iqueue *iqueue, void __user *data, size_t data_size,
 	 * to wake up the reading task.
 	 */
 	ret = poll_event_send(ps, EV_IN);
-	if (ret == -EAGAIN)
-		sem_post(&iqueue->isem);
+	if (ret == -EAGAIN) {
+		/*
+		 * for the fast path, switch to the reader directly
+		 * if it is waitting on this cpu.
+		 */
+		if (current->ipc_fast)
+			sem_post_yield(&iqueue->isem);
+		else if (iqueue->dispatch == IQUEUE_DISPATCH_LOCAL)
+			sem_post_local(&iqueue->isem);
+		else
+			sem_post(&iqueue->isem);
+	}
 
 	ret = wait_event(&imsg.ievent, imsg.token == 0, timeout);
 	if (ret == 0)
@@ -134,22 +474,26 @@ long iqueue_send(struct iqueue *iqueue, void __user *data, size_t data_size,
 out:
 	/*
 	 * the writer has been teminated or timedout, need delete
-	 * this request from the pending list or processing list.
+	 * this request from the pending list or the slot table, then
+	 * the token which the reader got will become stale.
 	 */
 	spin_lock(&iqueue->lock);
-	if (current->list.next != NULL) {
-		list_del(&imsg.list);
-		ret = 0;
+	if (imsg.list.next != NULL) {
+		iqueue_del_pending(iqueue, &imsg);
+	} else if (imsg.slot >= 0) {
+		iqueue_free_slot(iqueue, &imsg);
 	} else {
-		ret = -EAGAIN;
+		status = -EAGAIN;
 	}
 	spin_unlock(&iqueue->lock);
 
+	if (status != -EAGAIN)
+		return ret;
+
 	/*
-	 * rewait if the msg can be handled.
+	 * the request is replying, rewait the reply.
 	 */
-	if (ret)
-		ret = wait_event(&imsg.ievent, imsg.token == 0, timeout);
+	wait_event(&imsg.ievent, imsg.token == 0, timeout);
 
 	return imsg.retcode;
 }
@@ -157,7 +501,8 @@ out:
 int iqueue_reply(struct iqueue *iqueue, right_t right,
 		long token, long errno, handle_t fd, right_t fd_right)
 {
-	struct imsg *imsg, *tmp;
+	struct ipc_fast *sfast, *rfast;
+	struct imsg *imsg;
 	struct task *task;
 
 	/*
@@ -165,46 +510,87 @@ int iqueue_reply(struct iqueue *iqueue, right_t right,
 	 * up it with the error code.
 	 */
 	spin_lock(&iqueue->lock);
-	list_for_each_entry_safe(imsg, tmp, &iqueue->processing_list, list) {
-		if (imsg->token == token) {
-			list_del(&imsg->list);
-			break;
-		}
+	imsg = iqueue_token_to_imsg(iqueue, token);
+	if (imsg && imsg->submit) {
+		iqueue_stat_reply(iqueue, imsg, token);
+		iqueue_free_slot(iqueue, imsg);
+	} else {
+		imsg = NULL;
 	}
 	spin_unlock(&iqueue->lock);
 
 	if (!imsg)
 		return -ENOENT;
 
-	if (fd > 0) {
-		task = (struct task *)imsg->data;
+	task = (struct task *)imsg->data;
+	if (fd > 0)
 		errno = send_handle(current_proc, task_to_proc(task), fd, fd_right);
-	}
+
+	/*
+	 * the granted pages can not be accessed by the receiver
+	 * after the reply.
+	 */
+	if (task->ipc_grant)
+		ipc_grant_revoke(task->ipc_grant);
+
+	/*
+	 * the reply words are only passed when both side are
+	 * using fast path, then switch back to the writer.
+	 */
+	sfast = task->ipc_fast;
+	rfast = current->ipc_fast;
+	if (sfast && rfast)
+		memcpy(sfast->reply, rfast->reply, sizeof(sfast->reply));
 
 	imsg->retcode = errno;
 	smp_wmb();
 	imsg->token = 0;
 
-	wake(&imsg->ievent, 0);
+	iqueue_check_prio();
+
+	if (rfast)
+		wake_yield(&imsg->ievent, 0);
+	else
+		wake(&imsg->ievent, 0);
 
 	return 0;
 }
 
+static void wake_imsg_abort(struct imsg *imsg, int errno)
+{
+	imsg->retcode = errno;
+	smp_wmb();
+	imsg->token = 0;
+	wake_abort(&imsg->ievent);
+}
+
 static void wake_all_writer(struct iqueue *iqueue, int errno)
 {
 	struct imsg *imsg, *tmp;
+	unsigned long map;
+	int idx;
 
 	spin_lock(&iqueue->lock);
 	list_for_each_entry_safe(imsg, tmp, &iqueue->pending_list, list) {
-		list_del(&imsg->list);
-		imsg->token = 0;
-		wake_abort(&imsg->ievent);
+		iqueue_del_pending(iqueue, imsg);
+		wake_imsg_abort(imsg, errno);
 	}
 
-	list_for_each_entry_safe(imsg, tmp, &iqueue->processing_list, list) {
-		list_del(&imsg->list);
-		imsg->token = 0;
-		wake_abort(&imsg->ievent);
+	/*
+	 * the request which is still copying by the reader will
+	 * be failed by the reader itself.
+	 */
+	map = iqueue->slot_map;
+	while (map) {
+		idx = __ffs(map);
+		map &= ~(1UL << idx);
+
+		imsg = iqueue->slots[idx].imsg;
+		if (!imsg->submit)
+			continue;
+
+		iqueue_free_slot(iqueue, imsg);
+		wake_imsg_abort(imsg, errno);
 	}
 	spin_unlock(&iqueue->lock);
 }
@@ -215,27 +601,102 @@ int iqueue_close(struct iqueue *iqueue, right_t right, struct process *proc)
 		iqueue->rstate = IQ_STAT_CLOSED;
 		smp_wmb();
 		wake_all_writer(iqueue, -EIO);
+
+		/*
+		 * other reader threads of this process may still
+		 * wait for the request, same as the writer side.
+		 */
+		sem_pend_abort(&iqueue->isem, OS_EVENT_OPT_BROADCAST);
+		sem_post(&iqueue->isem);
 	} else if (right & KOBJ_RIGHT_WRITE){
 		if (!iqueue->mutil_writer) {
+			spin_lock(&iqueue->lock);
 			iqueue->wstate = IQ_STAT_CLOSED;
-			smp_wmb();
+			spin_unlock(&iqueue->lock);
+
 			/*
-			 * Fix me, need to fix race condition.
+			 * abort the readers which are pending now, and post
+			 * one count for the reader which has passed the state
+			 * check but not pended yet, each reader will give the
+			 * count back after it see the closed state.
 			 */
 			sem_pend_abort(&iqueue->isem, OS_EVENT_OPT_BROADCAST);
+			sem_post(&iqueue->isem);
 		}
 	}
 
 	return 0;
 }
 
+/*
+ * the reader is ready when there is request pending, used by the
+ * level triggered poll, called without the lock of the iqueue.
+ */
+int iqueue_poll_ready(struct iqueue *iqueue, int event)
+{
+	if (event == EV_IN)
+		return !is_list_empty(&iqueue->pending_list) ||
+			(iqueue->wstate == IQ_STAT_CLOSED);
+
+	return 0;
+}
+
+long iqueue_ctl(struct iqueue *iqueue, int req, unsigned long data)
+{
+	unsigned long flags;
+
+	switch (req) {
+	case KOBJ_IQUEUE_SET_DISPATCH:
+		if ((data != IQUEUE_DISPATCH_FIFO) &&
+				(data != IQUEUE_DISPATCH_LOCAL))
+			return -EINVAL;
+		iqueue->dispatch = data;
+		return 0;
+	case KOBJ_IQUEUE_SET_PRIO:
+		spin_lock(&iqueue->lock);
+		iqueue->prio = !!data;
+		spin_unlock(&iqueue->lock);
+
+		/*
+		 * the flags of the sem are read by the waiters with
+		 * the lock of the sem held.
+		 */
+		spin_lock_irqsave(&iqueue->isem.lock, flags);
+		if (data)
+			iqueue->isem.flags |= OS_EVENT_FLAGS_PRIO;
+		else
+			iqueue->isem.flags &= ~OS_EVENT_FLAGS_PRIO;
+		spin_unlock_irqrestore(&iqueue->isem.lock, flags);
+		return 0;
+	default:
+		break;
+	}
+
+	return -EINVAL;
+}
+
 void iqueue_init(struct iqueue *iq, int mutil_writer, struct kobject *kobj)
 {
 	ASSERT((iq != NULL) && (kobj != NULL));
 	iq->mutil_writer = !!mutil_writer;
+	iq->dispatch = IQUEUE_DISPATCH_FIFO;
+	iq->prio = 0;
 	iq->kobj = kobj;
+	iq->stat = ipc_stat_alloc(kobj->type);
 	spin_lock_init(&iq->lock);
 	init_list(&iq->pending_list);
-	init_list(&iq->processing_list);
 	sem_init(&iq->isem, 0);
+	event_init(&iq->slot_event, OS_EVENT_TYPE_NORMAL, iq);
+}
+
+void iqueue_deinit(struct iqueue *iq)
+{
+	ipc_stat_free(iq->stat);
+	iq->stat = NULL;
+}
+
+static int iqueue_subsys_init(void)
+{
+	return register_hook(iqueue_release_task, OS_HOOK_RELEASE_TASK);
 }
+subsys_initcall(iqueue_subsys_init);
@@ -18,6 +18,7 @@
 #include <minos/task.h>
 #include <uspace/poll.h>
 #include <uspace/kobject.h>
+#include <uspace/uaccess.h>
 
 static kobject_create_cb kobj_create_cbs[KOBJ_TYPE_MAX];
 
@@ -182,6 +183,10 @@ long kobject_send(struct kobject *kobj, void __user *data, size_t data_size,
 {
 	if (!kobj->ops || !kobj->ops->send)
 		return -EACCES;
+
+	uaccess_prefault(data, data_size);
+	uaccess_prefault(extra, extra_size);
+
 	/*
 	 * the poll event must called by the kobject itself
 	 */
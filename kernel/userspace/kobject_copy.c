@@ -18,6 +18,9 @@
 #include <uspace/kobject.h>
 #include <uspace/uaccess.h>
 #include <uspace/proc.h>
+#include <uspace/iqueue.h>
+
+#include "kobject_copy.h"
 
 struct kobject_rw_arg {
 	void __user *data;
@@ -40,54 +43,60 @@ static inline struct syscall_regs *task_syscall_regs(struct task *task)
 	return (struct syscall_regs *)&task->user_regs->x0;
 }
 
+/*
+ * the ipc buffer of the task is passed by the syscall registers,
+ * or set by the task itself for the vectored and async ipc.
+ */
+static void task_ipc_buf(struct task *task, struct ipc_buf *buf)
+{
+	struct syscall_regs *regs;
+
+	if (task->ipc_buf) {
+		*buf = *(struct ipc_buf *)task->ipc_buf;
+		return;
+	}
+
+	regs = task_syscall_regs(task);
+	buf->data = (void __user *)regs->a1;
+	buf->data_size = (size_t)regs->a2;
+	buf->extra = (void __user *)regs->a3;
+	buf->extra_size = (size_t)regs->a4;
+}
+
 ssize_t kobject_copy_ipc_data(struct task *tdst, struct task *tsrc, int check_size)
 {
-	struct syscall_regs *src_regs, *dst_regs;
-	void __user *dst, *src;
-	size_t dsize, ssize;
+	struct ipc_buf dbuf, sbuf;
 	size_t copy;
 
-	src_regs = task_syscall_regs(tsrc);
-	src = (void *)src_regs->a1;
-	ssize = (size_t)src_regs->a2;
-
-	dst_regs = task_syscall_regs(tdst);
-	dst = (void *)dst_regs->a1;
-	dsize = (size_t)dst_regs->a2;
+	task_ipc_buf(tsrc, &sbuf);
+	task_ipc_buf(tdst, &dbuf);
 
-	if (check_size && (dsize != ssize))
+	if (check_size && (dbuf.data_size != sbuf.data_size))
 		return -EINVAL;
 
-	copy = MIN(dsize, ssize);
+	copy = MIN(dbuf.data_size, sbuf.data_size);
 	if (copy == 0)
 		return 0;
 
-	return copy_user_to_user(tdst->vs, dst, tsrc->vs, src, copy);
+	return copy_user_to_user(tdst->vs, dbuf.data, tsrc->vs, sbuf.data, copy);
 }
 
 ssize_t kobject_copy_extra_data(struct task *tdst, struct task *tsrc, int check_size)
 {
-	struct syscall_regs *src_regs, *dst_regs;
-	void __user *dst, *src;
-	size_t dsize, ssize;
+	struct ipc_buf dbuf, sbuf;
 	size_t copy;
 
-	src_regs = task_syscall_regs(tsrc);
-	src = (void *)src_regs->a3;
-	ssize = (size_t)src_regs->a4;
+	task_ipc_buf(tsrc, &sbuf);
+	task_ipc_buf(tdst, &dbuf);
 
-	dst_regs = task_syscall_regs(tdst);
-	dst = (void *)dst_regs->a3;
-	dsize = (size_t)dst_regs->a4;
-
-	if (check_size && (dsize != ssize))
+	if (check_size && (dbuf.extra_size != sbuf.extra_size))
 		return -EINVAL;
 
-	copy = MIN(dsize, ssize);
+	copy = MIN(dbuf.extra_size, sbuf.extra_size);
 	if (copy == 0)
 		return 0;
 
-	return copy_user_to_user(tdst->vs, dst, tsrc->vs, src, copy);
+	return copy_user_to_user(tdst->vs, dbuf.extra, tsrc->vs, sbuf.extra, copy);
 }
 
 ssize_t kobject_copy_ipc_payload(struct task *dtsk, struct task *ttsk,
@@ -109,3 +118,45 @@ ssize_t kobject_copy_ipc_payload(struct task *dtsk, struct task *ttsk,
 
 	return ret;
 }
+
+/*
+ * copy the message when one side of the ipc is using the fast
+ * path, the slow side's buffer is accessed by user copy, and the
+ * message of the slow sender can not be larger than the registers.
+ */
+ssize_t kobject_copy_ipc_fast(struct task *tdst, struct task *tsrc,
+		size_t *actual_data, size_t *actual_extra)
+{
+	struct ipc_fast *dfast = tdst->ipc_fast;
+	struct ipc_fast *sfast = tsrc->ipc_fast;
+	struct ipc_buf buf;
+	size_t size;
+	int ret;
+
+	*actual_extra = 0;
+
+	if (dfast && sfast) {
+		memcpy(dfast->msg, sfast->msg, sizeof(dfast->msg));
+		*actual_data = sizeof(dfast->msg);
+		return 0;
+	}
+
+	if (sfast) {
+		task_ipc_buf(tdst, &buf);
+		size = MIN(buf.data_size, sizeof(sfast->msg));
+		ret = __copy_to_user(tdst->vs, buf.data, sfast->msg, size);
+	} else {
+		task_ipc_buf(tsrc, &buf);
+		size = buf.data_size;
+		if ((size > sizeof(dfast->msg)) || (buf.extra_size != 0))
+			return -E2BIG;
+
+		ret = __copy_from_user(dfast->msg, tsrc->vs, buf.data, size);
+	}
+
+	if (ret < 0)
+		return ret;
+	*actual_data = size;
+
+	return 0;
+}
@@ -1,6 +1,17 @@
 #ifndef __MINOS_KOBJECT_COPY_H__
 #define __MINOS_KOBJECT_COPY_H__
 
+/*
+ * the ipc buffer which is not passed by the syscall registers,
+ * used by the vectored and async ipc.
+ */
+struct ipc_buf {
+	void __user *data;
+	size_t data_size;
+	void __user *extra;
+	size_t extra_size;
+};
+
 ssize_t kobject_copy_ipc_data(struct task *tdst,
 		struct task *tsrc, int check_size);
 
@@ -11,4 +22,7 @@ ssize_t kobject_copy_ipc_payload(struct task *dtsk, struct task *ttsk,
 		size_t *actual_data, size_t *actual_extra,
 		int check_data, int check_extra);
 
+ssize_t kobject_copy_ipc_fast(struct task *tdst, struct task *tsrc,
+		size_t *actual_data, size_t *actual_extra);
+
 #endif
@@ -25,6 +25,8 @@
 #define PMA_RIGHT	(KOBJ_RIGHT_CTL | KOBJ_RIGHT_MMAP | KOBJ_RIGHT_RWX)
 #define PMA_RIGHT_MASK	(KOBJ_RIGHT_CTL | KOBJ_RIGHT_MMAP | KOBJ_RIGHT_RWX)
 
+#define PMA_EXTENT_MAX_PAGES	(HUGE_PAGE_SIZE >> PAGE_SHIFT)
+
 struct pma_mapping_entry {
 	unsigned long virt;
 	size_t size;
@@ -62,6 +64,12 @@ struct pma {
 	unsigned long pstart;
 	unsigned long pend;
 	unsigned long psize;
+
+	/*
+	 * the memory of a non consequent PMA is a list of extents,
+	 * each extent is a page head which page_count() pages are
+	 * physically contiguous.
+	 */
 	struct page *page_list;
 };
 
@@ -77,6 +85,50 @@ static void free_pma_pages(struct page *head)
 	}
 }
 
+/*
+ * allocate the pages as extents, try 2M block first which
+ * can be mapped with a block entry, then fallback to the
+ * largest chunk the page allocator can give. each chunk
+ * starts from 2M again, the smaller size is only for the
+ * chunk which the allocator can not give a larger one.
+ */
+static struct page *alloc_pma_extents(size_t cnt)
+{
+	int pages = PMA_EXTENT_MAX_PAGES;
+	struct page *head = NULL;
+	struct page *tail = NULL;
+	struct page *page;
+
+	while (cnt > 0) {
+		while (pages > cnt)
+			pages >>= 1;
+
+		page = __alloc_pages(pages, (pages == PMA_EXTENT_MAX_PAGES) ?
+				pages : 1, GFP_USER | __GFP_NOWARN);
+		if (!page) {
+			if (pages == 1) {
+				free_pma_pages(head);
+				return NULL;
+			}
+
+			pages >>= 1;
+			continue;
+		}
+
+		memset((void *)page_va(page), 0, pages << PAGE_SHIFT);
+		page->next = NULL;
+		if (tail)
+			tail->next = page;
+		else
+			head = page;
+		tail = page;
+		cnt -= pages;
+		pages = PMA_EXTENT_MAX_PAGES;
+	}
+
+	return head;
+}
+
 static void free_pma_memory(struct pma *p)
 {
 	BUG_ON((p->pstart != 0) && (p->page_list != NULL));
@@ -158,11 +210,53 @@ static int pma_close(struct kobject *kobj, right_t right,
 		return unmap_process_memory(proc, pa2sva(p->pstart), p->psize);
 }
 
+/*
+ * the same PMA may be mapped into many processes with different
+ * permission, for example the shared text of an elf image is
+ * filled by nvwa with RW and mapped as RX into each process. so
+ * drop the write and exec bits which are not requested.
+ */
+static inline unsigned long pma_map_flags(struct pma *p, right_t right)
+{
+	unsigned long flags = p->vmflags;
+
+	if (!(right & KOBJ_RIGHT_WRITE))
+		flags &= ~__VM_WRITE;
+	if (!(right & KOBJ_RIGHT_EXEC))
+		flags &= ~__VM_EXEC;
+
+	return flags;
+}
+
+/*
+ * the 2M aligned part of each extent will be mapped with
+ * block entry if the virtual address is also aligned.
+ */
+static int map_pma_extents(struct pma *p, struct process *proc,
+		unsigned long virt, size_t size, unsigned long flags)
+{
+	struct page *page;
+	size_t msize;
+	int ret = 0;
+
+	for (page = p->page_list; page && (size > 0); page = page->next) {
+		msize = MIN(size, (size_t)page_count(page) << PAGE_SHIFT);
+		ret = map_process_memory(proc, virt, msize,
+				page_pa(page), flags | VM_HUGE);
+		if (ret)
+			break;
+
+		virt += msize;
+		size -= msize;
+	}
+
+	return ret;
+}
+
 static void *__sys_pma_map(struct pma *p, struct process *proc,
-		unsigned long virt, size_t size)
+		unsigned long virt, size_t size, right_t right)
 {
-	struct page *page = p->page_list;
-	unsigned long start = virt;
+	unsigned long flags = pma_map_flags(p, right);
 	struct pma_mapping_entry *pme;
 	int ret;
 
@@ -175,24 +269,14 @@ static void *__sys_pma_map(struct pma *p, struct process *proc,
 	pme->mapper = current_proc;
 	pme->proc = proc;
 
-	if (p->pstart) {
-		ret = map_process_memory(proc, start,
-				size, p->pstart, p->vmflags);
-	} else {
-		do {
-			ret = map_process_memory(proc, start,
-					PAGE_SIZE,page_pa(page), p->vmflags);
-			if (ret)
-				break;
-			page = page->next;
-			start += PAGE_SIZE;
-			size -= PAGE_SIZE;
-		} while (size > 0);
-	}
+	if (p->pstart)
+		ret = map_process_memory(proc, virt, size, p->pstart, flags);
+	else
+		ret = map_pma_extents(p, proc, virt, size, flags);
 
 	if (ret) {
+		unmap_process_memory(proc, virt, pme->size);
 		free(pme);
-		unmap_process_memory(proc, virt, size);
 		return ERROR_PTR(ret);
 	}
 
@@ -278,8 +362,18 @@ static int sys_handle_pma(handle_t proc_handle, handle_t pma_handle,
 	}
 
 	if (map) {
+		/*
+		 * can not map the pma with more access right than
+		 * the handle has.
+		 */
+		if ((right & right_pma & KOBJ_RIGHT_RWX) !=
+				(right & KOBJ_RIGHT_RWX)) {
+			ret = -EACCES;
+			goto out;
+		}
+
 		addr = __sys_pma_map((struct pma *)kobj_pma->data, proc,
-				virt, size);
+				virt, size, right);
 		if (IS_ERROR_PTR(addr))
 			ret = (int)(unsigned long)addr;
 	} else {
@@ -324,10 +418,7 @@ static void pma_release(struct kobject *kobj)
 static int pma_add_pages(struct kobject *kobj, int pages)
 {
 	struct pma *p = (struct pma *)kobj->data;
-	struct page *page;
-	struct page *head = NULL;
-	struct page *tail = NULL;
-	int i;
+	struct page *head, *tail;
 
 	if ((pages <= 0) || (p->type != PMA_TYPE_NORMAL))
 		return -EINVAL;
@@ -335,27 +426,23 @@ static int pma_add_pages(struct kobject *kobj, int pages)
 	if (p->consequent)
 		return -EPERM;
 
-	for (i = 0; i < pages; i++) {
-		page = alloc_pages(1, GFP_USER);
-		if (!page) {
-			free_pma_pages(head);
-			return -ENOMEM;
-		}
-
-		page->next = head;
-		head = page;
-
-		if (tail == NULL)
-			tail = page;
-	}
+	head = alloc_pma_extents(pages);
+	if (!head)
+		return -ENOMEM;
 
 	/*
-	 * insert the new pages to the pma
+	 * append the new extents to the pma, so the offset of
+	 * the memory already in the pma will not change.
 	 */
 	spin_lock(&p->lock);
-	tail->next = p->page_list;
-	p->page_list = head;
-	p->psize += pages << PAGE_SHIFT;
+	if (p->page_list) {
+		for (tail = p->page_list; tail->next; tail = tail->next)
+			;
+		tail->next = head;
+	} else {
+		p->page_list = head;
+	}
+	p->psize += (unsigned long)pages << PAGE_SHIFT;
 	spin_unlock(&p->lock);
 
 	return 0;
@@ -368,6 +455,23 @@ static long pma_get_size(struct kobject *kobj)
 	return p->psize;
 }
 
+/*
+ * the driver can get the physical address of a consequent pma
+ * once, then calculate the dma address of its buffer directly.
+ */
+static long pma_get_paddr(struct kobject *kobj)
+{
+	struct pma *p = (struct pma *)kobj->data;
+
+	if (!proc_can_vmctl(current_proc))
+		return -EPERM;
+
+	if (!p->pstart || (p->type == PMA_TYPE_KCACHE))
+		return -EINVAL;
+
+	return p->pstart;
+}
+
 static long pma_ctl(struct kobject *kobj, int req, unsigned long data)
 {
 	int ret;
@@ -378,6 +482,8 @@ static long pma_ctl(struct kobject *kobj, int req, unsigned long data)
 		break;
 	case KOBJ_PMA_GET_SIZE:
 		return pma_get_size(kobj);
+	case KOBJ_PMA_GET_PADDR:
+		return pma_get_paddr(kobj);
 	default:
 		ret = -ENOSYS;
 		pr_err("unknow action 0x%x for pma kobject\n", req);
@@ -454,8 +560,6 @@ static inline unsigned long pma_flags(int type, right_t right)
 static int allocate_pma_memory(struct pma *p, size_t size, int type)
 {
 	size_t cnt = size >> PAGE_SHIFT;
-	struct page *page;
-	int i;
 
 	/*
 	 * if this PMA need to shared among in different process
@@ -471,16 +575,12 @@ static int allocate_pma_memory(struct pma *p, size_t size, int type)
 		return 0;
 	}
 
-	for (i = 0; i < cnt; i++) {
-		page = alloc_pages(1, GFP_USER);
-		if (!page) {
-			free_pma_memory(p);
-			return -ENOMEM;
-		}
+	if (cnt == 0)
+		return 0;
 
-		page->next = p->page_list;
-		p->page_list = page;
-	}
+	p->page_list = alloc_pma_extents(cnt);
+	if (!p->page_list)
+		return -ENOMEM;
 
 	return 0;
 }
@@ -20,6 +20,7 @@
 #include <minos/sched.h>
 #include <minos/mm.h>
 #include <minos/event.h>
+#include <minos/time.h>
 #include <minos/task.h>
 #include <uspace/vspace.h>
 #include <uspace/uaccess.h>
@@ -34,6 +35,8 @@
 #define to_poll_hub(kobj)	\
 	(struct poll_hub *)kobj->data
 
+#define POLL_READ_BATCH		8
+
 struct poll_event *alloc_poll_event(void)
 {
 	struct poll_event_kernel *p;
@@ -93,73 +96,241 @@ int poll_event_send_with_data(struct poll_struct *ps, int ev, int type,
 	return ret;
 }
 
+/*
+ * the event without data only need to be reported once until the
+ * poller read it, queue the event embedded in the pevent_item if
+ * it is not in the poll_hub yet, no memory is allocated here.
+ */
+static int poll_event_send_coalesced(struct pevent_item *pi)
+{
+	struct poll_hub *peh = pi->poller;
+	unsigned long flags;
+	int queued;
+
+	spin_lock_irqsave(&peh->lock, flags);
+	pi->pending++;
+	queued = pi->queued;
+	if (!queued) {
+		pi->queued = 1;
+		list_add_tail(&peh->event_list, &pi->pek.list);
+	}
+	spin_unlock_irqrestore(&peh->lock, flags);
+
+	return queued ? 0 : wake(&peh->event, 0);
+}
+
 int poll_event_send(struct poll_struct *ps, int ev)
 {
-	return poll_event_send_with_data(ps, ev, 0, 0, 0, 0);
+	struct pevent_item *pi;
+	int ret = 0;
+
+	if (!ps)
+		return -EAGAIN;
+
+	smp_rmb();
+	pi = ps->pevents[ev];
+	if (!pi)
+		return -EAGAIN;
+
+	while (pi) {
+		ret += poll_event_send_coalesced(pi);
+		pi = pi->next;
+	}
+
+	return ret;
 }
 
-static int copy_poll_event_to_user(struct poll_event __user *events,
-		struct list_head *head, int cnt)
+/*
+ * the level triggering needs the kobject to tell whether it
+ * is still ready, use the edge triggering if it can not.
+ */
+static int pevent_mode(struct kobject *kobj, uint32_t events)
 {
-	struct poll_event_kernel *pevent, *tmp;
-	int ret, num = 0;
+	if ((events & POLLLT) && kobj->ops && kobj->ops->poll_ready)
+		return PEVENT_MODE_LEVEL;
+	else if (events & (POLLLT | POLLET))
+		return PEVENT_MODE_EDGE;
+	else
+		return PEVENT_MODE_COUNT;
+}
 
-	list_for_each_entry_safe(pevent, tmp, head, list) {
+/*
+ * fetch the events from the poll_hub with the lock held. the
+ * level triggered event is reported only if it is still ready,
+ * and is queued again after this read. the edge triggered one is
+ * reported once for all the sends before this read. the counted
+ * one is reported once for each send, it is queued again if there
+ * are more sends not reported.
+ */
+static int poll_hub_fetch(struct poll_hub *peh, struct poll_event *kevents,
+		int max, struct list_head *relist, struct list_head *free_list)
+{
+	struct poll_event_kernel *pevent;
+	struct pevent_item *pi;
+	int cnt = 0;
+
+	while ((cnt < max) && !is_list_empty(&peh->event_list)) {
+		pevent = list_first_entry(&peh->event_list,
+				struct poll_event_kernel, list);
 		list_del(&pevent->list);
-		ret = copy_to_user(&events[num++], &pevent->event,
-				sizeof(struct poll_event));
-		/*
-		 * free the epoll event's memory
-		 */
-		if (pevent->release)
+
+		pi = pevent->pi;
+		if (!pi) {
+			kevents[cnt++] = pevent->event;
+			if (pevent->release)
+				list_add_tail(free_list, &pevent->list);
+			continue;
+		}
+
+		switch (pi->mode) {
+		case PEVENT_MODE_LEVEL:
+			if (!pi->kobj->ops->poll_ready(pi->kobj, pi->ev)) {
+				pi->queued = 0;
+				continue;
+			}
+			pi->pending = 0;
+			list_add_tail(relist, &pevent->list);
+			break;
+		case PEVENT_MODE_EDGE:
+			pi->pending = 0;
+			pi->queued = 0;
+			break;
+		default:
+			if (--pi->pending > 0) {
+				list_add_tail(relist, &pevent->list);
+			} else {
+				pi->pending = 0;
+				pi->queued = 0;
+			}
+			break;
+		}
+
+		memset(&kevents[cnt], 0, sizeof(struct poll_event));
+		kevents[cnt].events = (1 << pi->ev);
+		kevents[cnt].data.pdata = pi->data;
+		cnt++;
+	}
+
+	return cnt;
+}
+
+static int poll_hub_fetch_events(struct poll_hub *peh,
+		struct poll_event __user *events, int max_event)
+{
+	struct poll_event kevents[POLL_READ_BATCH];
+	struct poll_event_kernel *pevent, *tmp;
+	unsigned long flags;
+	LIST_HEAD(relist);
+	LIST_HEAD(free_list);
+	int cnt = 0, nr, ret;
+
+	/*
+	 * the events are copied out of the poll_hub with the lock
+	 * held, since the pevent_item may be deleted after unlock.
+	 */
+	while (cnt < max_event) {
+		spin_lock_irqsave(&peh->lock, flags);
+		nr = poll_hub_fetch(peh, kevents, MIN(max_event - cnt,
+				POLL_READ_BATCH), &relist, &free_list);
+		spin_unlock_irqrestore(&peh->lock, flags);
+
+		list_for_each_entry_safe(pevent, tmp, &free_list, list) {
+			list_del(&pevent->list);
 			free(pevent);
+		}
+
+		if (nr == 0)
+			break;
+
+		ret = copy_to_user(&events[cnt], kevents,
+				nr * sizeof(struct poll_event));
 		ASSERT(ret > 0);
+		cnt += nr;
+	}
+
+	/*
+	 * the level triggered events which are still ready and the
+	 * counted events which have more sends, they will be reported
+	 * again in the next read.
+	 */
+	if (!is_list_empty(&relist)) {
+		spin_lock_irqsave(&peh->lock, flags);
+		list_for_each_entry_safe(pevent, tmp, &relist, list) {
+			list_del(&pevent->list);
+			list_add_tail(&peh->event_list, &pevent->list);
+		}
+		spin_unlock_irqrestore(&peh->lock, flags);
 	}
 
 	return cnt;
 }
 
+static inline int poll_hub_ready(struct poll_hub *peh)
+{
+	return !is_list_empty(&peh->event_list) || peh->closed;
+}
+
+/*
+ * convert the deadline to the timeout in ms for wait_event,
+ * round up so the waiter does not wake up too early.
+ */
+static uint32_t poll_hub_timeout(unsigned long deadline)
+{
+	unsigned long now = get_current_time();
+	unsigned long ms;
+
+	if (now >= deadline)
+		return 0;
+
+	ms = (deadline - now + MILLISECS(1) - 1) / MILLISECS(1);
+
+	return ms >= (uint32_t)-1 ? (uint32_t)-2 : (uint32_t)ms;
+}
+
+/*
+ * timeout is in ns, less than 0 means wait forever, abs means
+ * the timeout is the deadline of the monotonic clock. the level
+ * triggered events may be not ready when fetching them, wait
+ * again until the deadline if nothing is fetched.
+ */
 static int __poll_hub_read(struct poll_hub *peh,
 		struct poll_event __user *events,
-		int max_event, uint32_t timeout)
+		int max_event, long timeout, int abs)
 {
-	struct poll_event_kernel *pevent, *tmp;
-	unsigned long flags;
-	LIST_HEAD(event_list);
-	int cnt = 0;
-	long ret = 0;
+	unsigned long deadline = 0;
+	uint32_t to = -1;
+	long ret;
+	int cnt;
 
-	if (max_event >= 32)
-		return -E2BIG;
+	if (max_event <= 0)
+		return -EINVAL;
 
-	if (!user_ranges_ok((void *)events, max_event * sizeof(struct poll_event)))
+	if (!user_ranges_ok((void *)events, (size_t)max_event * sizeof(struct poll_event)))
 		return -EFAULT;
 
-	ret = wait_event(&peh->event, !is_list_empty(&peh->event_list), -1);
-	if (ret)
-		return ret;
+	if (timeout >= 0)
+		deadline = abs ? timeout : get_current_time() + timeout;
 
-	spin_lock_irqsave(&peh->lock, flags);
-	if (is_list_empty(&peh->event_list)) {
-		ret = -EAGAIN;
-		goto out;
-	}
+	for (;;) {
+		if (timeout >= 0)
+			to = poll_hub_timeout(deadline);
 
-	list_for_each_entry_safe(pevent, tmp, &peh->event_list, list) {
-		list_del(&pevent->list);
-		list_add_tail(&event_list, &pevent->list);
-		if (++cnt == max_event)
-			break;
-	}
-out:
-	spin_unlock_irqrestore(&peh->lock, flags);
-	if (ret)
-		return ret;
+		set_bit(TIF_WAIT_ABORTABLE, &current->ti.flags);
+		ret = wait_event(&peh->event, poll_hub_ready(peh), to);
+		clear_bit(TIF_WAIT_ABORTABLE, &current->ti.flags);
 
-	if (!is_list_empty(&event_list))
-		ret = copy_poll_event_to_user(events, &event_list, cnt);
+		if (ret == -EBUSY)
+			return (timeout == 0) ? -EAGAIN : -ETIMEDOUT;
+		else if (ret)
+			return ret;
 
-	return ret;
+		if (peh->closed)
+			return -EBADF;
+
+		cnt = poll_hub_fetch_events(peh, events, max_event);
+		if (cnt > 0)
+			return cnt;
+	}
 }
 
 static long poll_hub_read(struct kobject *kobj, void __user *data, size_t data_size,
@@ -167,10 +338,11 @@ static long poll_hub_read(struct kobject *kobj, void __user *data, size_t data_s
 		size_t *actual_extra, uint32_t timeout)
 {
 	struct poll_hub *peh = to_poll_hub(kobj);
+	long to = (timeout == (uint32_t)-1) ? -1 : MILLISECS(timeout);
 	int cnt;
 
 	cnt = __poll_hub_read(peh, data,
-			data_size / sizeof(struct poll_event), timeout);
+			data_size / sizeof(struct poll_event), to, 0);
 	if (cnt <= 0)
 		return cnt;
 
@@ -179,6 +351,20 @@ static long poll_hub_read(struct kobject *kobj, void __user *data, size_t data_s
 	return 0;
 }
 
+static long poll_hub_wait(struct poll_hub *peh, unsigned long data)
+{
+	struct poll_wait_arg arg;
+	int ret;
+
+	ret = copy_from_user(&arg, (void __user *)data,
+			sizeof(struct poll_wait_arg));
+	if (ret <= 0)
+		return ret;
+
+	return __poll_hub_read(peh, (struct poll_event __user *)arg.events,
+			arg.max_event, arg.timeout, arg.flags & POLL_WAIT_ABSTIME);
+}
+
 static void poll_hub_release(struct kobject *kobj)
 {
 	struct poll_hub *peh = to_poll_hub(kobj);
@@ -200,6 +386,20 @@ static void poll_hub_release(struct kobject *kobj)
 
 static int poll_hub_close(struct kobject *kobj, right_t right, struct process *proc)
 {
+	struct poll_hub *peh = to_poll_hub(kobj);
+	unsigned long flags;
+
+	/*
+	 * wake up the threads which are waitting on this poll_hub,
+	 * they will see the closed state.
+	 */
+	peh->closed = 1;
+	smp_wmb();
+
+	spin_lock_irqsave(&peh->event.lock, flags);
+	wake_up_event_waiter(&peh->event, 0, TASK_STATE_PEND_OK, WAKEUP_ALL);
+	spin_unlock_irqrestore(&peh->event.lock, flags);
+
 	return 0;
 }
 
@@ -249,6 +449,24 @@ static struct pevent_item * find_and_del_pevent_item(struct poll_struct *ps,
 	return NULL;
 }
 
+/*
+ * remove the coalesced event of the pevent_item from the poll_hub
+ * before the pevent_item is freed.
+ */
+static void pevent_item_unqueue(struct pevent_item *pi)
+{
+	struct poll_hub *peh = pi->poller;
+	unsigned long flags;
+
+	spin_lock_irqsave(&peh->lock, flags);
+	if (pi->queued) {
+		list_del(&pi->pek.list);
+		pi->queued = 0;
+		pi->pending = 0;
+	}
+	spin_unlock_irqrestore(&peh->lock, flags);
+}
+
 void release_poll_struct(struct kobject *kobj)
 {
 	struct poll_struct *ps = kobj->poll_struct;
@@ -264,6 +482,7 @@ void release_poll_struct(struct kobject *kobj)
 		while (pi) {
 			tmp = pi->next;
 			ph = pi->poller;
+			pevent_item_unqueue(pi);
 			free(pi);
 			kobject_put(&ph->kobj);
 			pi = tmp;
@@ -309,7 +528,7 @@ static int __poll_hub_ctl(struct poll_hub *ph, struct kobject *ksrc,
 				if (ret)
 					break;
 
-				ei = malloc(sizeof(struct pevent_item));
+				ei = zalloc(sizeof(struct pevent_item));
 				if (!ei) {
 					pr_err("failed to allocate new pevent item\n");
 					ret = -ENOMEM;
@@ -317,15 +536,21 @@ static int __poll_hub_ctl(struct poll_hub *ph, struct kobject *ksrc,
 				}
 
 				ei->poller = ph;
+				ei->kobj = ksrc;
+				ei->ev = i;
+				ei->mode = pevent_mode(ksrc, uevent->events);
 				ei->data = uevent->data.pdata;
+				ei->pek.pi = ei;
 				add_new_pevent(ps, i, ei);
 				kobject_get(&ph->kobj);
 			}
 			break;
 		case KOBJ_POLL_OP_MOD:
 			ei = find_pevent_item(ps, i, ph);
-			if (ei)
+			if (ei) {
 				ei->data = uevent->data.pdata;
+				ei->mode = pevent_mode(ksrc, uevent->events);
+			}
 			else
 				pr_err("epoll_mod %d is not enabled\n", ev);
 			break;
@@ -333,6 +558,7 @@ static int __poll_hub_ctl(struct poll_hub *ph, struct kobject *ksrc,
 			ei = find_and_del_pevent_item(ps, i, ph);
 			if (ei) {
 				kobject_poll(&ph->kobj, ksrc, ev, 0);
+				pevent_item_unqueue(ei);
 				kobject_put(&ph->kobj);
 				free(ei);
 			} else {
@@ -374,6 +600,9 @@ static long poll_hub_ctl(struct kobject *kobj, int op, unsigned long data)
 	right_t right;
 	int ret;
 
+	if (op == KOBJ_POLL_OP_WAIT)
+		return poll_hub_wait(ph, data);
+
 	ret = copy_from_user(&uevent, (void __user *)data,
 			sizeof(struct poll_event));
 	if (ret <= 0)
@@ -24,7 +24,7 @@
 
 #include "kobject_copy.h"
 
-#define PORT_RIGHT 	KOBJ_RIGHT_RW
+#define PORT_RIGHT 	(KOBJ_RIGHT_RW | KOBJ_RIGHT_CTL)
 #define PORT_RIGHT_MASK KOBJ_RIGHT_WRITE
 
 struct port {
@@ -65,7 +65,10 @@ static int port_reply(struct kobject *kobj, right_t right,
 
 static void port_release(struct kobject *kobj)
 {
-	free(kobject_to_port(kobj));
+	struct port *port = kobject_to_port(kobj);
+
+	iqueue_deinit(&port->iqueue);
+	free(port);
 }
 
 static int port_poll(struct kobject *ksrc,
@@ -74,6 +77,18 @@ static int port_poll(struct kobject *ksrc,
 	return ((event == EV_WOPEN) || event == EV_WCLOSE ? -EINVAL : 0);
 }
 
+static long port_ctl(struct kobject *kobj, int req, unsigned long data)
+{
+	struct port *port = kobject_to_port(kobj);
+	return iqueue_ctl(&port->iqueue, req, data);
+}
+
+static int port_poll_ready(struct kobject *kobj, int event)
+{
+	struct port *port = kobject_to_port(kobj);
+	return iqueue_poll_ready(&port->iqueue, event);
+}
+
 static struct kobject_ops port_kobject_ops = {
 	.send		= port_send,
 	.recv		= port_recv,
@@ -81,6 +96,8 @@ static struct kobject_ops port_kobject_ops = {
 	.close		= port_close,
 	.reply		= port_reply,
 	.poll		= port_poll,
+	.poll_ready	= port_poll_ready,
+	.ctl		= port_ctl,
 };
 
 static int port_create(struct kobject **kobj, right_t *right, unsigned long data)
@@ -91,8 +108,8 @@ static int port_create(struct kobject **kobj, right_t *right, unsigned long data
 	if (!port)
 		return -ENOMEM;
 
-	iqueue_init(&port->iqueue, 1, &port->kobj);
 	kobject_init(&port->kobj, KOBJ_TYPE_PORT, PORT_RIGHT_MASK, (unsigned long)port);
+	iqueue_init(&port->iqueue, 1, &port->kobj);
 	port->kobj.ops = &port_kobject_ops;
 	*kobj = &port->kobj;
 	*right = PORT_RIGHT;
@@ -54,6 +54,10 @@ struct process *create_process(int pid, task_func_t func,
 	if (ret)
 		goto vspace_init_fail;
 
+	ret = map_vdso_time(proc);
+	if (ret)
+		goto task_create_fail;
+
 	/*
 	 * create a root task for this process
 	 */
@@ -119,10 +123,13 @@ static void request_process_stop(struct process *proc, int handle)
 		 *
 		 * if the task is waitting for the root service, do not
 		 * wakeup it, since the root service will finnally wake
-		 * up this task.
+		 * up this task. the task in an abortable wait such as
+		 * poll is aborted.
 		 */
 		if (tmp->ti.flags & __TIF_IN_USER)
 			smp_function_call(tmp->cpu, task_exit_helper, NULL, 0);
+		else if (tmp->ti.flags & __TIF_WAIT_ABORTABLE)
+			wake_up_abort(tmp);
 	}
 	spin_unlock(&proc->lock);
 
@@ -168,9 +175,9 @@ int process_page_fault(struct process *proc, uint64_t virtaddr, uint64_t info)
 	int ret;
 
 	imsg_init(&imsg, current);
-	spin_lock(&iqueue->lock);
-	list_add_tail(&iqueue->processing_list, &imsg.list);
-	spin_unlock(&iqueue->lock);
+	ret = iqueue_submit(iqueue, &imsg);
+	if (ret)
+		return ret;
 
 	/*
 	 * send the page fault event to the root service. need
@@ -188,6 +195,8 @@ int process_page_fault(struct process *proc, uint64_t virtaddr, uint64_t info)
 	if (ret == 0)
 		return imsg.retcode;
 
+	iqueue_cancel(iqueue, &imsg);
+
 	return ret;
 }
 
@@ -243,6 +252,8 @@ static long do_process_ctl(struct process *proc, int req, unsigned long data)
 		data &= PROC_FLAGS_MASK;
 		proc->flags |= data;
 		return 0;
+	case KOBJ_PROCESS_SET_MAX_HANDLE:
+		return set_process_handle_limit(proc, (uint32_t)data);
 	default:
 		break;
 	}
@@ -280,6 +291,7 @@ int do_process_release(struct kobject *kobj)
 	 */
 	vspace_deinit(proc);
 	process_handles_deinit(proc);
+	iqueue_deinit(&proc->iqueue);
 	free(proc);
 
 	return 0;
@@ -385,9 +397,9 @@ struct process *create_root_process(task_func_t func, void *usp,
 
 	ts = get_task_stat(proc->root_task->tid);
 	strcpy(ts->cmd, "pangu.srv");
-	iqueue_init(&proc->iqueue, 0, &proc->kobj);
 	kobject_init(&proc->kobj, KOBJ_TYPE_PROCESS,
 			PROC_RIGHT_MASK, (unsigned long)proc);
+	iqueue_init(&proc->iqueue, 0, &proc->kobj);
 	proc->flags |= PROC_FLAGS_ROOT | PROC_FLAGS_VMCTL | PROC_FLAGS_HWCTL;
 	proc->kobj.ops = &proc_kobj_ops;
 
@@ -417,9 +429,9 @@ static int process_create(struct kobject **kobjr, right_t *right, unsigned long
 	if (!proc)
 		return -ENOMEM;
 
-	iqueue_init(&proc->iqueue, 0, &proc->kobj);
 	kobject_init(&proc->kobj, KOBJ_TYPE_PROCESS,
 			PROC_RIGHT_MASK, (unsigned long)proc);
+	iqueue_init(&proc->iqueue, 0, &proc->kobj);
 	proc->kobj.ops = &proc_kobj_ops;
 	*kobjr = &proc->kobj;
 	*right = PROC_RIGHT;
@@ -22,6 +22,8 @@
 #include <minos/task.h>
 #include <uspace/kobject.h>
 #include <uspace/proc.h>
+#include <uspace/ipcstat.h>
+#include <uspace/sysstat.h>
 #include <uapi/procinfo_uapi.h>
 
 struct kobject *task_stat_pma;
@@ -125,5 +127,11 @@ int procinfo_init(void)
 	 */
 	os_for_all_task(init_kernel_task_stat);
 
+	if (ipc_stat_init())
+		pr_warn("ipc stat memory init failed\n");
+
+	if (syscall_stat_init())
+		pr_warn("syscall stat memory init failed\n");
+
 	return 0;
 }
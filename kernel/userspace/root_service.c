@@ -29,6 +29,8 @@
 #include <uspace/handle.h>
 #include <uspace/elf.h>
 #include <uspace/proc.h>
+#include <uspace/ipcstat.h>
+#include <uspace/sysstat.h>
 
 extern struct kobject *task_stat_pma;
 extern struct process *create_root_process( task_func_t func,
@@ -342,6 +344,18 @@ static int setup_root_service_env(struct process *proc)
 			KOBJ_RIGHT_READ | KOBJ_RIGHT_MMAP);
 	ASSERT(env->task_stat_handle > 0);
 
+	if (ipc_stat_kobject()) {
+		env->ipc_stat_handle = __alloc_handle(proc, ipc_stat_kobject(),
+				KOBJ_RIGHT_RW | KOBJ_RIGHT_MMAP);
+		ASSERT(env->ipc_stat_handle > 0);
+	}
+
+	if (syscall_stat_kobject()) {
+		env->sys_stat_handle = __alloc_handle(proc, syscall_stat_kobject(),
+				KOBJ_RIGHT_RW | KOBJ_RIGHT_MMAP);
+		ASSERT(env->sys_stat_handle > 0);
+	}
+
 	/*
 	 * map env page to a fix memory address
 	 */
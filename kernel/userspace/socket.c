@@ -17,169 +17,407 @@
 #include <minos/minos.h>
 #include <minos/mm.h>
 #include <minos/sched.h>
+#include <minos/event.h>
 #include <uspace/poll.h>
 #include <uspace/kobject.h>
 #include <uspace/uaccess.h>
+#include <uspace/vspace.h>
+#include <uspace/proc.h>
+
+/*
+ * socket is a single producer single consumer byte stream. the
+ * ring is mapped to both peers, they can read and write the ring
+ * directly, the kernel is only needed when one side need to wait
+ * or notify the other side. send and recv can also copy the data
+ * for the peer which does not map the ring.
+ */
+#define SK_RIGHT_MASK	(KOBJ_RIGHT_MMAP | KOBJ_RIGHT_CTL)
+#define SK_RIGHT	(KOBJ_RIGHT_RW | KOBJ_RIGHT_MMAP | KOBJ_RIGHT_CTL)
+
+#define SK_STAT_CLOSED 1
+#define SK_STAT_OPENED 0
+
+#define SOCKET_MAX_SIZE	(HUGE_PAGE_SIZE / 2)
 
 struct socket {
 	void *shmem;
 	size_t shmem_size;
 
-	uint64_t widx;
-	uint64_t ridx;
+	struct socket_ring *ring;
+	void *data;
+	size_t size;
+
+	int rstate;
+	int wstate;
+
+	int rmapped;				// reader side has mapped the ring.
+	int wmapped;				// writer side has mapped the ring.
 
 	spinlock_t rlock;
 	spinlock_t wlock;
 
+	struct event revent;			// reader waitting for data.
+	struct event wevent;			// writer waitting for space.
+
 	struct kobject kobj;
 };
 
-#define SOCKET_FULL(head, tail) ((head) == (tail) + 1)
-#define SOCKET_EMPTY(head, tail) ((head) == (tail))
-#define SOCKET_IDX(sk, idx)	\
-	((idx) & (sk->shmem_size - 1))
+#define kobject_to_socket(kobj)	\
+	(struct socket *)((kobj)->data)
 
-static void socket_release(struct kobject *kobj)
+#define SOCKET_IDX(sk, idx)	((idx) & ((sk)->size - 1))
+
+static inline size_t socket_used(struct socket *sk)
 {
-	struct socket *sk = (struct socket *)kobj->data;
+	return sk->ring->head - sk->ring->tail;
+}
 
-	free_pages(sk->shmem);
-	free(sk);
+static inline int socket_readable(struct socket *sk)
+{
+	return (socket_used(sk) != 0) || (sk->wstate == SK_STAT_CLOSED);
 }
 
-static long endpoint_recv(struct kobject *kobj, void __user *data,
+static inline int socket_writable(struct socket *sk)
+{
+	return (socket_used(sk) != sk->size) || (sk->rstate == SK_STAT_CLOSED);
+}
+
+static void socket_wake_all(struct event *ev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ev->lock, flags);
+	wake_up_event_waiter(ev, 0, TASK_STATE_PEND_OK, WAKEUP_ALL);
+	spin_unlock_irqrestore(&ev->lock, flags);
+}
+
+static void socket_notify(struct socket *sk, int who)
+{
+	if (who & SOCKET_NOTIFY_READER) {
+		wake(&sk->revent, 0);
+		poll_event_send(sk->kobj.poll_struct, EV_IN);
+	}
+
+	if (who & SOCKET_NOTIFY_WRITER) {
+		wake(&sk->wevent, 0);
+		poll_event_send(sk->kobj.poll_struct, EV_OUT);
+	}
+}
+
+static long socket_recv(struct kobject *kobj, void __user *data,
 		size_t data_size, size_t *actual_data, void __user *extra,
 		size_t extra_size, size_t *actual_extra, uint32_t timeout)
 {
-	struct socket *sk = (struct socket *)kobj->data;
-	uint64_t widx, ridx, head, tail;
-	int ret = 0;
+	struct socket *sk = kobject_to_socket(kobj);
+	struct socket_ring *ring = sk->ring;
+	unsigned long head, tail;
+	size_t used, copy = 0, off, first;
+	long ret;
+
+	/*
+	 * mark the reader is waitting before check the ring
+	 * again, then the writer will notify it.
+	 */
+	if (!socket_readable(sk)) {
+		ring->rwait = 1;
+		smp_mb();
+		ret = wait_event(&sk->revent, socket_readable(sk), timeout);
+		ring->rwait = 0;
+		if (ret)
+			return ret;
+	}
 
 	spin_lock(&sk->rlock);
 
-	widx = sk->widx;
-	ridx = sk->ridx;
+	head = ring->head;
+	tail = ring->tail;
 	smp_rmb();
 
-	if (SOCKET_EMPTY(ridx, widx) || (widx - ridx < data_size)) {
-		ret = -ENOSPC;
+	used = head - tail;
+	if (used > sk->size) {
+		ret = -EIO;
+		goto out;
+	} else if (used == 0) {
+		ret = -EOTHERSIDECLOSED;
 		goto out;
 	}
 
-	sk->ridx += data_size;
-	smp_wmb();
-
-out:
-	spin_unlock(&sk->rlock);
-	if (ret)
-		return ret;
-
 	/*
-	 * copy the data to the target.
+	 * data_size is 0 means only wait for the data, return
+	 * the size which can be read.
 	 */
-	ridx = SOCKET_IDX(sk, ridx);
-	tail = ridx + data_size;
-	if (tail > sk->shmem_size) {
-		head = shmem_size - ridx;
-		tail = tail - shmem_size;
-	} else {
-		head = data_size;
-		tail = 0;
+	copy = MIN(used, data_size);
+	if (copy == 0) {
+		ret = used;
+		goto out;
 	}
 
-	ret = copy_to_user(data, sk->shmem + ridx, head);
-	if (ret <= 0)
-		return ret;
+	off = SOCKET_IDX(sk, tail);
+	first = MIN(copy, sk->size - off);
 
-	if (tail)
-		ret = copy_to_user(data + head, sk->shmem, tail);
+	ret = copy_to_user(data, sk->data + off, first);
+	if ((ret > 0) && (copy > first))
+		ret = copy_to_user(data + first, sk->data, copy - first);
+	if (ret < 0)
+		goto out;
+
+	smp_mb();
+	ring->tail = tail + copy;
+	*actual_data = copy;
+	ret = copy;
+out:
+	spin_unlock(&sk->rlock);
+
+	if ((ret > 0) && (copy > 0) && (ring->wwait || (used == sk->size)))
+		socket_notify(sk, SOCKET_NOTIFY_WRITER);
 
 	return ret;
 }
 
 static long socket_send(struct kobject *kobj, void __user *data,
-		size_t data_size, size_t *actual_data, void __user *extra,
-		size_t extra_size, size_t *actual_extra, uint32_t timeout)
+		size_t data_size, void __user *extra,
+		size_t extra_size, uint32_t timeout)
 {
-	struct socket *sk = (struct socket *)kobj->data;
-	int ret = 0;
+	struct socket *sk = kobject_to_socket(kobj);
+	struct socket_ring *ring = sk->ring;
+	unsigned long head, tail;
+	size_t used, copy = 0, off, first;
+	long ret;
+
+	if (!socket_writable(sk)) {
+		ring->wwait = 1;
+		smp_mb();
+		ret = wait_event(&sk->wevent, socket_writable(sk), timeout);
+		ring->wwait = 0;
+		if (ret)
+			return ret;
+	}
+
+	if (sk->rstate == SK_STAT_CLOSED)
+		return -EOTHERSIDECLOSED;
 
 	spin_lock(&sk->wlock);
 
-	widx = sk->widx;
-	ridx = sk->ridx;
+	head = ring->head;
+	tail = ring->tail;
 	smp_rmb();
 
-	if (SOCKET_FULL(ridx, widx) || (sk->shmem_size - (widx - ridx) < data_size)) {
-		ret = -ENOSPC;
+	used = head - tail;
+	if (used >= sk->size) {
+		ret = (used == sk->size) ? -EAGAIN : -EIO;
 		goto out;
 	}
 
-	widx = SOCKET_IDX(sk, widx);
-	tail = widx + data_size;
-	if (tail > sk->shmem_size) {
-		head = shmem_size - widx;
-		tail = tail - shmem_size;
-	} else {
-		head = data_size;
-		tail = 0;
+	copy = MIN(sk->size - used, data_size);
+	if (copy == 0) {
+		ret = sk->size - used;
+		goto out;
 	}
 
-	ret = copy_from_user(sk->shmem + widx, data, head);
-	if (ret <= 0)
-		goto out;
+	off = SOCKET_IDX(sk, head);
+	first = MIN(copy, sk->size - off);
 
-	if (tail) {
-		ret = copy_from_user(sk->shmem, data + head, tail);
-		if (ret <= 0)
-			goto out;
-	}
+	ret = copy_from_user(sk->data + off, data, first);
+	if ((ret > 0) && (copy > first))
+		ret = copy_from_user(sk->data, data + first, copy - first);
+	if (ret < 0)
+		goto out;
 
-	sk->widx += data_size;
 	smp_wmb();
-
+	ring->head = head + copy;
+	smp_mb();
+	ret = copy;
 out:
 	spin_unlock(&sk->wlock);
+
+	if ((ret > 0) && (copy > 0) && (ring->rwait || (used == 0)))
+		socket_notify(sk, SOCKET_NOTIFY_READER);
+
 	return ret;
 }
 
+static long socket_ctl(struct kobject *kobj, int req, unsigned long data)
+{
+	struct socket *sk = kobject_to_socket(kobj);
+
+	switch (req) {
+	case KOBJ_SOCKET_NOTIFY:
+		socket_notify(sk, (int)data);
+		return 0;
+	default:
+		break;
+	}
+
+	return -EINVAL;
+}
+
+static int socket_poll_ready(struct kobject *kobj, int event)
+{
+	struct socket *sk = kobject_to_socket(kobj);
+
+	switch (event) {
+	case EV_IN:
+		return socket_readable(sk);
+	case EV_OUT:
+		return socket_writable(sk);
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static inline int *socket_mapped(struct socket *sk, right_t right)
+{
+	return (right & KOBJ_RIGHT_WRITE) ? &sk->wmapped : &sk->rmapped;
+}
+
+/*
+ * the reader need to update the tail in the control block, but
+ * the data can only be written by the handle with write right.
+ */
+static int socket_mmap(struct kobject *kobj, right_t right,
+		void **addr, unsigned long *msize)
+{
+	struct socket *sk = kobject_to_socket(kobj);
+	unsigned long base = va2sva(sk->shmem);
+	int *mapped = socket_mapped(sk, right);
+	int ret;
+
+	if (*mapped)
+		return -EBUSY;
+
+	if (right & KOBJ_RIGHT_WRITE) {
+		ret = map_process_memory(current_proc, base, sk->shmem_size,
+				vtop(sk->shmem), VM_RW | VM_SHARED);
+	} else {
+		ret = map_process_memory(current_proc, base,
+				SOCKET_RING_DATA_OFFSET, vtop(sk->shmem),
+				VM_RW | VM_SHARED);
+		if (ret)
+			return ret;
+
+		ret = map_process_memory(current_proc,
+				base + SOCKET_RING_DATA_OFFSET, sk->size,
+				vtop(sk->data), VM_RO | VM_SHARED);
+		if (ret)
+			unmap_process_memory(current_proc, base,
+					SOCKET_RING_DATA_OFFSET);
+	}
+	if (ret)
+		return ret;
+
+	*mapped = 1;
+	*addr = (void *)base;
+	*msize = sk->shmem_size;
+
+	return 0;
+}
+
+static int socket_munmap(struct kobject *kobj, right_t right)
+{
+	struct socket *sk = kobject_to_socket(kobj);
+	int *mapped = socket_mapped(sk, right);
+
+	if (!*mapped)
+		return -ENOENT;
+
+	*mapped = 0;
+
+	return unmap_process_memory(current_proc,
+			va2sva(sk->shmem), sk->shmem_size);
+}
+
+static int socket_close(struct kobject *kobj, right_t right, struct process *proc)
+{
+	struct socket *sk = kobject_to_socket(kobj);
+
+	/*
+	 * wake up the other side, it will see the closed state
+	 * after the data in the ring has been consumed.
+	 */
+	if (right & KOBJ_RIGHT_READ) {
+		sk->rstate = SK_STAT_CLOSED;
+		smp_wmb();
+		socket_wake_all(&sk->wevent);
+	}
+
+	if (right & KOBJ_RIGHT_WRITE) {
+		sk->wstate = SK_STAT_CLOSED;
+		smp_wmb();
+		socket_wake_all(&sk->revent);
+	}
+
+	if (!*socket_mapped(sk, right))
+		return 0;
+
+	*socket_mapped(sk, right) = 0;
+
+	return unmap_process_memory(proc, va2sva(sk->shmem), sk->shmem_size);
+}
+
+static void socket_release(struct kobject *kobj)
+{
+	struct socket *sk = kobject_to_socket(kobj);
+
+	free_pages(sk->shmem);
+	free(sk);
+}
+
 static struct kobject_ops socket_kobject_ops = {
 	.send		= socket_send,
 	.recv		= socket_recv,
 	.release	= socket_release,
+	.close		= socket_close,
+	.mmap		= socket_mmap,
+	.munmap		= socket_munmap,
+	.ctl		= socket_ctl,
+	.poll_ready	= socket_poll_ready,
 };
 
 static int socket_create(struct kobject **kobj, right_t *right, unsigned long data)
 {
-	size_t shmem_size = data;
+	size_t size = data;
 	struct socket *sk;
 	int fls;
 
-	if (shmem_size > HUGE_PAGE_SIZE || shmem_size == 0)
+	if ((size > SOCKET_MAX_SIZE) || (size == 0))
 		return -EINVAL;
 
-	fls = __fls(shmem_size);
-	if (shmem_size & ((1UL << fls) - 1))
+	fls = __fls(size);
+	if (size & ((1UL << fls) - 1))
 		fls += 1;
-	shmem_size = (1UL << fls) > PAGE_SIZE ? (1UL << fls) : PAGE_SIZE;
+	size = (1UL << fls) > PAGE_SIZE ? (1UL << fls) : PAGE_SIZE;
 
 	sk = zalloc(sizeof(struct socket));
 	if (!sk)
 		return -ENOMEM;
 
-	sk->shmem = get_free_pages(shmem_size >> PAGE_SHIFT, GFP_USER);
+	/*
+	 * the first page is the control block of the ring.
+	 */
+	sk->shmem_size = size + SOCKET_RING_DATA_OFFSET;
+	sk->shmem = get_free_pages(sk->shmem_size >> PAGE_SHIFT, GFP_USER);
 	if (!sk->shmem) {
-		free(p);
+		free(sk);
 		return -ENOMEM;
 	}
 
-	sk->shmem_size = shmem_size;
+	sk->ring = (struct socket_ring *)sk->shmem;
+	sk->ring->size = size;
+	sk->data = sk->shmem + SOCKET_RING_DATA_OFFSET;
+	sk->size = size;
+
 	spin_lock_init(&sk->rlock);
 	spin_lock_init(&sk->wlock);
+	event_init(&sk->revent, OS_EVENT_TYPE_NORMAL, sk);
+	event_init(&sk->wevent, OS_EVENT_TYPE_NORMAL, sk);
+
+	kobject_init(&sk->kobj, KOBJ_TYPE_SOCKET, SK_RIGHT_MASK, (unsigned long)sk);
 	sk->kobj.ops = &socket_kobject_ops;
-	kobject_init(&sk->kobj, KOBJ_TYPE_SOCKET, 0, (unsigned long)sk);
 	*kobj = &sk->kobj;
-	*right = KOBJ_RIGHT_RW;
+	*right = SK_RIGHT;
 
 	return 0;
 }
+DEFINE_KOBJECT(socket, KOBJ_TYPE_SOCKET, socket_create);
@@ -24,6 +24,10 @@
 #include <uspace/poll.h>
 #include <uspace/vspace.h>
 #include <uspace/proc.h>
+#include <uspace/grant.h>
+#include <uspace/iqueue.h>
+
+#include "kobject_copy.h"
 
 void sys_sched_yield(void)
 {
@@ -131,6 +135,253 @@ out:
 	return ret;
 }
 
+/*
+ * send the message with some pages granted to the receiver, the
+ * grant is only supported by the kobject based on iqueue.
+ */
+long sys_kobject_send_grant(handle_t handle, void __user *data,
+		size_t data_size, struct kobject_grant __user *grant,
+		int nr_grant, uint32_t timeout)
+{
+	struct ipc_grant ig;
+	struct kobject *kobj;
+	right_t right;
+	long ret;
+
+	ret = get_kobject(handle, &kobj, &right);
+	if (ret)
+		return ret;
+
+	if (!(right & KOBJ_RIGHT_WRITE)) {
+		ret = -EPERM;
+		goto out;
+	}
+
+	if ((kobj->type != KOBJ_TYPE_ENDPOINT) &&
+			(kobj->type != KOBJ_TYPE_PORT)) {
+		ret = -EACCES;
+		goto out;
+	}
+
+	ret = ipc_grant_setup(&ig, grant, nr_grant);
+	if (ret)
+		goto out;
+
+	current->ipc_grant = &ig;
+	ret = kobject_send(kobj, data, data_size, NULL, 0, timeout);
+	current->ipc_grant = NULL;
+
+	ipc_grant_release(&ig);
+out:
+	put_kobject(kobj);
+	return ret;
+}
+
+/*
+ * receive the pending messages as many as possible in one call,
+ * only the first one will wait for the message.
+ */
+long sys_kobject_recvv(handle_t handle, struct kobject_recv_vec __user *uvec,
+		int nr, uint32_t timeout)
+{
+	struct kobject_recv_vec vec;
+	struct ipc_buf buf;
+	struct kobject *kobj;
+	right_t right;
+	long ret;
+	int i;
+
+	if ((nr <= 0) || (nr > KOBJ_IOV_MAX))
+		return -EINVAL;
+
+	ret = get_kobject(handle, &kobj, &right);
+	if (ret)
+		return ret;
+
+	if (!(right & KOBJ_RIGHT_READ)) {
+		ret = -EPERM;
+		goto out;
+	}
+
+	for (i = 0; i < nr; i++) {
+		ret = copy_from_user(&vec, &uvec[i], sizeof(vec));
+		if (ret < 0)
+			break;
+
+		buf.data = vec.data;
+		buf.data_size = vec.data_size;
+		buf.extra = vec.extra;
+		buf.extra_size = vec.extra_size;
+		vec.actual_data = vec.actual_extra = 0;
+
+		current->ipc_buf = &buf;
+		ret = kobject_recv(kobj, vec.data, vec.data_size,
+				&vec.actual_data, vec.extra, vec.extra_size,
+				&vec.actual_extra, i == 0 ? timeout : 0);
+		current->ipc_buf = NULL;
+		if (ret < 0)
+			break;
+
+		/*
+		 * the request has been taken, if the token can not be
+		 * returned nobody can reply it, fail it here so the
+		 * sender will not wait forever.
+		 */
+		vec.token = ret;
+		ret = copy_to_user(&uvec[i], &vec, sizeof(vec));
+		if (ret < 0) {
+			kobject_reply(kobj, right, vec.token, -EFAULT, 0, 0);
+			break;
+		}
+	}
+
+	ret = i ? i : ret;
+out:
+	put_kobject(kobj);
+	return ret;
+}
+
+/*
+ * reply serveral messages in one call, the result of each reply
+ * is stored in the vector.
+ */
+long sys_kobject_replyv(handle_t handle, struct kobject_reply_vec __user *uvec, int nr)
+{
+	struct kobject_reply_vec vec;
+	struct kobject *kobj;
+	right_t right;
+	long ret;
+	int i;
+
+	if ((nr <= 0) || (nr > KOBJ_IOV_MAX))
+		return -EINVAL;
+
+	ret = get_kobject(handle, &kobj, &right);
+	if (ret)
+		return ret;
+
+	if (!(right & KOBJ_RIGHT_READ)) {
+		ret = -EPERM;
+		goto out;
+	}
+
+	for (i = 0; i < nr; i++) {
+		ret = copy_from_user(&vec, &uvec[i], sizeof(vec));
+		if (ret < 0)
+			break;
+
+		vec.ret = kobject_reply(kobj, right, vec.token,
+				vec.err_code, vec.handle, vec.right);
+
+		ret = copy_to_user(&uvec[i].ret, &vec.ret, sizeof(vec.ret));
+		if (ret < 0)
+			break;
+	}
+
+	ret = i ? i : ret;
+out:
+	put_kobject(kobj);
+	return ret;
+}
+
+static inline int kobject_fast_allowed(struct kobject *kobj)
+{
+	return (kobj->type == KOBJ_TYPE_ENDPOINT) ||
+		(kobj->type == KOBJ_TYPE_PORT);
+}
+
+/*
+ * the fast path of the ipc, the message and the reply are
+ * passed by registers, no user memory need to be copied.
+ */
+long sys_kobject_send_fast(handle_t handle, struct ipc_fast *fast,
+		uint32_t timeout)
+{
+	struct kobject *kobj;
+	right_t right;
+	long ret;
+
+	ret = get_kobject(handle, &kobj, &right);
+	if (ret)
+		return ret;
+
+	if (!(right & KOBJ_RIGHT_WRITE)) {
+		ret = -EPERM;
+		goto out;
+	}
+
+	if (!kobject_fast_allowed(kobj)) {
+		ret = -EACCES;
+		goto out;
+	}
+
+	current->ipc_fast = fast;
+	ret = kobject_send(kobj, NULL, 0, NULL, 0, timeout);
+	current->ipc_fast = NULL;
+out:
+	put_kobject(kobj);
+	return ret;
+}
+
+long sys_kobject_recv_fast(handle_t handle, struct ipc_fast *fast,
+		uint32_t timeout)
+{
+	size_t data = 0, extra = 0;
+	struct kobject *kobj;
+	right_t right;
+	long ret;
+
+	ret = get_kobject(handle, &kobj, &right);
+	if (ret)
+		return ret;
+
+	if (!(right & KOBJ_RIGHT_READ)) {
+		ret = -EPERM;
+		goto out;
+	}
+
+	if (!kobject_fast_allowed(kobj)) {
+		ret = -EACCES;
+		goto out;
+	}
+
+	current->ipc_fast = fast;
+	ret = kobject_recv(kobj, NULL, 0, &data, NULL, 0, &extra, timeout);
+	current->ipc_fast = NULL;
+out:
+	put_kobject(kobj);
+	return ret;
+}
+
+long sys_kobject_reply_fast(handle_t handle, unsigned long token,
+		long err_code, struct ipc_fast *fast)
+{
+	struct kobject *kobj;
+	right_t right;
+	long ret;
+
+	ret = get_kobject(handle, &kobj, &right);
+	if (ret)
+		return ret;
+
+	if (!(right & KOBJ_RIGHT_READ)) {
+		ret = -EPERM;
+		goto out;
+	}
+
+	if (!kobject_fast_allowed(kobj)) {
+		ret = -EACCES;
+		goto out;
+	}
+
+	current->ipc_fast = fast;
+	ret = kobject_reply(kobj, right, token, err_code, -1, 0);
+	current->ipc_fast = NULL;
+out:
+	put_kobject(kobj);
+	return ret;
+}
+
 /*
  * kobject reply can reply a fd to the target process
  * who obtain this handle. if need to reply a fd.
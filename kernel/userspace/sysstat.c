@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <minos/minos.h>
+#include <minos/mm.h>
+#include <minos/time.h>
+#include <minos/percpu.h>
+#include <uspace/kobject.h>
+#include <uspace/syscall.h>
+#include <uspace/sysstat.h>
+
+static struct kobject *syscall_stat_pma;
+static struct syscall_stat_header *syscall_stat_header;
+
+/*
+ * called with the irq disabled, so the per cpu table can be
+ * updated without lock. the syscall may be migrated to other
+ * cpu when it sleeps, the latency is counted on the cpu which
+ * it returns on.
+ */
+unsigned long syscall_stat_enter(unsigned int nr)
+{
+	struct syscall_stat_header *hdr = syscall_stat_header;
+	struct syscall_stat *st;
+
+	if (!hdr || !hdr->enabled || (nr >= SYSCALL_STAT_MAX))
+		return 0;
+
+	st = syscall_stat_table(hdr, smp_processor_id());
+	st[nr].calls++;
+
+	return get_current_time();
+}
+
+void syscall_stat_exit(unsigned int nr, unsigned long start)
+{
+	struct syscall_stat *st;
+	unsigned long ns;
+	int idx;
+
+	if (start == 0)
+		return;
+
+	ns = get_current_time() - start;
+	idx = ns ? fls_long(ns) : 0;
+	if (idx >= SYSCALL_LAT_BUCKETS)
+		idx = SYSCALL_LAT_BUCKETS - 1;
+
+	st = syscall_stat_table(syscall_stat_header, smp_processor_id());
+	st[nr].lat[idx]++;
+}
+
+struct kobject *syscall_stat_kobject(void)
+{
+	return syscall_stat_pma;
+}
+
+int syscall_stat_init(void)
+{
+	struct syscall_stat_header *hdr;
+	struct pma_create_arg args;
+	uint32_t memsz;
+	right_t right;
+	void *addr;
+	int ret;
+
+	memsz = SYSCALL_STAT_OFFSET + SYSCALL_STAT_CPU_SIZE * NR_CPUS;
+	memsz = PAGE_BALIGN(memsz);
+	addr = get_free_pages(memsz >> PAGE_SHIFT, GFP_USER);
+	if (!addr)
+		return -ENOMEM;
+
+	memset(addr, 0, memsz);
+	args.type = PMA_TYPE_PMEM;
+	args.right = KOBJ_RIGHT_RW;
+	args.consequent = 1;
+	args.start = vtop(addr);
+	args.size = memsz;
+	ret = create_new_pma(&syscall_stat_pma, &right, &args);
+	if (ret) {
+		free_pages(addr);
+		return ret;
+	}
+
+	hdr = addr;
+	hdr->nr_cpus = NR_CPUS;
+	hdr->nr_syscalls = __NR_syscalls;
+	hdr->lat_buckets = SYSCALL_LAT_BUCKETS;
+	smp_wmb();
+	syscall_stat_header = hdr;
+	pr_info("syscall stat memory size 0x%x\n", memsz);
+
+	return 0;
+}
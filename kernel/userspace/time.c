@@ -16,8 +16,38 @@
 
 #include <minos/minos.h>
 #include <minos/time.h>
+#include <minos/mm.h>
+#include <minos/init.h>
 #include <uspace/uaccess.h>
 #include <uspace/syscall.h>
+#include <uspace/vspace.h>
+#include <uspace/proc.h>
+#include <uapi/vdso_uapi.h>
+
+static struct vdso_time_data *vdso_time;
+
+static void vdso_time_update(long long realtime_offset)
+{
+	vdso_time->seq++;
+	smp_wmb();
+
+	vdso_time->freq = 1000UL * cpu_khz;
+	vdso_time->boot_tick = boot_tick;
+	vdso_time->realtime_offset = realtime_offset;
+
+	smp_wmb();
+	vdso_time->seq++;
+}
+
+/*
+ * map the time data page to the process, the libc can read
+ * the time without a syscall if the counter is readable in EL0.
+ */
+int map_vdso_time(struct process *proc)
+{
+	return map_process_memory(proc, VDSO_TIME_BASE, PAGE_SIZE,
+			vtop(vdso_time), VM_RO | VM_SHARED);
+}
 
 int sys_clock_gettime(int id, struct timespec __user *ts)
 {
@@ -26,10 +56,14 @@ int sys_clock_gettime(int id, struct timespec __user *ts)
 
 	switch (id) {
 	case CLOCK_REALTIME:
+		t = get_current_time() + vdso_time->realtime_offset;
+		__ts.tv_sec = t / 1000000000;
+		__ts.tv_nsec = t - __ts.tv_sec * 1000000000;
+		break;
 	case CLOCK_MONOTONIC:
 		t = get_current_time();
 		__ts.tv_sec = t / 1000000000;
-		__ts.tv_nsec = t - __ts.tv_sec;
+		__ts.tv_nsec = t - __ts.tv_sec * 1000000000;
 		break;
 	default:
 		pr_err("unsupport clock id %d\n", id);
@@ -47,3 +81,19 @@ int sys_clock_nanosleep(int id, int flags, long time, long ns,
 {
 	return 0;
 }
+
+static int vdso_time_init(void)
+{
+	ASSERT(VDSO_TIME_BASE == PROCESS_TOP_HALF_BASE - PAGE_SIZE);
+
+	vdso_time = get_free_page(GFP_USER);
+	ASSERT(vdso_time != NULL);
+	memset(vdso_time, 0, PAGE_SIZE);
+
+	if (arch_counter_user_readable())
+		vdso_time->flags |= VDSO_TIME_F_COUNTER;
+	vdso_time_update(0);
+
+	return 0;
+}
+module_initcall(vdso_time_init);
@@ -15,71 +15,165 @@
  */
 
 #include <minos/minos.h>
+#include <minos/bitops.h>
 #include <uspace/vspace.h>
 #include <uspace/proc.h>
+#include <uspace/uaccess.h>
 
-int copy_string_from_user(char *dst, char __user *src, int max)
+#define REPEAT_BYTE(x)		((~0UL / 0xff) * (x))
+
+/*
+ * the page may not be mapped yet, since the memory of the
+ * normal process is mapped on demand, ask the root service
+ * to map it and then try again.
+ */
+phy_addr_t uaccess_va_to_pa(struct vspace *vs, unsigned long va, int write)
 {
-	int offset = (unsigned long)src - PAGE_ALIGN(src);
-	int copy_size, left = max, copied = 0;
+	phy_addr_t pa = arch_translate_va_to_pa(vs, va);
+
+	if ((pa == INVALID_ADDR) && !user_page_fault_in(vs, va, write))
+		pa = arch_translate_va_to_pa(vs, va);
+
+	return pa;
+}
+
+/*
+ * the receiver copies the message from the sender's memory, but
+ * it can only page in the memory of its own process. page in the
+ * buffer in the sender's context before it waits the receiver,
+ * the address which can not be paged in is left to the copy.
+ */
+void uaccess_prefault(void __user *addr, size_t size)
+{
+	unsigned long va = (unsigned long)addr;
+	unsigned long end = va + size;
+
+	if ((size == 0) || (end < va))
+		return;
+
+	for (va = PAGE_ALIGN(va); va < end; va += PAGE_SIZE) {
+		if (uaccess_va_to_pa(current->vs, va, 0) == INVALID_ADDR)
+			return;
+	}
+}
+
+/*
+ * the vspace of current process is accessed directly with the
+ * unprivileged load/store, other vspace need to translate the
+ * address to the kernel address page by page.
+ */
+static inline int uaccess_is_current(struct vspace *vs)
+{
+	return (current->vs == vs);
+}
+
+static int uaccess_fast_copy(void *dst, void *src, size_t size, int write)
+{
+	unsigned long left, fault = 0, addr;
 	struct vspace *vs = current->vs;
-	char *ksrc;
 
-	inc_vspace_usage(vs);
+	for (;;) {
+		if (write)
+			left = __arch_copy_to_user(dst, src, size);
+		else
+			left = __arch_copy_from_user(dst, src, size);
+		if (left == 0)
+			return 0;
+
+		/*
+		 * fault on the same address again after it is
+		 * paged in, the address is not valid.
+		 */
+		addr = (unsigned long)(write ? dst : src) + (size - left);
+		if ((addr == fault) || user_page_fault_in(vs, addr, write))
+			return -EFAULT;
+
+		fault = addr;
+		dst += size - left;
+		src += size - left;
+		size = left;
+	}
+}
 
-	while (left) {
-		copy_size = PAGE_SIZE - offset;
-		copy_size = copy_size > left ? left : copy_size;
+static int uaccess_get_user_word(unsigned long *val, unsigned long addr)
+{
+	if (!__arch_get_user_u64(val, (void __user *)addr))
+		return 0;
 
-		ksrc = (void *)arch_translate_va_to_pa(current->vs, (unsigned long)src);
-		if ((phy_addr_t)ksrc == INVALID_ADDR) {
+	if (user_page_fault_in(current->vs, addr, 0))
+		return -EFAULT;
+
+	return __arch_get_user_u64(val, (void __user *)addr) ? -EFAULT : 0;
+}
+
+static inline unsigned long word_has_zero(unsigned long word)
+{
+	return (word - REPEAT_BYTE(0x01)) & ~word & REPEAT_BYTE(0x80);
+}
+
+/*
+ * read the string 8 bytes a time, the load is always 8 bytes
+ * aligned so it will not cross the page boundary. Return the
+ * length of the string including the '\0', or max if there is
+ * no '\0' in max bytes.
+ */
+int copy_string_from_user(char *dst, char __user *src, int max)
+{
+	unsigned long addr = (unsigned long)src;
+	unsigned long word, zero, offset;
+	int copied = 0, n, idx;
+
+	if (max <= 0)
+		return 0;
+
+	if (!user_ranges_ok(src, 1))
+		return -EFAULT;
+
+	inc_vspace_usage(current->vs);
+
+	while (copied < max) {
+		offset = addr & (sizeof(unsigned long) - 1);
+		if (uaccess_get_user_word(&word, addr - offset)) {
 			copied = -EFAULT;
-			goto out;
+			break;
 		}
 
-		ksrc = (char *)ptov(ksrc);
-		while (copy_size > 0) {
-			*dst = *ksrc;
-			copied++;
-
-			if (*ksrc == 0)
-				return copied;
+		word >>= offset * 8;
+		n = sizeof(unsigned long) - offset;
+		n = n > (max - copied) ? (max - copied) : n;
 
-			dst++;
-			ksrc++;
-			copy_size--;
+		zero = word_has_zero(word);
+		idx = zero ? (__ffs(zero) >> 3) : sizeof(unsigned long);
+		if (idx < n) {
+			memcpy(dst + copied, &word, idx + 1);
+			copied += idx + 1;
+			break;
 		}
 
-		offset = 0;
-		left -= copy_size;
-		src += copy_size;
-		dst += copy_size;
+		memcpy(dst + copied, &word, n);
+		copied += n;
+		addr += n;
 	}
 
-out:
-	dec_vspace_usage(vs);
+	dec_vspace_usage(current->vs);
 
 	return copied;
 }
 
-int __copy_from_user(void *dst, struct vspace *vsrc, void __user *src, size_t size)
+static int __copy_from_user_slow(void *dst, struct vspace *vsrc,
+		void __user *src, size_t size)
 {
 	int offset = (unsigned long)src - PAGE_ALIGN(src);
 	int copy_size;
-	size_t cnt = size;
 	void *ksrc;
 
-	inc_vspace_usage(vsrc);
-
 	while (size > 0) {
 		copy_size = PAGE_SIZE - offset;
 		copy_size = copy_size > size ? size : copy_size;
 
-		ksrc = (void *)arch_translate_va_to_pa(vsrc, (unsigned long)src);
-		if ((phy_addr_t)ksrc == INVALID_ADDR) {
-			cnt = -EFAULT;
-			goto out;
-		}
+		ksrc = (void *)uaccess_va_to_pa(vsrc, (unsigned long)src, 0);
+		if ((phy_addr_t)ksrc == INVALID_ADDR)
+			return -EFAULT;
 
 		ksrc = (char *)ptov(ksrc);
 		memcpy(dst, ksrc, copy_size);
@@ -89,30 +183,42 @@ int __copy_from_user(void *dst, struct vspace *vsrc, void __user *src, size_t si
 		dst += copy_size;
 	}
 
-out:
+	return 0;
+}
+
+int __copy_from_user(void *dst, struct vspace *vsrc, void __user *src, size_t size)
+{
+	int ret;
+
+	if (!user_ranges_ok(src, size))
+		return -EFAULT;
+
+	inc_vspace_usage(vsrc);
+
+	if (uaccess_is_current(vsrc))
+		ret = uaccess_fast_copy(dst, src, size, 0);
+	else
+		ret = __copy_from_user_slow(dst, vsrc, src, size);
+
 	dec_vspace_usage(vsrc);
 
-	return cnt;
+	return ret ? ret : size;
 }
 
-int __copy_to_user(struct vspace *vdst, void __user *dst, void *src, size_t size)
+static int __copy_to_user_slow(struct vspace *vdst, void __user *dst,
+		void *src, size_t size)
 {
 	int offset = (unsigned long)dst - PAGE_ALIGN(dst);
 	int copy_size;
-	size_t cnt = size;
 	void *kdst;
 
-	inc_vspace_usage(vdst);
-
 	while (size > 0) {
 		copy_size = PAGE_SIZE - offset;
 		copy_size = copy_size > size ? size : copy_size;
 
-		kdst = (void *)arch_translate_va_to_pa(vdst, (unsigned long)dst);
-		if ((phy_addr_t)kdst == INVALID_ADDR) {
-			cnt = -EFAULT;
-			goto out;
-		}
+		kdst = (void *)uaccess_va_to_pa(vdst, (unsigned long)dst, 1);
+		if ((phy_addr_t)kdst == INVALID_ADDR)
+			return -EFAULT;
 
 		memcpy((void *)ptov(kdst), src, copy_size);
 		offset = 0;
@@ -121,10 +227,26 @@ int __copy_to_user(struct vspace *vdst, void __user *dst, void *src, size_t size
 		dst += copy_size;
 	}
 
-out:
+	return 0;
+}
+
+int __copy_to_user(struct vspace *vdst, void __user *dst, void *src, size_t size)
+{
+	int ret;
+
+	if (!user_ranges_ok(dst, size))
+		return -EFAULT;
+
+	inc_vspace_usage(vdst);
+
+	if (uaccess_is_current(vdst))
+		ret = uaccess_fast_copy(dst, src, size, 1);
+	else
+		ret = __copy_to_user_slow(vdst, dst, src, size);
+
 	dec_vspace_usage(vdst);
 
-	return cnt;
+	return ret ? ret : size;
 }
 
 int copy_from_user(void *dst, void __user *src, size_t size)
@@ -137,39 +259,64 @@ int copy_to_user(void __user *dst, void *src, size_t size)
 	return __copy_to_user(current->vs, dst, src, size);
 }
 
+/*
+ * one side of the copy is usually the current process, walk the
+ * pages of the other side and copy each page with the fast path.
+ */
 int copy_user_to_user(struct vspace *vdst, void __user *dst,
 		struct vspace *vsrc, void __user *src, size_t size)
 {
-	int dst_offset = (unsigned long)dst - PAGE_ALIGN(dst);
-	int copy_size, ret;
+	int src_cur = uaccess_is_current(vsrc);
+	unsigned long uaddr = (unsigned long)(src_cur ? dst : src);
+	int offset = uaddr - PAGE_ALIGN(uaddr);
+	int copy_size, ret = 0;
 	size_t cnt = size;
-	void *kdst;
+	phy_addr_t pa;
+
+	if (!user_ranges_ok(dst, size) || !user_ranges_ok(src, size))
+		return -EFAULT;
 
 	inc_vspace_usage(vdst);
+	inc_vspace_usage(vsrc);
 
 	while (size > 0) {
-		copy_size = PAGE_SIZE - dst_offset;
+		copy_size = PAGE_SIZE - offset;
 		copy_size = copy_size > size ? size : copy_size;
 
-		kdst = (void *)arch_translate_va_to_pa(vdst, (unsigned long)dst);
-		if ((phy_addr_t)kdst == INVALID_ADDR) {
-			cnt = -EFAULT;
-			goto out;
+		if (src_cur) {
+			pa = uaccess_va_to_pa(vdst, (unsigned long)dst, 1);
+			if (pa == INVALID_ADDR) {
+				ret = -EFAULT;
+				break;
+			}
+
+			ret = uaccess_fast_copy((void *)ptov(pa), src, copy_size, 0);
+		} else {
+			pa = uaccess_va_to_pa(vsrc, (unsigned long)src, 0);
+			if (pa == INVALID_ADDR) {
+				ret = -EFAULT;
+				break;
+			}
+
+			if (uaccess_is_current(vdst))
+				ret = uaccess_fast_copy(dst, (void *)ptov(pa), copy_size, 1);
+			else
+				ret = __copy_to_user_slow(vdst, dst, (void *)ptov(pa), copy_size);
 		}
 
-		ret = __copy_from_user((void *)ptov(kdst), vsrc, src, copy_size);
-		if (ret <= 0)
-			return ret;
+		if (ret)
+			break;
 
+		offset = 0;
 		size -= copy_size;
 		src += copy_size;
 		dst += copy_size;
 	}
 
-out:
+	dec_vspace_usage(vsrc);
 	dec_vspace_usage(vdst);
 
-	return cnt;
+	return ret ? ret : cnt;
 }
 
 int copy_string_from_user_safe(char *dst, char __user *src, size_t max)
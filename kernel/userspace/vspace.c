@@ -17,43 +17,169 @@
 #include <minos/minos.h>
 #include <minos/mm.h>
 #include <asm/cpu_feature.h>
+#include <asm/tlb.h>
 #include <uspace/proc.h>
 #include <uspace/vspace.h>
 #include <uspace/poll.h>
 #include <uspace/uaccess.h>
 #include <uspace/vspace.h>
 
-#define MAX_ASID		4096
+/*
+ * the asid is allocated with a generation, the low 16 bits of
+ * vs->asid is the hardware asid, and the high bits are the
+ * generation when it is allocated. When all the asids are used
+ * a new generation is started, all the asids are released except
+ * the ones which are running on other cpus, and each cpu flushes
+ * its local tlb before it switches to a process. So there is no
+ * limit for the number of the processes, and the context switch
+ * only needs the asid_lock when the generation is changed.
+ */
+#define MAX_ASID		(1UL << 16)
+#define ASID_BITS		16
+#define ASID_MASK		(MAX_ASID - 1)
+#define ASID_FIRST_VERSION	(1UL << ASID_BITS)
 #define FIXED_SHARED_ASID	0
 #define FIXED_KERNEL_ASID	1
 #define USER_ASID_BASE		2
 
 static DECLARE_BITMAP(asid_bitmap, MAX_ASID);
 static DEFINE_SPIN_LOCK(asid_lock);
+static unsigned long asid_generation = ASID_FIRST_VERSION;
+static unsigned long asid_next = USER_ASID_BASE;
+static cpumask_t asid_flush_pending;
 static int max_asid;
 
-static int allocate_asid(void)
+static DEFINE_PER_CPU(unsigned long, active_asid);
+static DEFINE_PER_CPU(unsigned long, reserved_asid);
+
+static inline int asid_generation_match(unsigned long asid)
 {
-	int asid = 0;
+	unsigned long gen = *(volatile unsigned long *)&asid_generation;
 
-	if (max_asid <= USER_ASID_BASE)
-		return 0;
+	return !((asid ^ gen) >> ASID_BITS);
+}
+
+static void asid_reserve_fixed(void)
+{
+	set_bit(FIXED_SHARED_ASID, asid_bitmap);
+	set_bit(FIXED_KERNEL_ASID, asid_bitmap);
+}
+
+static void asid_new_generation(void)
+{
+	unsigned long asid;
+	int cpu;
+
+	asid_generation += ASID_FIRST_VERSION;
+	bitmap_zero(asid_bitmap, max_asid);
+	asid_reserve_fixed();
+
+	/*
+	 * keep the asid which is running on each cpu, if the cpu
+	 * has not switched to other process since last rollover,
+	 * the active asid is 0, use the reserved one.
+	 */
+	for_each_online_cpu(cpu) {
+		asid = xchg_relaxed(&get_per_cpu(active_asid, cpu), 0);
+		if (asid == 0)
+			asid = get_per_cpu(reserved_asid, cpu);
+		set_bit(asid & ASID_MASK, asid_bitmap);
+		get_per_cpu(reserved_asid, cpu) = asid;
+	}
+
+	cpumask_setall(&asid_flush_pending);
+}
+
+static int asid_update_reserved(unsigned long asid, unsigned long newasid)
+{
+	int cpu, hit = 0;
+
+	for_each_online_cpu(cpu) {
+		if (get_per_cpu(reserved_asid, cpu) == asid) {
+			get_per_cpu(reserved_asid, cpu) = newasid;
+			hit = 1;
+		}
+	}
+
+	return hit;
+}
+
+static unsigned long allocate_asid(struct vspace *vs)
+{
+	unsigned long asid = vs->asid;
+	unsigned long newasid;
+
+	/*
+	 * try to keep the old asid in the new generation, then
+	 * the tlb entries of this process on the cpus which are
+	 * not flushed yet can still be used.
+	 */
+	if (asid != 0) {
+		newasid = asid_generation | (asid & ASID_MASK);
+		if (asid_update_reserved(asid, newasid))
+			return newasid;
+		if (!test_and_set_bit(asid & ASID_MASK, asid_bitmap))
+			return newasid;
+	}
+
+	asid = find_next_zero_bit(asid_bitmap, max_asid, asid_next);
+	if (asid >= max_asid) {
+		asid_new_generation();
+		asid = find_next_zero_bit(asid_bitmap, max_asid, USER_ASID_BASE);
+	}
+
+	set_bit(asid, asid_bitmap);
+	asid_next = asid;
+
+	return asid_generation | asid;
+}
+
+/*
+ * called before switch to the process on this cpu, make sure the
+ * vspace has an asid of current generation.
+ */
+void vspace_switch_asid(struct vspace *vs)
+{
+	int cpu = smp_processor_id();
+	unsigned long asid, old_active;
+
+	/*
+	 * fast path, the asid is in current generation, the cmpxchg
+	 * fails if there is a rollover on other cpu which has set
+	 * the active asid of this cpu to 0.
+	 */
+	asid = *(volatile unsigned long *)&vs->asid;
+	old_active = get_per_cpu(active_asid, cpu);
+	if (old_active && asid_generation_match(asid) &&
+			cmpxchg_relaxed(&get_per_cpu(active_asid, cpu),
+				old_active, asid))
+		return;
 
 	spin_lock(&asid_lock);
-	asid = find_next_zero_bit(asid_bitmap, max_asid, USER_ASID_BASE);
-	if (asid >= max_asid)
-		asid = 0;
-	else
-		set_bit(asid, asid_bitmap);
-	spin_unlock(&asid_lock);
+	asid = vs->asid;
+	if (!asid_generation_match(asid)) {
+		asid = allocate_asid(vs);
+		WRITE_ONCE(vs->asid, asid);
+	}
 
-	return asid;
+	if (test_and_clear_bit(cpu, asid_flush_pending.bits))
+		flush_local_tlb_host();
+
+	get_per_cpu(active_asid, cpu) = asid;
+	spin_unlock(&asid_lock);
 }
 
-static void free_asid(int asid)
+static void free_asid(struct vspace *vs)
 {
-	BUG_ON((asid >= max_asid) || (asid < USER_ASID_BASE));
-	clear_bit(asid, asid_bitmap);
+	/*
+	 * the tlb entries of this asid have been flushed when
+	 * unmap the whole vspace, release it if it still belongs
+	 * to current generation.
+	 */
+	spin_lock(&asid_lock);
+	if (asid_generation_match(vs->asid))
+		clear_bit(vs->asid & ASID_MASK, asid_bitmap);
+	spin_unlock(&asid_lock);
 }
 
 void inc_vspace_usage(struct vspace *vs)
@@ -165,18 +291,19 @@ static int __map_process_page_internal(struct process *proc,
 		unsigned long virt, size_t size, unsigned long flags)
 {
 	struct vspace *vs = &proc->vspace;
-	unsigned long phy;
-	int ret = 0, i;
+	unsigned long end = virt + size;
+	int ret = 0;
 	void *mem;
 
 	spin_lock(&vs->lock);
 
-	for (i = 0; i < size >> PAGE_SHIFT; i++) {
-		phy = arch_translate_va_to_pa(vs, virt);
-		if (phy != 0) {
-			pr_err("proc-%d 0x%x has been mapped\n", virt);
+	for (; virt < end; virt += PAGE_SIZE) {
+		/*
+		 * the page may already be mapped when populate a
+		 * range for madvise(WILLNEED), skip it.
+		 */
+		if (arch_translate_va_to_pa(vs, virt) != 0)
 			continue;
-		}
 
 		mem = get_free_page(GFP_USER);
 		if (mem == NULL) {
@@ -189,8 +316,6 @@ static int __map_process_page_internal(struct process *proc,
 			free_pages(mem);
 			break;
 		}
-
-		virt += PAGE_SIZE;
 	}
 
 	spin_unlock(&vs->lock);
@@ -342,11 +467,39 @@ unsigned long sys_mtrans(unsigned long virt)
 	return (addr == 0 ? -1 : addr);
 }
 
-static int handle_page_fault_ipc(struct process *proc, unsigned long virt, int write)
+static int handle_page_fault_ipc(struct process *proc,
+		unsigned long virt, right_t right)
+{
+	return process_page_fault(proc, virt, right);
+}
+
+/*
+ * the memory of the normal process is mapped on demand by
+ * the root service, when kernel access the user memory which
+ * is not mapped yet, ask the root service to map it. return
+ * 0 if the page is mapped.
+ *
+ * the current task will wait the root service, so this is only
+ * done for the memory of the current process and when no lock
+ * is held. the root service itself can not wait for itself, the
+ * other cases return -EFAULT as the normal bad address. the ipc
+ * sender pages in its buffer by itself, see uaccess_prefault().
+ */
+int user_page_fault_in(struct vspace *vs, unsigned long virt, int write)
 {
-	uint64_t info = write ? KOBJ_RIGHT_READ : KOBJ_RIGHT_WRITE;
+	struct process *proc = (struct process *)vs->pdata;
+
+	if (!proc || proc_is_root(proc) || proc_is_root(current_proc))
+		return -EFAULT;
 
-	return process_page_fault(proc, virt, info);
+	if ((vs != current->vs) || !preempt_allowed())
+		return -EFAULT;
+
+	if (handle_page_fault_ipc(proc, virt,
+			write ? KOBJ_RIGHT_WRITE : KOBJ_RIGHT_READ))
+		return -EFAULT;
+
+	return 0;
 }
 
 int handle_user_page_fault(unsigned long virt, int write, unsigned long fault_type)
@@ -358,7 +511,8 @@ int handle_user_page_fault(unsigned long virt, int write, unsigned long fault_ty
 	if (proc_is_root(proc))
 		ret = handle_page_fault_internal(proc, virt, write);
 	else
-		ret = handle_page_fault_ipc(proc, virt, write);
+		ret = handle_page_fault_ipc(proc, virt,
+				write ? KOBJ_RIGHT_WRITE : KOBJ_RIGHT_READ);
 	if (!ret)
 		return 0;
 
@@ -372,11 +526,20 @@ int handle_user_page_fault(unsigned long virt, int write, unsigned long fault_ty
 	return -EFAULT;
 }
 
-int handle_user_ia_fault(void)
+int handle_user_ia_fault(unsigned long virt, unsigned long fault_type)
 {
+	struct process *proc = current_proc;
+
+	/*
+	 * the text of the normal process is paged in when it is
+	 * executed at the first time.
+	 */
+	if (!proc_is_root(proc) && !handle_page_fault_ipc(proc, virt, KOBJ_RIGHT_EXEC))
+		return 0;
+
 	process_die();
 
-	return 0;
+	return -EFAULT;
 }
 
 static void user_unmap_range(struct vspace *vspace, unsigned long start,
@@ -398,7 +561,7 @@ int vspace_init(struct process *proc)
 	if (!vs->pgdp)
 		return -ENOMEM;
 
-	vs->asid = allocate_asid();
+	vs->asid = 0;
 	vs->pdata = proc;
 	vs->notifier_ops = &user_mm_notifier_ops;
 
@@ -414,7 +577,7 @@ void vspace_deinit(struct process *proc)
 	if (vs->pgdp)
 		free(vs->pgdp);
 	if (vs->asid != 0)
-		free_asid(vs->asid);
+		free_asid(vs);
 }
 
 static int umm_init(void)
@@ -422,12 +585,9 @@ static int umm_init(void)
 	max_asid = arch_get_asid_size();
 	pr_info("max asid %d\n", max_asid);
 	max_asid = max_asid > MAX_ASID ? MAX_ASID : max_asid;
+	BUG_ON(max_asid <= USER_ASID_BASE);
 
-	if (max_asid > USER_ASID_BASE) {
-		bitmap_set(asid_bitmap, max_asid, BITMAP_SIZE(MAX_ASID));
-		set_bit(FIXED_SHARED_ASID, asid_bitmap);
-		set_bit(FIXED_KERNEL_ASID, asid_bitmap);
-	}
+	asid_reserve_fixed();
 
 	return 0;
 }
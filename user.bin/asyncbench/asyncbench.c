@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <minos/kobject.h>
+#include <minos/async.h>
+
+/*
+ * compare the cost of the notify and futex wake operations issued
+ * by one syscall each, and by the async ring in batches.
+ *
+ * usage: asyncbench [batch] [loops]
+ */
+#define ASYNCBENCH_BATCH	32
+#define ASYNCBENCH_LOOPS	100000
+
+#define FUTEX_WAKE		1
+#define FUTEX_PRIVATE		128
+
+struct asyncbench {
+	int notify;
+	int batch;
+	int loops;
+	struct async_desc ad;
+	volatile int futex_word;
+	unsigned long msg[3];
+};
+
+static unsigned long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static long sync_notify(struct asyncbench *ab)
+{
+	return kobject_write(ab->notify, NULL, 0, ab->msg, sizeof(ab->msg), 0);
+}
+
+static long sync_futex(struct asyncbench *ab)
+{
+	return syscall(SYS_futex, &ab->futex_word,
+			FUTEX_WAKE | FUTEX_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void prep_notify(struct asyncbench *ab, struct async_sqe *sqe)
+{
+	sqe->op = ASYNC_OP_NOTIFY;
+	sqe->handle = ab->notify;
+	sqe->addr2 = (unsigned long)ab->msg;
+	sqe->len2 = sizeof(ab->msg);
+}
+
+static void prep_futex(struct asyncbench *ab, struct async_sqe *sqe)
+{
+	sqe->op = ASYNC_OP_FUTEX;
+	sqe->arg = FUTEX_WAKE | FUTEX_PRIVATE;
+	sqe->addr = (unsigned long)&ab->futex_word;
+	sqe->len = 1;
+}
+
+static void report(const char *name, int loops, unsigned long ns)
+{
+	if (ns == 0)
+		ns = 1;
+
+	printf("  %-14s: %d ops in %lu us, %lu ns/op\n", name,
+			loops, ns / 1000, ns / loops);
+}
+
+static int run_sync(struct asyncbench *ab, const char *name,
+		long (*op)(struct asyncbench *))
+{
+	unsigned long start;
+	long ret;
+	int i;
+
+	start = now_ns();
+
+	for (i = 0; i < ab->loops; i++) {
+		ret = op(ab);
+		if (ret < 0) {
+			printf("asyncbench %s failed %ld\n", name, ret);
+			return -1;
+		}
+	}
+
+	report(name, ab->loops, now_ns() - start);
+
+	return 0;
+}
+
+static int run_async(struct asyncbench *ab, const char *name,
+		void (*prep)(struct asyncbench *, struct async_sqe *))
+{
+	struct async_sqe *sqe;
+	struct async_cqe *cqe;
+	unsigned long start;
+	int done = 0, i, cnt;
+	long ret;
+
+	start = now_ns();
+
+	while (done < ab->loops) {
+		cnt = ab->loops - done;
+		if (cnt > ab->batch)
+			cnt = ab->batch;
+
+		for (i = 0; i < cnt; i++) {
+			sqe = async_get_sqe(&ab->ad);
+			if (!sqe)
+				break;
+			prep(ab, sqe);
+		}
+
+		ret = async_submit(&ab->ad);
+		if (ret < 0) {
+			printf("asyncbench %s submit failed %ld\n", name, ret);
+			return -1;
+		}
+
+		while ((cqe = async_peek_cqe(&ab->ad)) != NULL) {
+			if (cqe->res < 0) {
+				printf("asyncbench %s failed %ld\n", name, cqe->res);
+				return -1;
+			}
+			async_cqe_seen(&ab->ad);
+			done++;
+		}
+	}
+
+	report(name, ab->loops, now_ns() - start);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct asyncbench ab;
+	int ret;
+
+	memset(&ab, 0, sizeof(ab));
+	ab.batch = ASYNCBENCH_BATCH;
+	ab.loops = ASYNCBENCH_LOOPS;
+
+	if (argc > 1)
+		ab.batch = atoi(argv[1]);
+	if (argc > 2)
+		ab.loops = atoi(argv[2]);
+	if ((ab.batch <= 0) || (ab.batch > ASYNC_MAX_ENTRIES) || (ab.loops <= 0)) {
+		printf("usage: asyncbench [batch] [loops]\n");
+		return -1;
+	}
+
+	ab.notify = kobject_create_notify();
+	if (ab.notify < 0) {
+		printf("asyncbench create notify failed %d\n", ab.notify);
+		return -1;
+	}
+
+	ret = async_setup(&ab.ad, ASYNC_MAX_ENTRIES);
+	if (ret) {
+		printf("asyncbench setup async ring failed %d\n", ret);
+		return -1;
+	}
+
+	printf("asyncbench batch %d loops %d\n", ab.batch, ab.loops);
+
+	if (run_sync(&ab, "sync notify", sync_notify) ||
+			run_async(&ab, "async notify", prep_notify) ||
+			run_sync(&ab, "sync futex", sync_futex) ||
+			run_async(&ab, "async futex", prep_futex))
+		ret = -1;
+
+	async_exit(&ab.ad);
+	kobject_close(ab.notify);
+
+	return ret;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+/*
+ * many threads wait on one condition variable, the main thread
+ * broadcasts it once all of them are waiting, and checks that
+ * every waiter sees every round. the private condvar hands the
+ * waiters to the mutex by futex requeue, the shared one wakes
+ * all of them.
+ *
+ * usage: condstress [threads] [rounds]
+ */
+#define CONDSTRESS_THREADS	64
+#define CONDSTRESS_ROUNDS	1000
+#define CONDSTRESS_TIMEOUT	5	/* seconds without progress */
+
+struct condstress {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_cond_t arrive;
+	int threads;
+	int rounds;
+	int round;
+	int arrived;
+	int missed;
+};
+
+static unsigned long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static void *condstress_waiter(void *data)
+{
+	struct condstress *cs = data;
+	int r;
+
+	pthread_mutex_lock(&cs->lock);
+
+	for (r = 0; r < cs->rounds; r++) {
+		if (cs->round != r)
+			cs->missed++;
+
+		if (++cs->arrived == cs->threads)
+			pthread_cond_signal(&cs->arrive);
+
+		while (cs->round == r)
+			pthread_cond_wait(&cs->cond, &cs->lock);
+	}
+
+	pthread_mutex_unlock(&cs->lock);
+
+	return NULL;
+}
+
+static int condstress_run(struct condstress *cs, int pshared)
+{
+	pthread_condattr_t attr;
+	pthread_t *tids;
+	struct timespec ts;
+	unsigned long start;
+	int i, r, ret = 0;
+
+	tids = calloc(cs->threads, sizeof(pthread_t));
+	if (!tids)
+		return -ENOMEM;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setpshared(&attr, pshared);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_mutex_init(&cs->lock, NULL);
+	pthread_cond_init(&cs->cond, &attr);
+	pthread_cond_init(&cs->arrive, &attr);
+	cs->round = 0;
+	cs->arrived = 0;
+	cs->missed = 0;
+
+	for (i = 0; i < cs->threads; i++) {
+		if (pthread_create(&tids[i], NULL, condstress_waiter, cs)) {
+			printf("condstress create waiter %d failed\n", i);
+			cs->threads = i;
+			ret = -1;
+			break;
+		}
+	}
+
+	start = now_ns();
+	pthread_mutex_lock(&cs->lock);
+
+	for (r = 0; (ret == 0) && (r < cs->rounds); r++) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		ts.tv_sec += CONDSTRESS_TIMEOUT;
+
+		while (cs->arrived < cs->threads) {
+			if (pthread_cond_timedwait(&cs->arrive,
+					&cs->lock, &ts) == ETIMEDOUT) {
+				printf("condstress round %d stalled, %d/%d waiters\n",
+						r, cs->arrived, cs->threads);
+				ret = -1;
+				break;
+			}
+		}
+
+		cs->arrived = 0;
+		cs->round++;
+		pthread_cond_broadcast(&cs->cond);
+	}
+
+	/*
+	 * let the waiters leave even if a round is stalled.
+	 */
+	cs->round = cs->rounds;
+	cs->rounds = 0;
+	pthread_cond_broadcast(&cs->cond);
+	pthread_mutex_unlock(&cs->lock);
+
+	if (ret == 0) {
+		for (i = 0; i < cs->threads; i++)
+			pthread_join(tids[i], NULL);
+	}
+
+	if (cs->missed) {
+		printf("condstress %d rounds missed\n", cs->missed);
+		ret = -1;
+	}
+
+	printf("  %-8s: %d waiters %d rounds in %lu us\n",
+			pshared ? "shared" : "private", cs->threads,
+			cs->round, (now_ns() - start) / 1000);
+
+	if (ret == 0) {
+		pthread_cond_destroy(&cs->arrive);
+		pthread_cond_destroy(&cs->cond);
+		pthread_mutex_destroy(&cs->lock);
+	}
+	pthread_condattr_destroy(&attr);
+	free(tids);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	struct condstress cs;
+	int threads = CONDSTRESS_THREADS;
+	int rounds = CONDSTRESS_ROUNDS;
+	int ret;
+
+	if (argc > 1)
+		threads = atoi(argv[1]);
+	if (argc > 2)
+		rounds = atoi(argv[2]);
+	if ((threads <= 0) || (rounds <= 0)) {
+		printf("usage: condstress [threads] [rounds]\n");
+		return -1;
+	}
+
+	printf("condstress threads %d rounds %d\n", threads, rounds);
+
+	memset(&cs, 0, sizeof(cs));
+	cs.threads = threads;
+	cs.rounds = rounds;
+	ret = condstress_run(&cs, PTHREAD_PROCESS_PRIVATE);
+	if (ret)
+		return ret;
+
+	cs.threads = threads;
+	cs.rounds = rounds;
+
+	return condstress_run(&cs, PTHREAD_PROCESS_SHARED);
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+/*
+ * measure the latency of execv + waitpid, the target should
+ * exit at once, the first run is the cold one, the image is
+ * not in the cache of pangu and nvwa.
+ *
+ * usage: execbench [path] [loops]
+ */
+#define EXECBENCH_DEFAULT_APP	"/c/bin/test.app"
+#define EXECBENCH_DEFAULT_LOOPS	32
+
+static unsigned long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static long exec_once(char *path)
+{
+	char *argv[] = { NULL };
+	unsigned long start;
+	int pid;
+
+	start = now_ns();
+
+	pid = execv(path, argv);
+	if (pid <= 0) {
+		printf("exec %s failed %d\n", path, pid);
+		return -1;
+	}
+
+	waitpid(pid, NULL, 0);
+
+	return now_ns() - start;
+}
+
+int main(int argc, char **argv)
+{
+	char *path = EXECBENCH_DEFAULT_APP;
+	int loops = EXECBENCH_DEFAULT_LOOPS;
+	unsigned long total = 0, min = -1UL, max = 0;
+	long cold, t;
+	int i;
+
+	if (argc > 1)
+		path = argv[1];
+	if (argc > 2)
+		loops = atoi(argv[2]);
+	if (loops <= 0)
+		loops = 1;
+
+	cold = exec_once(path);
+	if (cold < 0)
+		return -1;
+
+	for (i = 0; i < loops; i++) {
+		t = exec_once(path);
+		if (t < 0)
+			return -1;
+
+		total += t;
+		if (t < min)
+			min = t;
+		if (t > max)
+			max = t;
+	}
+
+	printf("execbench %s\n", path);
+	printf("  cold  : %lu us\n", cold / 1000);
+	printf("  warm  : avg %lu us min %lu us max %lu us (%d loops)\n",
+			total / loops / 1000, min / 1000, max / 1000, loops);
+
+	return 0;
+}
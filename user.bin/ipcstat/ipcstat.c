@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <minos/kobject.h>
+#include <minos/procinfo.h>
+#include <minos/proto.h>
+
+/*
+ * dump the ipc statistics of the endpoints and ports, and the
+ * ipc trace ring.
+ *
+ * usage: ipcstat [-l] | trace [on | off]
+ */
+static const char *trace_name[] = {
+	[IPC_TRACE_SEND]	= "send",
+	[IPC_TRACE_RECV]	= "recv",
+	[IPC_TRACE_REPLY]	= "reply",
+};
+
+static const char *kobj_type_name(int type)
+{
+	switch (type) {
+	case KOBJ_TYPE_ENDPOINT:
+		return "endpoint";
+	case KOBJ_TYPE_PORT:
+		return "port";
+	default:
+		return "unknown";
+	}
+}
+
+static unsigned long long hist_total(unsigned long long *hist)
+{
+	unsigned long long total = 0;
+	int i;
+
+	for (i = 0; i < IPC_LAT_BUCKETS; i++)
+		total += hist[i];
+
+	return total;
+}
+
+/*
+ * the upper bound in us of the bucket which the percentile falls.
+ */
+static unsigned long hist_percentile(unsigned long long *hist, int pct)
+{
+	unsigned long long total = hist_total(hist), sum = 0;
+	int i;
+
+	if (total == 0)
+		return 0;
+
+	for (i = 0; i < IPC_LAT_BUCKETS; i++) {
+		sum += hist[i];
+		if (sum * 100 >= total * pct)
+			break;
+	}
+
+	return 1UL << (i < IPC_LAT_BUCKETS ? i : IPC_LAT_BUCKETS - 1);
+}
+
+static void print_hist(const char *name, unsigned long long *hist)
+{
+	int i;
+
+	printf("    %-6s:", name);
+	for (i = 0; i < IPC_LAT_BUCKETS; i++)
+		printf(" %llu", hist[i]);
+	printf("\n");
+}
+
+static void print_stats(struct ipc_stat *stats, int verbose)
+{
+	struct ipc_stat *st;
+	int i;
+
+	printf(" ID  PID TYPE     MSGS       BYTES        DEPTH MAX   "
+			"Q50(us) Q99(us) S50(us) S99(us)\n");
+
+	for (i = 0; i < IPC_STAT_MAX; i++) {
+		st = &stats[i];
+		if (st->type == 0)
+			continue;
+
+		printf("%3d %4d %-8s %-10llu %-12llu %-5u %-5u %-7lu %-7lu %-7lu %-7lu\n",
+				i, st->owner, kobj_type_name(st->type),
+				st->msgs, st->bytes, st->depth, st->depth_max,
+				hist_percentile(st->queue_lat, 50),
+				hist_percentile(st->queue_lat, 99),
+				hist_percentile(st->serve_lat, 50),
+				hist_percentile(st->serve_lat, 99));
+
+		if (verbose) {
+			print_hist("queue", st->queue_lat);
+			print_hist("serve", st->serve_lat);
+		}
+	}
+}
+
+static void dump_trace(struct ipc_trace_ring *ring)
+{
+	unsigned long long head = ring->head, start;
+	struct ipc_trace_event *ev;
+
+	start = head > ring->entries ? head - ring->entries : 0;
+	printf("TIME(ns)             EVENT ID  SENDER RECEIVER TOKEN\n");
+
+	for (; start < head; start++) {
+		ev = &ring->events[start & (ring->entries - 1)];
+		if (ev->type > IPC_TRACE_REPLY)
+			continue;
+
+		printf("%-20llu %-5s %-3d %-6d %-8d 0x%lx\n", ev->ts,
+				trace_name[ev->type], ev->stat_id,
+				ev->sender, ev->receiver, ev->token);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct ipc_trace_ring *ring;
+	void *addr;
+	int handle;
+
+	handle = sys_ipcstat_handle();
+	if (handle <= 0) {
+		printf("can not get ipc stat handle %d\n", handle);
+		return -ENOENT;
+	}
+
+	if (kobject_mmap(handle, &addr, NULL)) {
+		printf("mmap ipc stat mem failed\n");
+		return -EFAULT;
+	}
+
+	ring = addr + IPC_TRACE_OFFSET;
+
+	if ((argc > 1) && !strcmp(argv[1], "trace")) {
+		if (argc == 2)
+			dump_trace(ring);
+		else if (!strcmp(argv[2], "on"))
+			return sys_ipcstat_ctl(PROTO_STAT_ON);
+		else if (!strcmp(argv[2], "off"))
+			return sys_ipcstat_ctl(PROTO_STAT_OFF);
+		else
+			goto usage;
+
+		return 0;
+	}
+
+	if ((argc > 1) && strcmp(argv[1], "-l"))
+		goto usage;
+
+	print_stats(addr, argc > 1);
+
+	return 0;
+
+usage:
+	printf("usage: ipcstat [-l] | trace [on | off]\n");
+	return -EINVAL;
+}
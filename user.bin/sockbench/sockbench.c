@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <minos/kobject.h>
+#include <minos/socket.h>
+
+/*
+ * measure the throughput of the socket kobject, a thread writes
+ * the data and another thread reads it, both by the mapped ring
+ * and by the kernel copy.
+ *
+ * usage: sockbench [ring size] [chunk size] [total MB]
+ */
+#define SOCKBENCH_RING_SIZE	(64 * 1024)
+#define SOCKBENCH_CHUNK_SIZE	1024
+#define SOCKBENCH_TOTAL_MB	64
+
+struct sockbench {
+	int handle;
+	int use_ring;
+	struct socket_desc sd;
+	size_t chunk;
+	size_t total;
+};
+
+static unsigned long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static void *sockbench_reader(void *data)
+{
+	struct sockbench *sb = data;
+	size_t left = sb->total;
+	char *buf;
+	long ret;
+
+	buf = malloc(sb->chunk);
+	if (!buf)
+		return (void *)-1;
+
+	while (left > 0) {
+		if (sb->use_ring)
+			ret = socket_read(&sb->sd, buf, sb->chunk, -1);
+		else
+			ret = kobject_read(sb->handle, buf, sb->chunk,
+					NULL, NULL, 0, NULL, -1);
+		if (ret < 0) {
+			printf("sockbench read failed %ld\n", ret);
+			break;
+		}
+		left -= ret;
+	}
+
+	free(buf);
+
+	return NULL;
+}
+
+static long sockbench_writer(struct sockbench *sb)
+{
+	size_t left = sb->total, size;
+	char *buf;
+	long ret = 0;
+
+	buf = malloc(sb->chunk);
+	if (!buf)
+		return -1;
+	memset(buf, 0x5a, sb->chunk);
+
+	while (left > 0) {
+		size = left < sb->chunk ? left : sb->chunk;
+		if (sb->use_ring)
+			ret = socket_write(&sb->sd, buf, size, -1);
+		else
+			ret = kobject_write(sb->handle, buf, size, NULL, 0, -1);
+		if (ret < 0) {
+			printf("sockbench write failed %ld\n", ret);
+			break;
+		}
+		left -= ret;
+	}
+
+	free(buf);
+
+	return ret < 0 ? ret : 0;
+}
+
+static int sockbench_run(struct sockbench *sb, const char *name)
+{
+	unsigned long start, ns;
+	pthread_t reader;
+	long ret;
+
+	start = now_ns();
+
+	if (pthread_create(&reader, NULL, sockbench_reader, sb)) {
+		printf("sockbench create reader failed\n");
+		return -1;
+	}
+
+	ret = sockbench_writer(sb);
+	pthread_join(reader, NULL);
+	if (ret)
+		return ret;
+
+	ns = now_ns() - start;
+	if (ns == 0)
+		ns = 1;
+
+	printf("  %-6s: %lu MB in %lu us, %lu MB/s\n", name,
+			(unsigned long)(sb->total >> 20), ns / 1000,
+			(unsigned long)((sb->total >> 20) * 1000000000UL / ns));
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	size_t ring_size = SOCKBENCH_RING_SIZE;
+	struct sockbench sb;
+	int total = SOCKBENCH_TOTAL_MB;
+
+	memset(&sb, 0, sizeof(sb));
+	sb.chunk = SOCKBENCH_CHUNK_SIZE;
+
+	if (argc > 1)
+		ring_size = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		sb.chunk = strtoul(argv[2], NULL, 0);
+	if (argc > 3)
+		total = atoi(argv[3]);
+	if ((sb.chunk == 0) || (total <= 0)) {
+		printf("usage: sockbench [ring size] [chunk size] [total MB]\n");
+		return -1;
+	}
+	sb.total = (size_t)total << 20;
+
+	sb.handle = kobject_create_socket(ring_size);
+	if (sb.handle < 0) {
+		printf("sockbench create socket failed %d\n", sb.handle);
+		return -1;
+	}
+
+	if (socket_attach(&sb.sd, sb.handle)) {
+		printf("sockbench map socket failed\n");
+		return -1;
+	}
+
+	printf("sockbench ring %lu chunk %lu\n",
+			(unsigned long)sb.sd.size, (unsigned long)sb.chunk);
+
+	sb.use_ring = 1;
+	if (sockbench_run(&sb, "ring"))
+		return -1;
+
+	sb.use_ring = 0;
+	if (sockbench_run(&sb, "copy"))
+		return -1;
+
+	socket_detach(&sb.sd);
+	kobject_close(sb.handle);
+
+	return 0;
+}
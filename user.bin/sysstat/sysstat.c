@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/syscall.h>
+
+#include <minos/kobject.h>
+#include <minos/procinfo.h>
+#include <minos/proto.h>
+
+/*
+ * dump the call count and the latency of each syscall, summed
+ * over all the cpus.
+ *
+ * usage: sysstat [-l] | on | off | reset
+ */
+#define SYSCALL_NAME(name)	[__NR_##name] = #name
+
+static const char *syscall_name[SYSCALL_STAT_MAX] = {
+	SYSCALL_NAME(kobject_create),
+	SYSCALL_NAME(kobject_open),
+	SYSCALL_NAME(kobject_close),
+	SYSCALL_NAME(kobject_recv),
+	SYSCALL_NAME(kobject_send),
+	SYSCALL_NAME(kobject_reply),
+	SYSCALL_NAME(kobject_reply_recv),
+	SYSCALL_NAME(kobject_ctl),
+	SYSCALL_NAME(kobject_mmap),
+	SYSCALL_NAME(kobject_munmap),
+	SYSCALL_NAME(grant),
+	SYSCALL_NAME(futex),
+	SYSCALL_NAME(yield),
+	SYSCALL_NAME(map),
+	SYSCALL_NAME(unmap),
+	SYSCALL_NAME(mtrans),
+	SYSCALL_NAME(clock_gettime),
+	SYSCALL_NAME(clock_nanosleep),
+	SYSCALL_NAME(exit),
+	SYSCALL_NAME(exitgroup),
+	SYSCALL_NAME(clone),
+	SYSCALL_NAME(kobject_send_grant),
+	SYSCALL_NAME(kobject_send_fast),
+	SYSCALL_NAME(kobject_recv_fast),
+	SYSCALL_NAME(kobject_reply_fast),
+	SYSCALL_NAME(kobject_recvv),
+	SYSCALL_NAME(kobject_replyv),
+};
+
+static unsigned long long hist_total(unsigned long long *hist)
+{
+	unsigned long long total = 0;
+	int i;
+
+	for (i = 0; i < SYSCALL_LAT_BUCKETS; i++)
+		total += hist[i];
+
+	return total;
+}
+
+/*
+ * the upper bound in ns of the bucket which the percentile falls.
+ */
+static unsigned long hist_percentile(unsigned long long *hist, int pct)
+{
+	unsigned long long total = hist_total(hist), sum = 0;
+	int i;
+
+	if (total == 0)
+		return 0;
+
+	for (i = 0; i < SYSCALL_LAT_BUCKETS; i++) {
+		sum += hist[i];
+		if (sum * 100 >= total * pct)
+			break;
+	}
+
+	return 1UL << (i < SYSCALL_LAT_BUCKETS ? i : SYSCALL_LAT_BUCKETS - 1);
+}
+
+static void print_stats(struct syscall_stat_header *hdr, int verbose)
+{
+	struct syscall_stat sum, *st;
+	int nr, cpu, i;
+
+	printf(" NR NAME               CALLS        P50(ns)  P99(ns)\n");
+
+	for (nr = 0; nr < hdr->nr_syscalls && nr < SYSCALL_STAT_MAX; nr++) {
+		memset(&sum, 0, sizeof(struct syscall_stat));
+		for (cpu = 0; cpu < hdr->nr_cpus; cpu++) {
+			st = &syscall_stat_table(hdr, cpu)[nr];
+			sum.calls += st->calls;
+			for (i = 0; i < SYSCALL_LAT_BUCKETS; i++)
+				sum.lat[i] += st->lat[i];
+		}
+
+		if (sum.calls == 0)
+			continue;
+
+		printf("%3d %-18s %-12llu %-8lu %-8lu\n", nr,
+				syscall_name[nr] ? syscall_name[nr] : "unknown",
+				sum.calls, hist_percentile(sum.lat, 50),
+				hist_percentile(sum.lat, 99));
+
+		if (verbose) {
+			printf("    lat   :");
+			for (i = 0; i < SYSCALL_LAT_BUCKETS; i++)
+				printf(" %llu", sum.lat[i]);
+			printf("\n");
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct syscall_stat_header *hdr;
+	void *addr;
+	int handle;
+
+	handle = sys_sysstat_handle();
+	if (handle <= 0) {
+		printf("can not get syscall stat handle %d\n", handle);
+		return -ENOENT;
+	}
+
+	if (kobject_mmap(handle, &addr, NULL)) {
+		printf("mmap syscall stat mem failed\n");
+		return -EFAULT;
+	}
+
+	hdr = addr;
+
+	if (argc == 1) {
+		if (!hdr->enabled)
+			printf("syscall stat is off, use \"sysstat on\" to start it\n");
+		print_stats(hdr, 0);
+	} else if (!strcmp(argv[1], "-l")) {
+		print_stats(hdr, 1);
+	} else if (!strcmp(argv[1], "on")) {
+		return sys_sysstat_ctl(PROTO_STAT_ON);
+	} else if (!strcmp(argv[1], "off")) {
+		return sys_sysstat_ctl(PROTO_STAT_OFF);
+	} else if (!strcmp(argv[1], "reset")) {
+		return sys_sysstat_ctl(PROTO_STAT_RESET);
+	} else {
+		printf("usage: sysstat [-l] | on | off | reset\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
@@ -19,6 +19,7 @@
 #include <minos/device.h>
 
 #include <lwext4/ext4_blkdev.h>
+#include <dma/dma_pool.h>
 
 #include "virtio.h"
 
@@ -51,7 +52,9 @@ struct virtio_blk {
 	virtio_regs *regs;
 	struct virtio_blk_config config;
 	struct virtqueue *virtq;
+	struct dma_pool *pool;
 	uint32_t intid;
+	uint32_t max_inflight;
 	uint64_t sector_cnt;
 };
 #define get_vblkdev(dev) container_of(dev, struct virtio_blk, blkdev)
@@ -85,6 +88,8 @@ static void virtio_blk_handle_used(struct virtio_blk *dev, uint32_t usedidx)
 
 	switch (req->status) {
 	case VIRTIO_BLK_S_OK:
+		if (req->type == VIRTIO_BLK_T_IN)
+			memcpy(req->blkreq.buf, req->data, VIRTIO_BLK_SECTOR_SIZE);
 		req->blkreq.status = BLKREQ_OK;
 		break;
 	case VIRTIO_BLK_S_IOERR:
@@ -168,8 +173,8 @@ static int virtio_blk_status(struct virtio_blk *blkdev)
 static struct blkreq *virtio_blk_alloc(struct virtio_blk *dev)
 {
 	struct virtio_blk_req *vblkreq;
-	
-	vblkreq = zalloc(sizeof(struct virtio_blk_req));
+
+	vblkreq = dma_pool_alloc(dev->pool);
 	if (!vblkreq)
 		return NULL;
 
@@ -179,12 +184,13 @@ static struct blkreq *virtio_blk_alloc(struct virtio_blk *dev)
 static void virtio_blk_free(struct virtio_blk *blk, struct blkreq *req)
 {
 	struct virtio_blk_req *vblkreq = get_vblkreq(req);
-	free(vblkreq);
+	dma_pool_free(blk->pool, vblkreq);
 }
 
 static int virtio_blk_submit(struct virtio_blk *blk, struct blkreq *req)
 {
 	struct virtio_blk_req *hdr = get_vblkreq(req);
+	unsigned long phys = dma_pool_phys(blk->pool, hdr);
 	uint32_t d1, d2, d3, datamode = 0;
 
 	if (req->type == BLKREQ_READ) {
@@ -192,20 +198,23 @@ static int virtio_blk_submit(struct virtio_blk *blk, struct blkreq *req)
 		datamode = VIRTQ_DESC_F_WRITE; /* mark page writeable */
 	} else {
 		hdr->type = VIRTIO_BLK_T_OUT;
+		memcpy(hdr->data, req->buf, VIRTIO_BLK_SECTOR_SIZE);
 	}
 	hdr->sector = req->blkidx;
 
-	d1 = virtq_alloc_desc(blk->virtq, hdr);
+	d1 = virtq_alloc_desc(blk->virtq, hdr, phys);
 	hdr->descriptor = d1;
 	blk->virtq->desc[d1].len = VIRTIO_BLK_REQ_HEADER_SIZE;
 	blk->virtq->desc[d1].flags = VIRTQ_DESC_F_NEXT;
 
-	d2 = virtq_alloc_desc(blk->virtq, req->buf);
+	d2 = virtq_alloc_desc(blk->virtq, hdr->data,
+			phys + offsetof(struct virtio_blk_req, data));
 	blk->virtq->desc[d2].len = VIRTIO_BLK_SECTOR_SIZE;
 	blk->virtq->desc[d2].flags = datamode | VIRTQ_DESC_F_NEXT;
 
 	d3 = virtq_alloc_desc(blk->virtq,
-	                      (void *)hdr + VIRTIO_BLK_REQ_HEADER_SIZE);
+	                      (void *)hdr + VIRTIO_BLK_REQ_HEADER_SIZE,
+			      phys + VIRTIO_BLK_REQ_HEADER_SIZE);
 	blk->virtq->desc[d3].len = VIRTIO_BLK_REQ_FOOTER_SIZE;
 	blk->virtq->desc[d3].flags = VIRTQ_DESC_F_WRITE;
 
@@ -287,7 +296,7 @@ int submit_blkreq_many(struct virtio_blk *vdev, struct list_head *breq_list)
 	return ret;
 }
 
-static int request_virtio_blkdev_sectors(struct virtio_blk *vdev, void *buf,
+static int __request_virtio_blkdev_sectors(struct virtio_blk *vdev, void *buf,
 		uint64_t start, uint32_t cnt, int op)
 {
 	LIST_HEAD(blkreq_list);
@@ -328,6 +337,30 @@ out:
 	return ret;
 }
 
+/*
+ * each request use one buffer of the dma pool and three
+ * descriptors, submit the sectors in batch.
+ */
+static int request_virtio_blkdev_sectors(struct virtio_blk *vdev, void *buf,
+		uint64_t start, uint32_t cnt, int op)
+{
+	uint32_t batch;
+	int ret;
+
+	while (cnt > 0) {
+		batch = (cnt > vdev->max_inflight) ? vdev->max_inflight : cnt;
+		ret = __request_virtio_blkdev_sectors(vdev, buf, start, batch, op);
+		if (ret)
+			return ret;
+
+		buf += batch * VIRTIO_BLK_SECTOR_SIZE;
+		start += batch;
+		cnt -= batch;
+	}
+
+	return 0;
+}
+
 static int virtio_ext4_iface_bread(struct ext4_blockdev *bdev, void *buf,
 		uint64_t blk_id, uint32_t blk_cnt)
 {
@@ -343,7 +376,7 @@ static int virtio_ext4_iface_bwrite(struct ext4_blockdev *bdev, const void *buf,
 	struct virtio_blk *vdev = bdev->bdif->p_user;
 
 	return request_virtio_blkdev_sectors(vdev, (void *)buf,
-			blk_id, blk_cnt, BLKREQ_READ);
+			blk_id, blk_cnt, BLKREQ_WRITE);
 }
 
 static int virtio_ext4_iface_open(struct ext4_blockdev *bdev)
@@ -410,6 +443,14 @@ int virtio_blk_init(virtio_regs *regs, uint32_t intid)
 	vdev->regs = regs;
 	vdev->virtq = virtq;
 	vdev->intid = intid;
+	vdev->max_inflight = virtq->len / 3;
+
+	vdev->pool = dma_pool_create(sizeof(struct virtio_blk_req),
+			vdev->max_inflight);
+	if (!vdev->pool) {
+		pr_err("virtio-blk create dma pool failed\n");
+		return -ENOMEM;
+	}
 
 	/* capacity is 64 bit, configuration reg read is not atomic */
 	do {
@@ -91,7 +91,12 @@ struct virtqueue *virtq_create(virtio_regs *regs, uint32_t len)
 	return virtq;
 }
 
-uint32_t virtq_alloc_desc(struct virtqueue *virtq, void *addr)
+/*
+ * the buffer must come from a dma pool, the caller pass the
+ * physical address of it, so no need to translate it here.
+ */
+uint32_t virtq_alloc_desc(struct virtqueue *virtq, void *addr,
+		unsigned long phys)
 {
 	uint32_t desc = virtq->free_desc;
 	uint32_t next = virtq->desc[desc].next;
@@ -99,12 +104,7 @@ uint32_t virtq_alloc_desc(struct virtqueue *virtq, void *addr)
 		pr_err("ran out of virtqueue descriptors\n");
 	virtq->free_desc = next;
 
-	virtq->desc[desc].addr = sys_mtrans((unsigned long)addr);
-	if (virtq->desc[desc].addr == -1) {
-		pr_err("translate VA to PA failed\n");
-		exit(-EFAULT);
-	}
-
+	virtq->desc[desc].addr = phys;
 	virtq->desc_virt[desc] = addr;
 	return desc;
 }
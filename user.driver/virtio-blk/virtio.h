@@ -170,6 +170,8 @@ struct blkreq {
 	struct list_head list;
 };
 
+#define VIRTIO_BLK_SECTOR_SIZE 512
+
 #define VIRTIO_BLK_REQ_HEADER_SIZE 16
 #define VIRTIO_BLK_REQ_FOOTER_SIZE 1
 struct virtio_blk_req {
@@ -185,10 +187,9 @@ struct virtio_blk_req {
 	uint8_t _pad[3];
 	uint32_t descriptor;
 	struct blkreq blkreq;
+	uint8_t data[VIRTIO_BLK_SECTOR_SIZE];	/* bounce buffer for the sector */
 } __attribute__((packed));
 
-#define VIRTIO_BLK_SECTOR_SIZE 512
-
 #define VIRTIO_BLK_S_OK     0
 #define VIRTIO_BLK_S_IOERR  1
 #define VIRTIO_BLK_S_UNSUPP 2
@@ -197,7 +198,8 @@ struct virtio_blk_req {
  * virtqueue routines
  */
 struct virtqueue *virtq_create(virtio_regs *regs, uint32_t len);
-uint32_t virtq_alloc_desc(struct virtqueue *virtq, void *addr);
+uint32_t virtq_alloc_desc(struct virtqueue *virtq, void *addr,
+		unsigned long phys);
 void virtq_free_desc(struct virtqueue *virtq, uint32_t desc);
 void virtq_add_to_device(volatile virtio_regs *regs, struct virtqueue *virtq,
                          uint32_t queue_sel);
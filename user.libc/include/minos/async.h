@@ -0,0 +1,46 @@
+#ifndef __LIBC_ASYNC_RING_H__
+#define __LIBC_ASYNC_RING_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <minos/kobject_uapi.h>
+
+/*
+ * user view of an async kobject, the entries are filled to the
+ * submission queue and submitted to the kernel in one call, the
+ * results are reaped from the completion queue.
+ */
+struct async_desc {
+	int handle;
+	struct async_ring *ring;
+	struct async_sqe *sqes;
+	struct async_cqe *cqes;
+	uint32_t sq_mask;
+	uint32_t cq_mask;
+	size_t map_size;
+};
+
+int async_setup(struct async_desc *ad, int entries);
+
+void async_exit(struct async_desc *ad);
+
+struct async_sqe *async_get_sqe(struct async_desc *ad);
+
+long async_submit(struct async_desc *ad);
+
+struct async_cqe *async_peek_cqe(struct async_desc *ad);
+
+long async_wait_cqe(struct async_desc *ad, struct async_cqe **cqe,
+		uint32_t timeout);
+
+void async_cqe_seen(struct async_desc *ad);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -17,6 +17,7 @@ extern "C" {
 
 #define KR_RW (KR_R | KR_W)
 #define KR_RWX (KR_R | KR_W | KR_X)
+#define KR_RX (KR_R | KR_X)
 #define KR_RWC (KR_R | KR_W | KR_C)
 #define KR_RWM (KR_R | KR_W | KR_M)
 #define KR_RWCM (KR_R | KR_W | KR_C | KR_M)
@@ -47,13 +48,29 @@ static inline long kobject_read_simple(int handle, void *data,
 			(void *)0, 0, (size_t *)0, timeout);
 }
 
+long kobject_readv(int handle, struct kobject_recv_vec *vec,
+		int nr, uint32_t timeout);
+
 long kobject_write(int handle, void *data, size_t data_size,
 		void *extra, size_t extra_size, uint32_t timeout);
 
+long kobject_write_grant(int handle, void *data, size_t data_size,
+		struct kobject_grant *grant, int nr_grant, uint32_t timeout);
+
 int kobject_reply(int handle, long token, long err_code, int fd, int right);
 
+long kobject_write_fast(int handle, unsigned long *msg,
+		unsigned long *reply, uint32_t timeout);
+
+long kobject_read_fast(int handle, unsigned long *msg, uint32_t timeout);
+
+int kobject_reply_fast(int handle, long token, long err_code,
+		unsigned long *reply);
+
 int kobject_reply_errcode(int handle, long token, long err_code);
 
+long kobject_replyv(int handle, struct kobject_reply_vec *vec, int nr);
+
 int kobject_mmap(int handle, void *addr, size_t *msize);
 
 int kobject_munmap(int handle);
@@ -64,6 +81,10 @@ int grant(int proc, int handle, int right);
 
 int kobject_create_endpoint(size_t shmem_size);
 
+int kobject_create_socket(size_t ring_size);
+
+int kobject_create_async(int entries);
+
 int kobject_create_port(void);
 
 int kobject_create_notify(void);
@@ -3,9 +3,15 @@
 
 #include <inttypes.h>
 #include <minos/procinfo_uapi.h>
+#include <minos/ipcstat_uapi.h>
+#include <minos/sysstat_uapi.h>
 
 int sys_proccnt(void);
 int sys_procinfo_handle(void);
 int sys_taskstat_handle(void);
+int sys_ipcstat_handle(void);
+int sys_sysstat_handle(void);
+int sys_ipcstat_ctl(int op);
+int sys_sysstat_ctl(int op);
 
 #endif
@@ -16,6 +16,10 @@ enum {
 	PROTO_PROCINFO,
 	PROTO_TASKSTAT,
 	PROTO_WAITPID,
+	PROTO_PAGE_IN,
+	PROTO_MADVISE,
+	PROTO_IPCSTAT,
+	PROTO_SYSSTAT,
 	PROTO_PANGU_END,
 };
 
@@ -31,6 +35,10 @@ enum {
 	PROTO_PROCINFO_ID,
 	PROTO_TASKSTAT_ID,
 	PROTO_WAITPID_ID,
+	PROTO_PAGE_IN_ID,
+	PROTO_MADVISE_ID,
+	PROTO_IPCSTAT_ID,
+	PROTO_SYSSTAT_ID,
 	PROTO_PROC_ID_MAX,
 };
 
@@ -69,6 +77,15 @@ struct proto_elf_info {
 	unsigned long entry;
 	unsigned long elf_base;
 	unsigned long elf_size;
+	unsigned long ro_size;
+	unsigned long file_end;
+	uint64_t file_size;
+	uint64_t file_sum;
+};
+
+struct proto_page_in {
+	int ret_code;
+	uint64_t token;
 };
 
 struct proto_mprotect {
@@ -77,6 +94,12 @@ struct proto_mprotect {
 	int prot;
 };
 
+struct proto_madvise {
+	void *addr;
+	size_t len;
+	int advice;
+};
+
 struct proto_brk {
 	void *addr;
 };
@@ -144,6 +167,19 @@ struct proto_devinfo {
 	int index;
 };
 
+/*
+ * PROTO_IPCSTAT and PROTO_SYSSTAT, the stat memory is mapped
+ * read only, the root service changes it for the caller.
+ */
+#define PROTO_STAT_HANDLE	0
+#define PROTO_STAT_ON		1
+#define PROTO_STAT_OFF		2
+#define PROTO_STAT_RESET	3
+
+struct proto_stat {
+	int op;
+};
+
 struct proto_load_driver {
 	char path[FILENAME_MAX];
 };
@@ -156,17 +192,20 @@ struct proto {
 		struct proto_mmap mmap;
 		struct proto_mprotect mprotect;
 		struct proto_munmap munmap;
+		struct proto_madvise madvise;
 		struct proto_open open;
 		struct proto_open openat;
 		struct proto_read read;
 		struct proto_write write;
 		struct proto_lseek lseek;
 		struct proto_elf_info elf_info;
+		struct proto_page_in page_in;
 		struct proto_brk brk;
 		struct proto_access access;
 		struct proto_waitpid waitpid;
 		struct proto_register_service register_service;
 		struct proto_devinfo devinfo;
+		struct proto_stat stat;
 	};
 };
 
@@ -0,0 +1,39 @@
+#ifndef __LIBC_SOCKET_RING_H__
+#define __LIBC_SOCKET_RING_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <minos/kobject_uapi.h>
+
+/*
+ * user view of a socket kobject which has been mapped, one side
+ * only write and the other side only read, the data is copied
+ * to the ring directly without kernel.
+ */
+struct socket_desc {
+	int handle;
+	struct socket_ring *ring;
+	unsigned char *data;
+	size_t size;
+	size_t map_size;
+};
+
+int socket_attach(struct socket_desc *sd, int handle);
+
+void socket_detach(struct socket_desc *sd);
+
+ssize_t socket_write(struct socket_desc *sd, const void *buf,
+		size_t size, uint32_t timeout);
+
+ssize_t socket_read(struct socket_desc *sd, void *buf,
+		size_t size, uint32_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __MINOS_SYSSTAT_UAPI_H__
+#define __MINOS_SYSSTAT_UAPI_H__
+
+/*
+ * the syscall statistics memory is shared to the process which
+ * get its handle from the root service. the header is followed by
+ * one table for each cpu, each table has one entry for each syscall.
+ */
+#define SYSCALL_STAT_MAX	64
+#define SYSCALL_LAT_BUCKETS	32
+
+/*
+ * the statistics is off by default, the user tool asks the root
+ * service to set enabled to start it, the memory is read only
+ * for the others.
+ */
+struct syscall_stat_header {
+	unsigned int enabled;
+	unsigned int nr_cpus;
+	unsigned int nr_syscalls;
+	unsigned int lat_buckets;
+};
+
+/*
+ * bucket 0 counts the latency less than 1ns, bucket n counts
+ * [2^(n-1), 2^n) ns, the last bucket counts all the others.
+ */
+struct syscall_stat {
+	unsigned long long calls;
+	unsigned long long lat[SYSCALL_LAT_BUCKETS];
+};
+
+#define SYSCALL_STAT_OFFSET	64
+#define SYSCALL_STAT_CPU_SIZE	(sizeof(struct syscall_stat) * SYSCALL_STAT_MAX)
+
+#define syscall_stat_table(base, cpu)	\
+	((struct syscall_stat *)((void *)(base) + \
+	 SYSCALL_STAT_OFFSET + (cpu) * SYSCALL_STAT_CPU_SIZE))
+
+#endif
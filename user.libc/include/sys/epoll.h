@@ -25,6 +25,7 @@ enum EPOLL_EVENTS { __EPOLL_DUMMY };
 #define EPOLLWCLOSE 0x020
 #define EPOLLKERNEL 0x040
 
+#define EPOLLLT (1U<<27)
 #define EPOLLEXCLUSIVE (1U<<28)
 #define EPOLLWAKEUP (1U<<29)
 #define EPOLLONESHOT (1U<<30)
@@ -65,6 +66,14 @@ int epoll_ctl(int, int, int, struct epoll_event *);
 int epoll_wait(int, struct epoll_event *, int, int);
 int epoll_pwait(int, struct epoll_event *, int, int, const sigset_t *);
 
+struct timespec;
+int epoll_pwait2(int, struct epoll_event *, int, const struct timespec *, const sigset_t *);
+
+/*
+ * wait until the CLOCK_MONOTONIC time abstime, minos only.
+ */
+int epoll_wait_until(int, struct epoll_event *, int, const struct timespec *);
+
 
 #ifdef __cplusplus
 }
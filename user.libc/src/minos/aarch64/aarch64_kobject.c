@@ -1,5 +1,7 @@
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <minos/kobject_uapi.h>
 
 #include "stdio_impl.h"
 #include "aarch64_svc.h"
@@ -40,6 +42,16 @@ long kobject_read(int handle, void *data, size_t data_size,
 	return ret;
 }
 
+/*
+ * >  0 : the number of the received messages.
+ * <= 0 : failed
+ */
+long kobject_readv(int handle, struct kobject_recv_vec *vec,
+		int nr, uint32_t timeout)
+{
+	return syscall(SYS_kobject_recvv, handle, vec, nr, timeout);
+}
+
 long kobject_write(int handle, void *data, size_t data_size,
 		void *extra, size_t extra_size, uint32_t timeout)
 {
@@ -48,11 +60,69 @@ long kobject_write(int handle, void *data, size_t data_size,
 
 }
 
+long kobject_write_grant(int handle, void *data, size_t data_size,
+		struct kobject_grant *grant, int nr_grant, uint32_t timeout)
+{
+	return syscall(SYS_kobject_send_grant, handle, data, data_size,
+			grant, nr_grant, timeout);
+}
+
+/*
+ * fast path ipc, the message and the reply are passed by the
+ * registers, msg has KOBJ_FAST_WORDS words and reply has
+ * KOBJ_FAST_REPLY_WORDS words.
+ */
+long kobject_write_fast(int handle, unsigned long *msg,
+		unsigned long *reply, uint32_t timeout)
+{
+	unsigned long words[KOBJ_FAST_WORDS];
+	long ret;
+
+	memcpy(words, msg, sizeof(words));
+	ret = aarch64_svc_fast((unsigned long)handle, (unsigned long)timeout,
+			words, SYS_kobject_send_fast);
+	if (reply)
+		memcpy(reply, words, sizeof(unsigned long) * KOBJ_FAST_REPLY_WORDS);
+
+	return ret;
+}
+
+long kobject_read_fast(int handle, unsigned long *msg, uint32_t timeout)
+{
+	unsigned long words[KOBJ_FAST_WORDS] = { 0 };
+	long ret;
+
+	ret = aarch64_svc_fast((unsigned long)handle, (unsigned long)timeout,
+			words, SYS_kobject_recv_fast);
+	if (msg)
+		memcpy(msg, words, sizeof(words));
+
+	return ret;
+}
+
+int kobject_reply_fast(int handle, long token, long err_code,
+		unsigned long *reply)
+{
+	unsigned long words[KOBJ_FAST_WORDS] = { 0 };
+
+	words[0] = (unsigned long)err_code;
+	if (reply)
+		memcpy(&words[1], reply, sizeof(unsigned long) * KOBJ_FAST_REPLY_WORDS);
+
+	return (int)aarch64_svc_fast((unsigned long)handle, (unsigned long)token,
+			words, SYS_kobject_reply_fast);
+}
+
 int kobject_reply(int handle, long token, long err_code, int fd, int right)
 {
 	return syscall(SYS_kobject_reply, handle, token, err_code, fd, right);
 }
 
+long kobject_replyv(int handle, struct kobject_reply_vec *vec, int nr)
+{
+	return syscall(SYS_kobject_replyv, handle, vec, nr);
+}
+
 int kobject_reply_errcode(int handle, long token, long err_code)
 {
 	return kobject_reply(handle, token, err_code, -1, 0);
@@ -13,4 +13,7 @@ void aarch64_svc_call(unsigned long a0, unsigned long a1, unsigned long a2,
 		unsigned long a6, unsigned long svc_num_a7,
 		struct aarch64_svc_res *res);
 
+long aarch64_svc_fast(unsigned long a0, unsigned long a7,
+		unsigned long *words, unsigned long svc_num);
+
 #endif
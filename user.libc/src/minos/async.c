@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <minos/kobject.h>
+#include <minos/barrier.h>
+#include <minos/async.h>
+
+int async_setup(struct async_desc *ad, int entries)
+{
+	struct async_ring *ring;
+	void *addr;
+	size_t size;
+	int handle, ret;
+
+	handle = kobject_create_async(entries);
+	if (handle < 0)
+		return handle;
+
+	ret = kobject_mmap(handle, &addr, &size);
+	if (ret) {
+		kobject_close(handle);
+		return ret;
+	}
+
+	ring = (struct async_ring *)addr;
+	ad->handle = handle;
+	ad->ring = ring;
+	ad->sqes = (struct async_sqe *)((unsigned char *)addr + ring->sq_off);
+	ad->cqes = (struct async_cqe *)((unsigned char *)addr + ring->cq_off);
+	ad->sq_mask = ring->sq_entries - 1;
+	ad->cq_mask = ring->cq_entries - 1;
+	ad->map_size = size;
+
+	return 0;
+}
+
+void async_exit(struct async_desc *ad)
+{
+	kobject_munmap(ad->handle);
+	kobject_close(ad->handle);
+	ad->ring = NULL;
+}
+
+/*
+ * return a free submission entry, NULL if the queue is full,
+ * the entry is visible to the kernel after async_submit.
+ */
+struct async_sqe *async_get_sqe(struct async_desc *ad)
+{
+	struct async_ring *ring = ad->ring;
+	uint32_t tail = ring->sq_tail;
+	struct async_sqe *sqe;
+
+	if ((uint32_t)(tail - ring->sq_head) >= ring->sq_entries)
+		return NULL;
+
+	sqe = &ad->sqes[tail & ad->sq_mask];
+	memset(sqe, 0, sizeof(struct async_sqe));
+	ring->sq_tail = tail + 1;
+
+	return sqe;
+}
+
+long async_submit(struct async_desc *ad)
+{
+	struct async_ring *ring = ad->ring;
+
+	smp_wmb();
+
+	return kobject_ctl(ad->handle, KOBJ_ASYNC_ENTER,
+			ring->sq_tail - ring->sq_head);
+}
+
+struct async_cqe *async_peek_cqe(struct async_desc *ad)
+{
+	struct async_ring *ring = ad->ring;
+	uint32_t head = ring->cq_head;
+
+	if (head == ring->cq_tail)
+		return NULL;
+
+	smp_rmb();
+
+	return &ad->cqes[head & ad->cq_mask];
+}
+
+long async_wait_cqe(struct async_desc *ad, struct async_cqe **cqe,
+		uint32_t timeout)
+{
+	long ret;
+
+	*cqe = async_peek_cqe(ad);
+	if (*cqe)
+		return 0;
+
+	ret = kobject_read(ad->handle, NULL, 0, NULL, NULL, 0, NULL, timeout);
+	if (ret < 0)
+		return ret;
+
+	*cqe = async_peek_cqe(ad);
+
+	return *cqe ? 0 : -EAGAIN;
+}
+
+void async_cqe_seen(struct async_desc *ad)
+{
+	smp_mb();
+	ad->ring->cq_head++;
+}
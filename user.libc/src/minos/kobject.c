@@ -20,6 +20,11 @@ int kobject_create_socket(size_t shmem_size)
 	return kobject_create(KOBJ_TYPE_SOCKET, shmem_size);
 }
 
+int kobject_create_async(int entries)
+{
+	return kobject_create(KOBJ_TYPE_ASYNC, entries);
+}
+
 int kobject_create_port(void)
 {
 	return kobject_create(KOBJ_TYPE_PORT, 0);
@@ -4,38 +4,78 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <errno.h>
+#include <time.h>
 
 #include "stdio_impl.h"
 #include <sys/epoll.h>
 #include <minos/kobject.h>
 
-int epoll_wait(int epfd, struct epoll_event *events,
-                      int maxevents, int timeout)
+static int __epoll_wait(int epfd, struct epoll_event *events,
+		int maxevents, long timeout, int flags)
 {
-	size_t e, d;
-	ssize_t size;
-	int ret;
+	struct poll_wait_arg arg;
+	long ret;
 
-	/*
-	 * currently only support EPOLLIN event
-	 */
 	if ((events == NULL) || (maxevents <= 0))
 		return -EINVAL;
 
-	size = maxevents * sizeof(struct epoll_event);
-	ret = kobject_read(epfd, events, size, &d, NULL, 0, &e, timeout);
-	if (ret < 0)
-		return ret;
-	else if (d == 0)
-		return -EAGAIN;
+	arg.events = events;
+	arg.max_event = maxevents;
+	arg.flags = flags;
+	arg.timeout = timeout;
+
+	/*
+	 * the kernel copies the events out in chunks, there is no
+	 * limit of maxevents. timeout return 0 events like linux.
+	 */
+	ret = kobject_ctl(epfd, KOBJ_POLL_OP_WAIT, (unsigned long)&arg);
+	if ((ret == -ETIMEDOUT) || (ret == -EAGAIN))
+		return 0;
 
-	return (d / sizeof(struct epoll_event));
+	return ret;
+}
+
+static inline long timespec_to_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000L + ts->tv_nsec;
+}
+
+int epoll_wait(int epfd, struct epoll_event *events,
+                      int maxevents, int timeout)
+{
+	long to = (timeout < 0) ? -1 : timeout * 1000000L;
+
+	return __epoll_wait(epfd, events, maxevents, to, 0);
 }
 
 int epoll_pwait(int epfd, struct epoll_event *events, int maxevents,
 		int timeout, const sigset_t *sig)
 {
-	return -ENOSYS;
+	if (sig)
+		return -ENOSYS;
+
+	return epoll_wait(epfd, events, maxevents, timeout);
+}
+
+int epoll_pwait2(int epfd, struct epoll_event *events, int maxevents,
+		const struct timespec *timeout, const sigset_t *sig)
+{
+	if (sig)
+		return -ENOSYS;
+
+	return __epoll_wait(epfd, events, maxevents,
+			timeout ? timespec_to_ns(timeout) : -1, 0);
+}
+
+int epoll_wait_until(int epfd, struct epoll_event *events, int maxevents,
+		const struct timespec *abstime)
+{
+	if (!abstime)
+		return __epoll_wait(epfd, events, maxevents, -1, 0);
+
+	return __epoll_wait(epfd, events, maxevents,
+			timespec_to_ns(abstime), POLL_WAIT_ABSTIME);
 }
 
 int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
@@ -36,3 +36,41 @@ int sys_taskstat_handle(void)
 
 	return sys_send_proto(0, &proto);
 }
+
+int sys_ipcstat_handle(void)
+{
+	struct proto proto = {
+		.proto_id = PROTO_IPCSTAT,
+	};
+
+	return sys_send_proto(0, &proto);
+}
+
+int sys_sysstat_handle(void)
+{
+	struct proto proto = {
+		.proto_id = PROTO_SYSSTAT,
+	};
+
+	return sys_send_proto(0, &proto);
+}
+
+int sys_ipcstat_ctl(int op)
+{
+	struct proto proto = {
+		.proto_id = PROTO_IPCSTAT,
+		.stat.op = op,
+	};
+
+	return sys_send_proto(0, &proto);
+}
+
+int sys_sysstat_ctl(int op)
+{
+	struct proto proto = {
+		.proto_id = PROTO_SYSSTAT,
+		.stat.op = op,
+	};
+
+	return sys_send_proto(0, &proto);
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <minos/kobject.h>
+#include <minos/barrier.h>
+#include <minos/socket.h>
+
+int socket_attach(struct socket_desc *sd, int handle)
+{
+	void *addr;
+	size_t size;
+	int ret;
+
+	ret = kobject_mmap(handle, &addr, &size);
+	if (ret)
+		return ret;
+
+	sd->handle = handle;
+	sd->ring = (struct socket_ring *)addr;
+	sd->data = (unsigned char *)addr + SOCKET_RING_DATA_OFFSET;
+	sd->size = sd->ring->size;
+	sd->map_size = size;
+
+	if ((sd->size + SOCKET_RING_DATA_OFFSET) > size) {
+		kobject_munmap(handle);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+void socket_detach(struct socket_desc *sd)
+{
+	kobject_munmap(sd->handle);
+	sd->ring = NULL;
+	sd->data = NULL;
+}
+
+/*
+ * the kernel only involved when the ring is full, or the reader
+ * is waitting for the data, or the ring was empty before writing.
+ */
+ssize_t socket_write(struct socket_desc *sd, const void *buf,
+		size_t size, uint32_t timeout)
+{
+	struct socket_ring *ring = sd->ring;
+	unsigned long head, tail;
+	size_t used, copy, off, first;
+	long ret;
+
+	head = ring->head;
+	tail = ring->tail;
+	smp_mb();
+
+	used = head - tail;
+	if (used == sd->size) {
+		/*
+		 * write nothing, just wait for the space.
+		 */
+		ret = kobject_write(sd->handle, NULL, 0, NULL, 0, timeout);
+		if (ret < 0)
+			return ret;
+
+		tail = ring->tail;
+		smp_mb();
+		used = head - tail;
+	}
+
+	copy = size < (sd->size - used) ? size : (sd->size - used);
+	off = head & (sd->size - 1);
+	first = copy < (sd->size - off) ? copy : (sd->size - off);
+
+	memcpy(sd->data + off, buf, first);
+	if (copy > first)
+		memcpy(sd->data, (const unsigned char *)buf + first, copy - first);
+
+	smp_wmb();
+	ring->head = head + copy;
+	smp_mb();
+
+	if (ring->rwait || (used == 0))
+		kobject_ctl(sd->handle, KOBJ_SOCKET_NOTIFY, SOCKET_NOTIFY_READER);
+
+	return copy;
+}
+
+ssize_t socket_read(struct socket_desc *sd, void *buf,
+		size_t size, uint32_t timeout)
+{
+	struct socket_ring *ring = sd->ring;
+	unsigned long head, tail;
+	size_t used, copy, off, first;
+	long ret;
+
+	head = ring->head;
+	tail = ring->tail;
+	smp_mb();
+
+	used = head - tail;
+	if (used == 0) {
+		ret = kobject_read(sd->handle, NULL, 0, NULL, NULL, 0, NULL, timeout);
+		if (ret < 0)
+			return ret;
+
+		head = ring->head;
+		smp_rmb();
+		used = head - tail;
+	}
+
+	if (used > sd->size)
+		return -EIO;
+
+	copy = size < used ? size : used;
+	off = tail & (sd->size - 1);
+	first = copy < (sd->size - off) ? copy : (sd->size - off);
+
+	memcpy(buf, sd->data + off, first);
+	if (copy > first)
+		memcpy((unsigned char *)buf + first, sd->data, copy - first);
+
+	smp_mb();
+	ring->tail = tail + copy;
+	smp_mb();
+
+	if (ring->wwait || (used == sd->size))
+		kobject_ctl(sd->handle, KOBJ_SOCKET_NOTIFY, SOCKET_NOTIFY_WRITER);
+
+	return copy;
+}
@@ -1,12 +1,45 @@
 #include <sys/mman.h>
+#include <errno.h>
 #include "syscall.h"
 
+#include <minos/proto.h>
+#include <minos/kobject.h>
+
+#include "pthread_impl.h"
+
 int __madvise(void *addr, size_t len, int advice)
 {
-	/*
-	 * TBD.
-	 */
-	return 0;
+	struct proto proto;
+	size_t start, end;
+
+	switch (advice) {
+	case MADV_DONTNEED:
+	case MADV_FREE:
+	case MADV_WILLNEED:
+		break;
+	case MADV_NORMAL:
+	case MADV_RANDOM:
+	case MADV_SEQUENTIAL:
+		return 0;
+	default:
+		return __syscall_ret(-EINVAL);
+	}
+
+	start = (size_t)addr;
+	if (start & (PAGE_SIZE - 1))
+		return __syscall_ret(-EINVAL);
+
+	end = (start + len + PAGE_SIZE - 1) & -PAGE_SIZE;
+	if (end == start)
+		return 0;
+
+	proto.proto_id = PROTO_MADVISE;
+	proto.madvise.addr = (void *)start;
+	proto.madvise.len = end - start;
+	proto.madvise.advice = advice;
+
+	return __syscall_ret(kobject_write(self_handle(), &proto,
+				sizeof(struct proto), NULL, 0, -1));
 }
 
 weak_alias(__madvise, madvise);
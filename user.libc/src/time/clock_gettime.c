@@ -1,11 +1,61 @@
 #include <time.h>
 #include <errno.h>
 #include <stdint.h>
+#include <minos/vdso_uapi.h>
 #include "syscall.h"
 #include "atomic.h"
 
+/*
+ * read the time from the time data page published by the kernel,
+ * fall back to the syscall if the counter can not be read in EL0.
+ */
+static int vdso_clock_gettime(clockid_t clk, struct timespec *ts)
+{
+	const volatile struct vdso_time_data *vt =
+		(const volatile struct vdso_time_data *)VDSO_TIME_BASE;
+	uint64_t freq, ticks, sec, rem, ns;
+	int64_t offset;
+	uint32_t seq;
+
+	if ((clk != CLOCK_MONOTONIC) && (clk != CLOCK_REALTIME))
+		return -ENOSYS;
+
+	do {
+		seq = vt->seq;
+		a_barrier();
+		if (!(vt->flags & VDSO_TIME_F_COUNTER))
+			return -ENOSYS;
+
+		freq = vt->freq;
+		offset = vt->realtime_offset;
+		__asm__ __volatile__ ("isb; mrs %0, cntpct_el0" : "=r"(ticks) :: "memory");
+		ticks -= vt->boot_tick;
+		a_barrier();
+	} while ((seq & 1) || (seq != vt->seq));
+
+	if (freq == 0)
+		return -ENOSYS;
+
+	/*
+	 * same result as muldiv64 in the kernel without overflow.
+	 */
+	sec = ticks / freq;
+	rem = ticks % freq;
+	ns = sec * 1000000000ULL + rem * 1000000000ULL / freq;
+	if (clk == CLOCK_REALTIME)
+		ns += offset;
+
+	ts->tv_sec = ns / 1000000000ULL;
+	ts->tv_nsec = ns % 1000000000ULL;
+
+	return 0;
+}
+
 int __clock_gettime(clockid_t clk, struct timespec *ts)
 {
+	if (vdso_clock_gettime(clk, ts) == 0)
+		return 0;
+
 	return __syscall_ret(__syscall(SYS_clock_gettime, clk, ts));
 }
 
@@ -0,0 +1,100 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ *
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <minos/kobject.h>
+#include <minos/device.h>
+#include <minos/types.h>
+
+#include <dma/dma_pool.h>
+
+#define DMA_POOL_ALIGN	64
+
+struct dma_pool *dma_pool_create(size_t block_size, int nr_blocks)
+{
+	struct dma_pool *pool;
+	void *base = NULL;
+	unsigned long addr;
+	long pbase;
+	int i;
+
+	if ((block_size == 0) || (nr_blocks <= 0))
+		return NULL;
+
+	pool = zalloc(sizeof(struct dma_pool));
+	if (!pool)
+		return NULL;
+
+	/*
+	 * keep each buffer in its own cache line, the device
+	 * may write to it while the cpu accessing another one.
+	 */
+	pool->block_size = BALIGN(block_size, DMA_POOL_ALIGN);
+	pool->size = BALIGN(pool->block_size * nr_blocks, PAGE_SIZE);
+	pool->nr_blocks = nr_blocks;
+
+	pool->pma_handle = request_consequent_pma(pool->size, KR_RW);
+	if (pool->pma_handle <= 0)
+		goto err_free_pool;
+
+	if (kobject_mmap(pool->pma_handle, &base, NULL))
+		goto err_close_pma;
+
+	pbase = kobject_ctl(pool->pma_handle, KOBJ_PMA_GET_PADDR, 0);
+	if (pbase <= 0)
+		goto err_unmap_pma;
+
+	pool->vbase = (unsigned long)base;
+	pool->pbase = (unsigned long)pbase;
+
+	for (i = nr_blocks - 1; i >= 0; i--) {
+		addr = pool->vbase + i * pool->block_size;
+		*(void **)addr = pool->free_list;
+		pool->free_list = (void *)addr;
+	}
+	pool->nr_free = nr_blocks;
+
+	return pool;
+
+err_unmap_pma:
+	kobject_munmap(pool->pma_handle);
+err_close_pma:
+	kobject_close(pool->pma_handle);
+err_free_pool:
+	free(pool);
+	return NULL;
+}
+
+void dma_pool_destroy(struct dma_pool *pool)
+{
+	kobject_munmap(pool->pma_handle);
+	kobject_close(pool->pma_handle);
+	free(pool);
+}
+
+void *dma_pool_alloc(struct dma_pool *pool)
+{
+	void *vaddr = pool->free_list;
+
+	if (!vaddr)
+		return NULL;
+
+	pool->free_list = *(void **)vaddr;
+	pool->nr_free--;
+	memset(vaddr, 0, pool->block_size);
+
+	return vaddr;
+}
+
+void dma_pool_free(struct dma_pool *pool, void *vaddr)
+{
+	*(void **)vaddr = pool->free_list;
+	pool->free_list = vaddr;
+	pool->nr_free++;
+}
@@ -0,0 +1,36 @@
+#ifndef __DMA_POOL_H__
+#define __DMA_POOL_H__
+
+#include <sys/types.h>
+
+/*
+ * a pool of fixed size buffers in a physically consequent
+ * pma, the physical address of the pool is got once when
+ * it created, so the dma address of a buffer can be got
+ * without translating it by the kernel.
+ */
+struct dma_pool {
+	int pma_handle;
+	int nr_blocks;
+	int nr_free;
+	unsigned long vbase;
+	unsigned long pbase;
+	size_t size;
+	size_t block_size;
+	void *free_list;
+};
+
+struct dma_pool *dma_pool_create(size_t block_size, int nr_blocks);
+
+void dma_pool_destroy(struct dma_pool *pool);
+
+void *dma_pool_alloc(struct dma_pool *pool);
+
+void dma_pool_free(struct dma_pool *pool, void *vaddr);
+
+static inline unsigned long dma_pool_phys(struct dma_pool *pool, void *vaddr)
+{
+	return pool->pbase + ((unsigned long)vaddr - pool->vbase);
+}
+
+#endif
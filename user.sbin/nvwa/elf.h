@@ -614,8 +614,20 @@ struct elf_ctx {
 	Elf_Addr memsz;
 	Elf_Addr align;
 	Elf_Ehdr ehdr;
+	Elf_Phdr *phdr;
 	Elf_Off  dynoff;
 	Elf_Addr dynsize;
+
+	/*
+	 * the read only segments which can be shared by all
+	 * the process loaded from the same file. ro_size is 0
+	 * if the image can not be split.
+	 */
+	Elf_Addr ro_size;
+	Elf_Addr file_end;
+	uint64_t file_size;
+	uint64_t hdr_sum;	/* elf header and load program headers */
+	uint64_t file_sum;	/* hdr_sum and the load segments */
 };
 
 enum {
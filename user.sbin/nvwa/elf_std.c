@@ -27,55 +27,258 @@ static int elf_file_read(FILE *file, void *buf, size_t size, off_t offset)
 	return 0;
 }
 
-static int elf_findphdr(FILE *file, struct elf_ctx *ctx,
-		Elf_Phdr *phdr, uint32_t type, unsigned *i)
+#define ELF_SUM_INIT	0xcbf29ce484222325UL
+#define ELF_SUM_PRIME	0x100000001b3UL
+
+/*
+ * fnv-1a hash of the elf header, the program headers and the
+ * content of the load segments, used together with the file
+ * size as the identity of the image. the file server has no
+ * inode or generation, so the content is the only thing which
+ * tells a rebuilt binary from the old one.
+ */
+static uint64_t elf_sum(uint64_t sum, const void *buf, size_t size)
 {
-	int rv = EL_OK;
+	const unsigned char *p = buf;
 
-	for (; *i < ctx->ehdr.e_phnum; (*i)++) {
-		rv = elf_file_read(file, phdr, sizeof(Elf_Phdr), EL_PHOFF(ctx, *i));
+	while (size--) {
+		sum ^= *p++;
+		sum *= ELF_SUM_PRIME;
+	}
+
+	return sum;
+}
+
+/*
+ * each read is one request to the file server, read the
+ * segments with big chunks.
+ */
+#define ELF_SUM_READ_SIZE	(256 * 1024)
+
+static int elf_sum_segment(struct elf_ctx *ctx, FILE *file,
+		Elf_Phdr *ph, void *buf)
+{
+	Elf_Off off = ph->p_offset;
+	size_t left = ph->p_filesz, size;
+	int rv;
+
+	if (((ctx->file_size != 0) && (off + left > ctx->file_size)) ||
+			(off + left < off))
+		return EL_NOTELF;
+
+	while (left > 0) {
+		size = left > ELF_SUM_READ_SIZE ? ELF_SUM_READ_SIZE : left;
+		rv = elf_file_read(file, buf, size, off);
 		if (rv)
 			return rv;
 
-		if (phdr->p_type == type)
-			return rv;
+		ctx->file_sum = elf_sum(ctx->file_sum, buf, size);
+		off += size;
+		left -= size;
 	}
 
-	*i = -1;
+	return 0;
+}
+
+static uint64_t elf_file_size(FILE *file)
+{
+	long size;
+
+	if (fseek(file, 0, SEEK_END) < 0)
+		return 0;
+
+	size = ftell(file);
+
+	return size < 0 ? 0 : size;
+}
+
+/*
+ * the elf header and the program header table are at the
+ * begin of the file in most case, read them together.
+ */
+#define ELF_HDR_READ_SIZE	4096
+
+static int elf_read_headers(struct elf_ctx *ctx, FILE *file)
+{
+	size_t phsize, size;
+	Elf_Off phoff;
+	void *buf;
+	int rv;
+
+	buf = malloc(ELF_HDR_READ_SIZE);
+	if (!buf)
+		return -ENOMEM;
+
+	size = ELF_HDR_READ_SIZE;
+	if ((ctx->file_size != 0) && (ctx->file_size < size))
+		size = ctx->file_size;
+
+	if (size < sizeof(Elf_Ehdr)) {
+		rv = EL_NOTELF;
+		goto out;
+	}
+
+	rv = elf_file_read(file, buf, size, 0);
+	if (rv)
+		goto out;
+
+	memcpy(&ctx->ehdr, buf, sizeof(Elf_Ehdr));
+	if (!IS_ELF(ctx->ehdr)) {
+		rv = EL_NOTELF;
+		goto out;
+	}
+
+	if (ctx->ehdr.e_phentsize != sizeof(Elf_Phdr)) {
+		rv = EL_NOTELF;
+		goto out;
+	}
+
+	phoff = ctx->ehdr.e_phoff;
+	phsize = ctx->ehdr.e_phnum * sizeof(Elf_Phdr);
+	if (phsize == 0)
+		goto out;
+
+	ctx->phdr = malloc(phsize);
+	if (!ctx->phdr) {
+		rv = -ENOMEM;
+		goto out;
+	}
+
+	if (phoff + phsize <= size)
+		memcpy(ctx->phdr, buf + phoff, phsize);
+	else
+		rv = elf_file_read(file, ctx->phdr, phsize, phoff);
+out:
+	free(buf);
 	return rv;
 }
 
-int elf_init(struct elf_ctx *ctx, FILE *file)
+static int elf_findphdr(struct elf_ctx *ctx,
+		Elf_Phdr **phdr, uint32_t type, unsigned *i)
 {
-	Elf_Phdr ph;
-	int rv = EL_OK;
+	for (; *i < ctx->ehdr.e_phnum; (*i)++) {
+		if (ctx->phdr[*i].p_type == type) {
+			*phdr = &ctx->phdr[*i];
+			return EL_OK;
+		}
+	}
+
+	*i = -1;
+	return EL_OK;
+}
+
+void elf_release(struct elf_ctx *ctx)
+{
+	if (ctx->phdr) {
+		free(ctx->phdr);
+		ctx->phdr = NULL;
+	}
+}
+
+static uint64_t elf_hdr_sum(struct elf_ctx *ctx)
+{
+	uint64_t sum;
 	unsigned i = 0;
+	Elf_Phdr *ph;
 
-	memset(ctx, 0, sizeof(struct elf_ctx));
+	sum = elf_sum(ELF_SUM_INIT, &ctx->ehdr, sizeof(ctx->ehdr));
 
-	if ((rv = elf_file_read(file, &ctx->ehdr, sizeof(ctx->ehdr), 0)))
-		return rv;
+	for (;;) {
+		elf_findphdr(ctx, &ph, PT_LOAD, &i);
+		if (i == (unsigned) -1)
+			break;
 
-	if (!IS_ELF(ctx->ehdr))
-		return EL_NOTELF;
+		sum = elf_sum(sum, ph, sizeof(Elf_Phdr));
+		i++;
+	}
 
-	if (ctx->ehdr.e_ident[EI_CLASS] != ELFCLASS)
-	        return EL_WRONGBITS;
+	return sum;
+}
+
+/*
+ * hash the content of all the load segments, this reads the
+ * whole image, only called when the file is opened or the
+ * cached sum does not match the executed one.
+ */
+int elf_sum_image(struct elf_ctx *ctx, FILE *file)
+{
+	unsigned i = 0;
+	Elf_Phdr *ph;
+	void *buf;
+	int rv = 0;
+
+	buf = malloc(ELF_SUM_READ_SIZE);
+	if (!buf)
+		return -ENOMEM;
 
-	if (ctx->ehdr.e_ident[EI_DATA] != ELFDATATHIS)
-	        return EL_WRONGENDIAN;
+	ctx->file_sum = ctx->hdr_sum;
 
-	if (ctx->ehdr.e_ident[EI_VERSION] != EV_CURRENT)
-	        return EL_NOTELF;
+	for (;;) {
+		elf_findphdr(ctx, &ph, PT_LOAD, &i);
+		if (i == (unsigned) -1)
+			break;
+
+		rv = elf_sum_segment(ctx, file, ph, buf);
+		if (rv)
+			break;
+		i++;
+	}
+
+	free(buf);
+	return rv;
+}
 
-	if (ctx->ehdr.e_type != ET_EXEC || ctx->ehdr.e_type == ET_DYN)
-	        return EL_NOTEXEC;
+/*
+ * the cheap check of the cached file, return non zero if the
+ * size of the file or its headers are changed.
+ */
+int elf_check(struct elf_ctx *ctx, FILE *file)
+{
+	struct elf_ctx tmp;
+	int changed = 1;
 
-	if (ctx->ehdr.e_machine != EM_THIS)
-	        return EL_WRONGARCH;
+	memset(&tmp, 0, sizeof(struct elf_ctx));
+	tmp.file_size = elf_file_size(file);
+	if (tmp.file_size != ctx->file_size)
+		return 1;
 
-	if (ctx->ehdr.e_version != EV_CURRENT)
-	        return EL_NOTELF;
+	if (elf_read_headers(&tmp, file) == 0)
+		changed = (elf_hdr_sum(&tmp) != ctx->hdr_sum);
+
+	elf_release(&tmp);
+
+	return changed;
+}
+
+int elf_init(struct elf_ctx *ctx, FILE *file)
+{
+	Elf_Addr ro_end = 0, rw_start = (unsigned long)-1;
+	Elf_Addr phend;
+	Elf_Phdr *ph;
+	int rv = EL_OK;
+	unsigned i = 0;
+
+	memset(ctx, 0, sizeof(struct elf_ctx));
+
+	ctx->file_size = elf_file_size(file);
+
+	if ((rv = elf_read_headers(ctx, file)))
+		goto err;
+
+	if (ctx->ehdr.e_ident[EI_CLASS] != ELFCLASS)
+		rv = EL_WRONGBITS;
+	else if (ctx->ehdr.e_ident[EI_DATA] != ELFDATATHIS)
+		rv = EL_WRONGENDIAN;
+	else if (ctx->ehdr.e_ident[EI_VERSION] != EV_CURRENT)
+		rv = EL_NOTELF;
+	else if (ctx->ehdr.e_type != ET_EXEC || ctx->ehdr.e_type == ET_DYN)
+		rv = EL_NOTEXEC;
+	else if (ctx->ehdr.e_machine != EM_THIS)
+		rv = EL_WRONGARCH;
+	else if (ctx->ehdr.e_version != EV_CURRENT)
+		rv = EL_NOTELF;
+	if (rv)
+		goto err;
 
 	/*
 	 * calculate how many memory is needed for this elf file, the
@@ -84,90 +287,135 @@ int elf_init(struct elf_ctx *ctx, FILE *file)
 	ctx->base_load_vbase = (unsigned long)-1;
 
 	for(;;) {
-		if ((rv = elf_findphdr(file, ctx, &ph, PT_LOAD, &i)))
-			return rv;
-
+		elf_findphdr(ctx, &ph, PT_LOAD, &i);
 	        if (i == (unsigned) -1)
 			break;
 
-		if (ph.p_vaddr < ctx->base_load_vbase)
-			ctx->base_load_vbase = ph.p_vaddr;
+		if (ph->p_vaddr < ctx->base_load_vbase)
+			ctx->base_load_vbase = ph->p_vaddr;
 
-	        Elf_Addr phend = ph.p_vaddr + ph.p_memsz;
+	        phend = ph->p_vaddr + ph->p_memsz;
 	        if (phend > ctx->base_load_vend)
 			ctx->base_load_vend = phend;
 
-	        if (ph.p_align > ctx->align)
-			ctx->align = ph.p_align;
+		if (ph->p_vaddr + ph->p_filesz > ctx->file_end)
+			ctx->file_end = ph->p_vaddr + ph->p_filesz;
+
+	        if (ph->p_align > ctx->align)
+			ctx->align = ph->p_align;
+
+		if (ph->p_flags & PF_W) {
+			if (ph->p_vaddr < rw_start)
+				rw_start = ph->p_vaddr;
+		} else if (phend > ro_end) {
+			ro_end = phend;
+		}
+
 		i++;
 	}
 
-	ctx->memsz = PAGE_BALIGN(ctx->base_load_vend - ctx->base_load_vbase);
+	ctx->hdr_sum = elf_hdr_sum(ctx);
+	if ((rv = elf_sum_image(ctx, file)))
+		goto err;
 
-	return rv;
-}
+	ctx->memsz = PAGE_BALIGN(ctx->base_load_vend - ctx->base_load_vbase);
 
-static int elf_load_section(FILE *file, void *vaddr, Elf_Shdr *shdr)
-{
 	/*
-	 * bss section ?
+	 * the read only segments can be shared only when they
+	 * are at the begin of the image and do not share any
+	 * page with the writable segments.
 	 */
-	if (shdr->sh_type == SHT_NOBITS) {
-		pr_debug("bzero elf section [0x%lx 0x%lx 0x%lx %d]\n",
-			shdr->sh_offset, shdr->sh_addr, shdr->sh_size, shdr->sh_type);
-		memset(vaddr, 0, shdr->sh_size);
-		return 0;
-	}
-
-	pr_debug("loading elf section [0x%lx 0x%lx 0x%lx %d]\n",
-			shdr->sh_offset, shdr->sh_addr, shdr->sh_size, shdr->sh_type);
-	elf_file_read(file, vaddr, shdr->sh_size, shdr->sh_offset);
+	if ((ro_end != 0) && IS_PAGE_ALIGN(ctx->base_load_vbase) &&
+			(PAGE_BALIGN(ro_end) <= PAGE_ALIGN(rw_start)))
+		ctx->ro_size = PAGE_BALIGN(ro_end) - ctx->base_load_vbase;
 
 	return 0;
+err:
+	elf_release(ctx);
+	return rv;
 }
 
-static int elf_findshdr(FILE *file, struct elf_ctx *ctx,
-		Elf_Shdr *shdr, unsigned int *i)
+/*
+ * load [start, start + size) of the image to page, the content
+ * which is not backed by the file (bss) is zeroed.
+ *
+ * the load segments are sorted by the virtual address, segments
+ * which keep the same distance between the file offset and the
+ * virtual address are read with one request, then the holes
+ * between them are cleared.
+ */
+int elf_load_range(struct elf_ctx *ctx, FILE *file,
+		void *page, unsigned long start, size_t size)
 {
+	unsigned long end = start + size;
+	unsigned long from, to, pos = start;
+	unsigned long run_from = 0, run_to = 0;
+	Elf_Off run_off = 0, off;
+	unsigned i = 0;
+	Elf_Phdr *ph;
+	int rv;
 
-	int rv = EL_OK;
-	int j = *i;
-
-	for ( ;j < ctx->ehdr.e_shnum; j++) {
-		rv = elf_file_read(file, shdr, sizeof(Elf64_Ehdr), EL_SHOFF(ctx, j));
-		if (rv)
-			return rv;
+	for (;;) {
+		elf_findphdr(ctx, &ph, PT_LOAD, &i);
+		if (i == (unsigned) -1)
+			break;
+		i++;
 
-		if (shdr->sh_flags & SHF_ALLOC) {
-			*i = j;
-			return 0;
+		from = ph->p_vaddr > start ? ph->p_vaddr : start;
+		to = ph->p_vaddr + ph->p_filesz;
+		to = to < end ? to : end;
+		if (from >= to)
+			continue;
+
+		off = ph->p_offset + (from - ph->p_vaddr);
+		if ((run_to != run_from) && (from >= run_to) &&
+				(off - run_off == from - run_from)) {
+			run_to = to;
+			continue;
 		}
-	}
 
-	*i = -1;
-	return rv;
-}
+		if (run_to != run_from) {
+			rv = elf_file_read(file, page + (run_from - start),
+					run_to - run_from, run_off);
+			if (rv)
+				return rv;
+		}
 
-int load_process_from_file(void *page, struct elf_ctx *ctx, FILE *file)
-{
-	int rv = EL_OK;
-	unsigned int i = 0;
-	void *vaddr;
-	Elf_Shdr shdr;
+		run_from = from;
+		run_to = to;
+		run_off = off;
+	}
 
-	for(;;) {
-		if ((rv = elf_findshdr(file, ctx, &shdr, &i)))
+	if (run_to != run_from) {
+		rv = elf_file_read(file, page + (run_from - start),
+				run_to - run_from, run_off);
+		if (rv)
 			return rv;
+	}
 
-		if (i == (unsigned int)-1)
+	/*
+	 * clear the bss and the holes, the hole may be overwritten
+	 * by the coalesced read above.
+	 */
+	for (i = 0; ; i++) {
+		elf_findphdr(ctx, &ph, PT_LOAD, &i);
+		if (i == (unsigned) -1)
 			break;
 
-		vaddr = page + (shdr.sh_addr - ctx->base_load_vbase);
-		rv = elf_load_section(file, vaddr, &shdr);
-		if (rv)
-			return EL_ENOMEM;
-		i++;
+		from = ph->p_vaddr > start ? ph->p_vaddr : start;
+		to = ph->p_vaddr + ph->p_filesz;
+		to = to < end ? to : end;
+		if (from >= to)
+			continue;
+
+		if (from > pos)
+			memset(page + (pos - start), 0, from - pos);
+		if (to > pos)
+			pos = to;
 	}
 
-	return rv;
+	if (end > pos)
+		memset(page + (pos - start), 0, end - pos);
+
+	return 0;
 }
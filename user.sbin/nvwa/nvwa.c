@@ -15,18 +15,38 @@
 #include <minos/kobject.h>
 #include <minos/debug.h>
 #include <minos/proto.h>
+#include <minos/list.h>
 
 #include "elf.h"
 
 static int nvwa_handle;
 
 extern int elf_init(struct elf_ctx *ctx, FILE *file);
-extern int load_process_from_file(void *page, struct elf_ctx *ctx, FILE *file);
+extern void elf_release(struct elf_ctx *ctx);
+extern int elf_check(struct elf_ctx *ctx, FILE *file);
+extern int elf_sum_image(struct elf_ctx *ctx, FILE *file);
+extern int elf_load_range(struct elf_ctx *ctx, FILE *file,
+		void *page, unsigned long start, size_t size);
 
+#define NVWA_REQ_ELF_INFO	0
+#define NVWA_REQ_PAGE_IN	1
+
+/*
+ * NVWA_REQ_ELF_INFO only parse the elf file, the content of
+ * the image is loaded by NVWA_REQ_PAGE_IN when the process
+ * touch it, [start, start + size) of the image is loaded to
+ * the pma. file_size and file_sum are the identity of the file
+ * when it was executed.
+ */
 struct nvwa_proto {
+	int type;
+	int pma_handle;
 	char path[FILENAME_MAX];
 	uint64_t token;
-	int pma_handle;
+	unsigned long start;
+	size_t size;
+	uint64_t file_size;
+	uint64_t file_sum;
 };
 
 static struct nvwa_proto nvwa_proto;
@@ -34,72 +54,177 @@ static struct nvwa_proto nvwa_proto;
 #define MAPPING_BASE 0x100000000
 #define MAPPING_SIZE 0x40000000
 
-static int nvwa_pma_init(int pma_handle, size_t size)
-{
-	return kobject_ctl(pma_handle, KOBJ_PMA_ADD_PAGES, size >> PAGE_SHIFT);
-}
+/*
+ * the page in request will come many times for one elf file
+ * keep the recently used files opened.
+ */
+#define NVWA_MAX_FILES	16
 
-static int unmap_elf_memory(int pma_handle, size_t size)
+struct nvwa_file {
+	char path[FILENAME_MAX];
+	FILE *file;
+	struct elf_ctx ctx;
+	struct list_head list;
+};
+
+static LIST_HEAD(nvwa_file_list);
+static int nvwa_file_cnt;
+
+static void nvwa_file_close(struct nvwa_file *nf)
 {
-	return sys_unmap(-1, pma_handle, MAPPING_BASE, size);
+	list_del(&nf->list);
+	nvwa_file_cnt--;
+	fclose(nf->file);
+	elf_release(&nf->ctx);
+	free(nf);
 }
 
-static int map_elf_memory(int pma_handle, size_t size, int perm)
+static struct nvwa_file *nvwa_file_lookup(const char *path)
 {
-	return sys_map(-1, pma_handle, MAPPING_BASE, size, perm);
+	struct nvwa_file *nf;
+
+	list_for_each_entry(nf, &nvwa_file_list, list) {
+		if (strcmp(nf->path, path) == 0) {
+			list_del(&nf->list);
+			list_add(&nvwa_file_list, &nf->list);
+			return nf;
+		}
+	}
+
+	return NULL;
 }
 
-static int __handle_elf_request(struct nvwa_proto *proto,
-		struct proto *elf_proto)
+static struct nvwa_file *nvwa_file_open(const char *path)
 {
-	int pma_handle = proto->pma_handle;
-	struct elf_ctx ctx;
-	FILE *file = NULL;
+	struct nvwa_file *nf;
 	int ret;
 
-	if (proto->path[FILENAME_MAX - 1] != 0) {
-		ret = -EINVAL;
-		goto out;
+	nf = malloc(sizeof(struct nvwa_file));
+	if (!nf)
+		return NULL;
+
+	nf->file = fopen(path, "r");
+	if (!nf->file) {
+		free(nf);
+		return NULL;
 	}
 
-	file = fopen(proto->path, "r");
-	if (!file)
-		return -EIO;
+	ret = elf_init(&nf->ctx, nf->file);
+	if (ret) {
+		pr_err("parse elf %s failed %d\n", path, ret);
+		fclose(nf->file);
+		free(nf);
+		return NULL;
+	}
 
-	ret = elf_init(&ctx, file);
-	if (ret)
-		goto out;
+	if (nvwa_file_cnt >= NVWA_MAX_FILES)
+		nvwa_file_close(list_entry(nvwa_file_list.pre,
+				struct nvwa_file, list));
+
+	strcpy(nf->path, path);
+	list_add(&nvwa_file_list, &nf->list);
+	nvwa_file_cnt++;
+
+	return nf;
+}
+
+/*
+ * file_sum covers the content of the load segments, it is
+ * calculated when the file is opened, and kept with the cached
+ * file. also check the size of the opened file, the file may be
+ * rewritten after it is cached.
+ */
+static int nvwa_file_changed(struct nvwa_file *nf,
+		struct nvwa_proto *proto)
+{
+	long size;
 
-	if (ctx.memsz > MAPPING_SIZE) {
-		ret = -EINVAL;
-		goto out;
+	if ((nf->ctx.file_size != proto->file_size) ||
+			(nf->ctx.file_sum != proto->file_sum))
+		return 1;
+
+	if (fseek(nf->file, 0, SEEK_END) < 0)
+		return 1;
+
+	size = ftell(nf->file);
+
+	return (size < 0) || ((uint64_t)size != nf->ctx.file_size);
+}
+
+/*
+ * get the cached file, or open and parse it. the headers are
+ * checked when the cached file is used by a new execv, the
+ * full content is hashed again only when they are changed.
+ */
+static struct nvwa_file *nvwa_file_get(const char *path)
+{
+	struct nvwa_file *nf;
+
+	nf = nvwa_file_lookup(path);
+	if (nf && elf_check(&nf->ctx, nf->file)) {
+		nvwa_file_close(nf);
+		nf = NULL;
 	}
 
-	ret = nvwa_pma_init(pma_handle, ctx.memsz);
-	if (ret) {
-		pr_err("init pma failed\n");
-		goto out;
+	return nf ? nf : nvwa_file_open(path);
+}
+
+static struct nvwa_file *nvwa_get_file(struct nvwa_proto *proto)
+{
+	struct nvwa_file *nf;
+
+	nf = nvwa_file_lookup(proto->path);
+	if (!nf)
+		nf = nvwa_file_open(proto->path);
+	if (!nf || !nvwa_file_changed(nf, proto))
+		return nf;
+
+	/*
+	 * the cached file may be stale, hash the file on the disk
+	 * again to check whether it is still the executed one.
+	 */
+	if (elf_check(&nf->ctx, nf->file)) {
+		nvwa_file_close(nf);
+		nf = nvwa_file_open(proto->path);
+	} else if (elf_sum_image(&nf->ctx, nf->file)) {
+		nvwa_file_close(nf);
+		nf = NULL;
 	}
 
-	ret = map_elf_memory(pma_handle, ctx.memsz, KR_RW);
-	if (ret)
-		goto out;
+	if (nf && nvwa_file_changed(nf, proto))
+		return NULL;
 
-	ret = load_process_from_file((void *)MAPPING_BASE, &ctx, file);
-	unmap_elf_memory(pma_handle, ctx.memsz);
-	if (ret)
-		goto out;
+	return nf;
+}
+
+static int __handle_elf_request(struct nvwa_proto *proto,
+		struct proto *elf_proto)
+{
+	struct nvwa_file *nf;
+	struct elf_ctx *ctx;
+
+	if (proto->path[FILENAME_MAX - 1] != 0)
+		return -EINVAL;
+
+	nf = nvwa_file_get(proto->path);
+	if (!nf)
+		return -EIO;
+
+	ctx = &nf->ctx;
+	if (ctx->memsz > MAPPING_SIZE)
+		return -EINVAL;
 
 	elf_proto->elf_info.token = proto->token;
 	elf_proto->elf_info.ret_code = 0;
-	elf_proto->elf_info.elf_base = ctx.base_load_vbase;
-	elf_proto->elf_info.elf_size = ctx.memsz;
-	elf_proto->elf_info.entry = ctx.ehdr.e_entry;
-out:
-	fclose(file);
-	kobject_close(pma_handle);
+	elf_proto->elf_info.elf_base = ctx->base_load_vbase;
+	elf_proto->elf_info.elf_size = ctx->memsz;
+	elf_proto->elf_info.ro_size = ctx->ro_size;
+	elf_proto->elf_info.file_end = ctx->file_end;
+	elf_proto->elf_info.entry = ctx->ehdr.e_entry;
+	elf_proto->elf_info.file_size = ctx->file_size;
+	elf_proto->elf_info.file_sum = ctx->file_sum;
 
-	return ret;
+	return 0;
 }
 
 static void handle_elf_request(struct nvwa_proto *proto)
@@ -108,8 +233,8 @@ static void handle_elf_request(struct nvwa_proto *proto)
 	int ret;
 
 	/*
-	 * after loading the content of the elf, nvwa will return
-	 * the elf information and the PMA handle to pangu.
+	 * nvwa only return the layout of the elf to pangu, the
+	 * content will be paged in when it is accessed.
 	 */
 	ret = __handle_elf_request(proto, &elf_proto);
 	if (ret) {
@@ -123,6 +248,61 @@ static void handle_elf_request(struct nvwa_proto *proto)
 	kobject_write(0, &elf_proto, sizeof(struct proto), NULL, 0, -1);
 }
 
+static int __handle_page_in_request(struct nvwa_proto *proto)
+{
+	int pma_handle = proto->pma_handle;
+	struct nvwa_file *nf;
+	int ret;
+
+	if (proto->path[FILENAME_MAX - 1] != 0)
+		return -EINVAL;
+
+	if ((proto->size > MAPPING_SIZE) || !IS_PAGE_ALIGN(proto->size))
+		return -EINVAL;
+
+	nf = nvwa_get_file(proto);
+	if (!nf)
+		return -ESTALE;
+
+	ret = sys_map(-1, pma_handle, MAPPING_BASE, proto->size, KR_RW);
+	if (ret)
+		return ret;
+
+	ret = elf_load_range(&nf->ctx, nf->file, (void *)MAPPING_BASE,
+			proto->start, proto->size);
+	sys_unmap(-1, pma_handle, MAPPING_BASE, proto->size);
+
+	return ret;
+}
+
+static void handle_page_in_request(struct nvwa_proto *proto)
+{
+	struct proto page_proto;
+
+	memset(&page_proto, 0, sizeof(struct proto));
+	page_proto.proto_id = PROTO_PAGE_IN;
+	page_proto.page_in.token = proto->token;
+	page_proto.page_in.ret_code = __handle_page_in_request(proto);
+	kobject_close(proto->pma_handle);
+
+	kobject_write(0, &page_proto, sizeof(struct proto), NULL, 0, -1);
+}
+
+static void handle_nvwa_request(struct nvwa_proto *proto)
+{
+	switch (proto->type) {
+	case NVWA_REQ_ELF_INFO:
+		handle_elf_request(proto);
+		break;
+	case NVWA_REQ_PAGE_IN:
+		handle_page_in_request(proto);
+		break;
+	default:
+		pr_err("unknown nvwa request %d\n", proto->type);
+		break;
+	}
+}
+
 static int nvwa_loop(void)
 {
 	long token;
@@ -140,7 +320,7 @@ static int nvwa_loop(void)
 		}
 
 		kobject_reply_errcode(nvwa_handle, token, 0);
-		handle_elf_request(&nvwa_proto);
+		handle_nvwa_request(&nvwa_proto);
 	}
 
 	return 0;
@@ -0,0 +1,92 @@
+#ifndef __PANGU_ELF_IMAGE_H__
+#define __PANGU_ELF_IMAGE_H__
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <minos/list.h>
+
+struct process;
+struct proto;
+struct elf_image;
+
+/*
+ * the elf is loaded by nvwa in ELF_CHUNK_SIZE chunks when the
+ * process first touch it, the next chunk is read ahead.
+ */
+#define ELF_CHUNK_PAGES		16
+#define ELF_CHUNK_SIZE		(ELF_CHUNK_PAGES * PAGE_SIZE)
+
+#define ELF_FAULT_PENDING	1
+
+/*
+ * file backed memory region of an elf image, each loaded chunk
+ * has its own pma. [anon_start, end) is not backed by the file
+ * (bss), which is mapped as anon memory.
+ */
+struct file_vma {
+	unsigned long start;
+	unsigned long end;
+	unsigned long anon_start;
+	int perm;
+	int nr_chunks;
+	int *chunks;
+	unsigned char *mapped;
+	struct elf_image *image;
+	struct list_head pending;
+};
+
+/*
+ * the read only part (text and rodata) of an elf file is shared
+ * by all the process loaded from the same file. file_size and
+ * file_sum are the identity of the file which are calculated
+ * by nvwa.
+ */
+struct elf_image {
+	char path[FILENAME_MAX];
+	uint64_t file_size;
+	uint64_t file_sum;
+	unsigned long base;
+	unsigned long size;
+	unsigned long ro_size;
+	unsigned long file_end;
+	struct file_vma ro_vma;
+	int refcnt;
+	struct list_head list;
+};
+
+/*
+ * the request which is sent to nvwa, need keep same with nvwa.
+ */
+#define NVWA_REQ_ELF_INFO	0
+#define NVWA_REQ_PAGE_IN	1
+
+struct nvwa_proto {
+	int type;
+	int pma_handle;
+	char path[FILENAME_MAX];
+	uint64_t token;
+	unsigned long start;
+	size_t size;
+	uint64_t file_size;
+	uint64_t file_sum;
+};
+
+struct elf_image *elf_image_lookup(const char *path,
+		uint64_t file_size, uint64_t file_sum);
+
+struct elf_image *elf_image_create(const char *path,
+		struct proto *proto);
+
+void elf_image_get(struct elf_image *image);
+
+void elf_image_put(struct elf_image *image);
+
+int elf_image_map(struct process *proc, struct elf_image *image);
+
+void elf_image_unmap(struct process *proc);
+
+int elf_page_fault(struct process *proc, unsigned long virt, int right, long token);
+
+long pangu_page_in(struct process *proc, struct proto *proto, void *data);
+
+#endif
@@ -14,6 +14,7 @@
 
 struct process;
 struct proto;
+struct elf_image;
 
 struct vma {
 	unsigned long start;
@@ -64,14 +65,18 @@ struct vma *find_vma(struct process *proc, unsigned long base);
 int create_pma(int type, int right, unsigned long base, size_t size);
 
 int process_mm_init(struct process *proc, int elf_pma,
-		unsigned long elf_base, size_t elf_size);
+		struct elf_image *image, unsigned long elf_base,
+		size_t elf_size);
 
 long pangu_mmap(struct process *proc, struct proto *proto, void *data);
 long pangu_brk(struct process *proc, struct proto *proto, void *data);
 long pangu_mprotect(struct process *proc, struct proto *proto, void *data);
+long pangu_madvise(struct process *proc, struct proto *proto, void *data);
 
 long handle_user_page_fault(struct process *proc,
 		uint64_t virt_addr, unsigned long info, long token);
 
+void page_fault_ack(struct process *proc, int ret, long token);
+
 
 #endif
@@ -6,6 +6,7 @@
 #include <minos/procinfo.h>
 
 #include <pangu/mm.h>
+#include <pangu/elf_image.h>
 
 #define TASK_FLAGS_SRV			BIT(0)
 #define TASK_FLAGS_DRV			BIT(1)
@@ -45,6 +46,15 @@ struct process {
 	struct list_head clist;
 	struct process *parent;
 
+	/*
+	 * the process loaded from the file system map the read
+	 * only part of the elf_image, which is shared with other
+	 * process, and the private writable part elf_rw_vma. the
+	 * process loaded from ramdisk use elf_vma.
+	 */
+	struct elf_image *elf_image;
+	unsigned char *elf_ro_mapped;
+	struct file_vma elf_rw_vma;
 	struct vma elf_vma;
 	struct vma init_stack_vma;
 	struct vma anon_stack_vma;
@@ -104,6 +114,8 @@ void handle_process_request(struct epoll_event *event, struct process *proc);
 
 long pangu_procinfo(struct process *proc, struct proto *proto, void *data);
 long pangu_taskstat(struct process *proc, struct proto *proto, void *data);
+long pangu_ipcstat(struct process *proc, struct proto *proto, void *data);
+long pangu_sysstat(struct process *proc, struct proto *proto, void *data);
 long pangu_proccnt(struct process *proc, struct proto *proto, void *data);
 
 struct process *load_ramdisk_process(char *path,
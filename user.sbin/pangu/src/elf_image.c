@@ -0,0 +1,552 @@
+/*
+ * Copyright (C) 2021 Min Le (lemin9538@gmail.com)
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include <minos/kobject.h>
+#include <minos/debug.h>
+#include <minos/list.h>
+#include <minos/proto.h>
+
+#include <pangu/kmalloc.h>
+#include <pangu/proc.h>
+#include <pangu/mm.h>
+#include <pangu/elf_image.h>
+
+#define ELF_IMAGE_CACHE_MAX	32
+
+struct page_in_waiter {
+	struct process *proc;
+	long token;
+	struct list_head list;
+};
+
+/*
+ * fvma is set to NULL if the file vma is released before
+ * nvwa finish the request.
+ */
+struct page_in_request {
+	uint64_t token;
+	struct file_vma *fvma;
+	int idx;
+	int pma_handle;
+	struct list_head waiters;
+	struct list_head list;
+	struct list_head glist;
+};
+
+/*
+ * the most recently used image is at the head of the list,
+ * each cached image hold one reference, and each process
+ * which is using the image hold another one.
+ */
+static LIST_HEAD(elf_image_list);
+static int elf_image_cnt;
+
+static LIST_HEAD(page_in_list);
+
+static inline unsigned long chunk_start(struct file_vma *fvma, int idx)
+{
+	return fvma->start + (unsigned long)idx * ELF_CHUNK_SIZE;
+}
+
+static inline size_t chunk_size(struct file_vma *fvma, int idx)
+{
+	unsigned long start = chunk_start(fvma, idx);
+	unsigned long end = start + ELF_CHUNK_SIZE;
+
+	if (end > fvma->anon_start)
+		end = fvma->anon_start;
+
+	return end - start;
+}
+
+static int file_vma_init(struct file_vma *fvma, struct elf_image *image,
+		unsigned long start, unsigned long end,
+		unsigned long anon_start, int perm, int private)
+{
+	fvma->start = start;
+	fvma->end = end;
+	fvma->anon_start = anon_start;
+	fvma->perm = perm;
+	fvma->image = image;
+	fvma->nr_chunks = (anon_start - start + ELF_CHUNK_SIZE - 1) / ELF_CHUNK_SIZE;
+	init_list(&fvma->pending);
+
+	if (fvma->nr_chunks == 0)
+		return 0;
+
+	fvma->chunks = kzalloc(sizeof(int) * fvma->nr_chunks);
+	if (!fvma->chunks)
+		return -ENOMEM;
+
+	if (private) {
+		fvma->mapped = kzalloc(fvma->nr_chunks);
+		if (!fvma->mapped) {
+			kfree(fvma->chunks);
+			fvma->chunks = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static void file_vma_release(struct file_vma *fvma)
+{
+	struct page_in_request *req;
+	int i;
+
+	/*
+	 * the request which is still in processing will be freed
+	 * when nvwa reply it.
+	 */
+	list_for_each_entry(req, &fvma->pending, list)
+		req->fvma = NULL;
+
+	for (i = 0; i < fvma->nr_chunks; i++) {
+		if (fvma->chunks[i] > 0)
+			kobject_close(fvma->chunks[i]);
+	}
+
+	if (fvma->chunks)
+		kfree(fvma->chunks);
+	if (fvma->mapped)
+		kfree(fvma->mapped);
+
+	fvma->chunks = NULL;
+	fvma->mapped = NULL;
+	fvma->nr_chunks = 0;
+}
+
+void elf_image_get(struct elf_image *image)
+{
+	image->refcnt++;
+}
+
+void elf_image_put(struct elf_image *image)
+{
+	if (--image->refcnt > 0)
+		return;
+
+	/*
+	 * all the process has unmapped this image, close the
+	 * pma handles will release the memory.
+	 */
+	file_vma_release(&image->ro_vma);
+	kfree(image);
+}
+
+static void elf_image_evict(struct elf_image *image)
+{
+	list_del(&image->list);
+	elf_image_cnt--;
+	elf_image_put(image);
+}
+
+static void elf_image_shrink(void)
+{
+	struct elf_image *image, *victim;
+
+	/*
+	 * evict the least recently used image which is not used
+	 * by any process.
+	 */
+	while (elf_image_cnt > ELF_IMAGE_CACHE_MAX) {
+		victim = NULL;
+		list_for_each_entry(image, &elf_image_list, list) {
+			if (image->refcnt == 1)
+				victim = image;
+		}
+
+		if (!victim)
+			break;
+
+		elf_image_evict(victim);
+	}
+}
+
+struct elf_image *elf_image_lookup(const char *path,
+		uint64_t file_size, uint64_t file_sum)
+{
+	struct elf_image *image;
+
+	list_for_each_entry(image, &elf_image_list, list) {
+		if (strcmp(image->path, path) != 0)
+			continue;
+
+		if ((image->file_size != file_size) ||
+				(image->file_sum != file_sum))
+			return NULL;
+
+		list_del(&image->list);
+		list_add(&elf_image_list, &image->list);
+		elf_image_get(image);
+
+		return image;
+	}
+
+	return NULL;
+}
+
+struct elf_image *elf_image_create(const char *path, struct proto *proto)
+{
+	struct proto_elf_info *info = &proto->elf_info;
+	struct elf_image *image, *tmp;
+	unsigned long ro_end;
+
+	if (strlen(path) >= FILENAME_MAX)
+		return NULL;
+
+	image = kzalloc(sizeof(struct elf_image));
+	if (!image)
+		return NULL;
+
+	strcpy(image->path, path);
+	image->base = PAGE_ALIGN(info->elf_base);
+	image->size = PAGE_BALIGN(info->elf_base + info->elf_size) - image->base;
+	image->ro_size = info->ro_size;
+	image->file_end = info->file_end;
+	image->file_size = info->file_size;
+	image->file_sum = info->file_sum;
+
+	ro_end = image->base + image->ro_size;
+	if (file_vma_init(&image->ro_vma, image, image->base,
+				ro_end, ro_end, KR_RX, 0)) {
+		kfree(image);
+		return NULL;
+	}
+
+	/*
+	 * one reference for the cache and one for the caller. if
+	 * the file has been changed, the old image is removed from
+	 * the cache, it will be released when all the process
+	 * using it exit.
+	 */
+	image->refcnt = 2;
+
+	list_for_each_entry(tmp, &elf_image_list, list) {
+		if (strcmp(tmp->path, path) == 0) {
+			elf_image_evict(tmp);
+			break;
+		}
+	}
+
+	list_add(&elf_image_list, &image->list);
+	elf_image_cnt++;
+	elf_image_shrink();
+
+	return image;
+}
+
+static unsigned char *chunk_mapped(struct process *proc, struct file_vma *fvma)
+{
+	return fvma->mapped ? fvma->mapped : proc->elf_ro_mapped;
+}
+
+static int file_vma_map_chunk(struct process *proc,
+		struct file_vma *fvma, int idx)
+{
+	unsigned char *mapped = chunk_mapped(proc, fvma);
+	int ret;
+
+	/*
+	 * the chunk may be mapped by another thread's page
+	 * fault of this process.
+	 */
+	if (mapped[idx])
+		return 0;
+
+	ret = sys_map(proc->proc_handle, fvma->chunks[idx],
+			chunk_start(fvma, idx), chunk_size(fvma, idx),
+			fvma->perm);
+	if (ret == 0)
+		mapped[idx] = 1;
+
+	return ret;
+}
+
+static struct page_in_request *page_in_request(struct file_vma *fvma, int idx)
+{
+	struct elf_image *image = fvma->image;
+	static uint64_t page_in_token;
+	struct page_in_request *req;
+	struct nvwa_proto proto;
+	size_t size = chunk_size(fvma, idx);
+	int ret;
+
+	req = kzalloc(sizeof(struct page_in_request));
+	if (!req)
+		return NULL;
+
+	req->pma_handle = create_pma(PMA_TYPE_NORMAL, KR_RWX, 0, size);
+	if (req->pma_handle <= 0)
+		goto out_free_req;
+
+	proto.pma_handle = grant(nvwa_proc->proc_handle, req->pma_handle, KR_RWC);
+	if (proto.pma_handle <= 0)
+		goto out_close_pma;
+
+	proto.type = NVWA_REQ_PAGE_IN;
+	proto.token = req->token = page_in_token++;
+	proto.start = chunk_start(fvma, idx);
+	proto.size = size;
+	proto.file_size = image->file_size;
+	proto.file_sum = image->file_sum;
+	strcpy(proto.path, image->path);
+
+	ret = kobject_write(nvwa_handle, &proto,
+			sizeof(struct nvwa_proto), NULL, 0, 2000);
+	if (ret)
+		goto out_close_pma;
+
+	req->fvma = fvma;
+	req->idx = idx;
+	init_list(&req->waiters);
+	list_add_tail(&fvma->pending, &req->list);
+	list_add_tail(&page_in_list, &req->glist);
+
+	return req;
+
+out_close_pma:
+	kobject_close(req->pma_handle);
+out_free_req:
+	kfree(req);
+	return NULL;
+}
+
+static struct page_in_request *find_page_in_request(struct file_vma *fvma, int idx)
+{
+	struct page_in_request *req;
+
+	list_for_each_entry(req, &fvma->pending, list) {
+		if (req->idx == idx)
+			return req;
+	}
+
+	return NULL;
+}
+
+static int page_in_wait(struct process *proc, struct file_vma *fvma,
+		int idx, long token)
+{
+	struct page_in_request *req;
+	struct page_in_waiter *waiter;
+
+	waiter = kzalloc(sizeof(struct page_in_waiter));
+	if (!waiter)
+		return -ENOMEM;
+
+	req = find_page_in_request(fvma, idx);
+	if (!req) {
+		req = page_in_request(fvma, idx);
+		if (!req) {
+			kfree(waiter);
+			return -ENOMEM;
+		}
+	}
+
+	waiter->proc = proc;
+	waiter->token = token;
+	list_add_tail(&req->waiters, &waiter->list);
+
+	return 0;
+}
+
+static void page_in_readahead(struct file_vma *fvma, int idx)
+{
+	if ((idx >= fvma->nr_chunks) || (fvma->chunks[idx] > 0))
+		return;
+
+	if (find_page_in_request(fvma, idx))
+		return;
+
+	page_in_request(fvma, idx);
+}
+
+int elf_page_fault(struct process *proc, unsigned long virt, int right, long token)
+{
+	struct elf_image *image = proc->elf_image;
+	struct file_vma *fvma;
+	int idx, ret;
+
+	if (!image)
+		return -ENOENT;
+
+	if ((virt >= image->ro_vma.start) && (virt < image->ro_vma.end))
+		fvma = &image->ro_vma;
+	else if ((virt >= proc->elf_rw_vma.start) && (virt < proc->elf_rw_vma.end))
+		fvma = &proc->elf_rw_vma;
+	else
+		return -ENOENT;
+
+	if ((right & fvma->perm) != right)
+		return -EPERM;
+
+	if (virt >= fvma->anon_start)
+		return sys_map(proc->proc_handle, -1, virt, PAGE_SIZE, fvma->perm);
+
+	idx = (virt - fvma->start) / ELF_CHUNK_SIZE;
+	if (fvma->chunks[idx] > 0)
+		return file_vma_map_chunk(proc, fvma, idx);
+
+	ret = page_in_wait(proc, fvma, idx, token);
+	if (ret)
+		return ret;
+
+	/*
+	 * the code and data are usually accessed in sequence, read
+	 * the next chunk ahead.
+	 */
+	page_in_readahead(fvma, idx + 1);
+
+	return ELF_FAULT_PENDING;
+}
+
+static void page_in_done(struct page_in_request *req, int ret_code)
+{
+	struct file_vma *fvma = req->fvma;
+	struct page_in_waiter *waiter, *tmp;
+	int ret;
+
+	if (fvma) {
+		list_del(&req->list);
+		if (ret_code == 0)
+			fvma->chunks[req->idx] = req->pma_handle;
+	}
+
+	if (!fvma || ret_code)
+		kobject_close(req->pma_handle);
+
+	list_for_each_entry_safe(waiter, tmp, &req->waiters, list) {
+		if (fvma && (ret_code == 0))
+			ret = file_vma_map_chunk(waiter->proc, fvma, req->idx);
+		else
+			ret = ret_code ? ret_code : -EIO;
+
+		page_fault_ack(waiter->proc, ret, waiter->token);
+		list_del(&waiter->list);
+		kfree(waiter);
+	}
+
+	kfree(req);
+}
+
+long pangu_page_in(struct process *proc, struct proto *proto, void *data)
+{
+	struct page_in_request *req;
+
+	if (proc != nvwa_proc) {
+		pr_err("not nvwa proc\n");
+		return kobject_reply_errcode(proc->proc_handle, proto->token, -EPERM);
+	}
+
+	kobject_reply_errcode(proc->proc_handle, proto->token, 0);
+
+	list_for_each_entry(req, &page_in_list, glist) {
+		if (req->token != proto->page_in.token)
+			continue;
+
+		if (proto->page_in.ret_code)
+			pr_err("nvwa page in failed %d\n", proto->page_in.ret_code);
+
+		list_del(&req->glist);
+		page_in_done(req, proto->page_in.ret_code);
+
+		return 0;
+	}
+
+	pr_err("page in request 0x%lx not found\n", proto->page_in.token);
+	return -ENOENT;
+}
+
+int elf_image_map(struct process *proc, struct elf_image *image)
+{
+	unsigned long start = image->base + image->ro_size;
+	unsigned long end = image->base + image->size;
+	unsigned long anon_start;
+	int ret;
+
+	/*
+	 * if the image can not be split, the whole image is
+	 * private and need to be executable.
+	 */
+	anon_start = PAGE_BALIGN(image->file_end);
+	anon_start = anon_start < start ? start : anon_start;
+	anon_start = anon_start > end ? end : anon_start;
+
+	ret = file_vma_init(&proc->elf_rw_vma, image, start, end, anon_start,
+			image->ro_size ? KR_RW : KR_RWX, 1);
+	if (ret)
+		return ret;
+
+	if (image->ro_vma.nr_chunks) {
+		proc->elf_ro_mapped = kzalloc(image->ro_vma.nr_chunks);
+		if (!proc->elf_ro_mapped) {
+			file_vma_release(&proc->elf_rw_vma);
+			return -ENOMEM;
+		}
+	}
+
+	elf_image_get(image);
+	proc->elf_image = image;
+
+	return 0;
+}
+
+static void page_in_cancel(struct process *proc, struct file_vma *fvma)
+{
+	struct page_in_waiter *waiter, *tmp;
+	struct page_in_request *req;
+
+	list_for_each_entry(req, &fvma->pending, list) {
+		list_for_each_entry_safe(waiter, tmp, &req->waiters, list) {
+			if (waiter->proc != proc)
+				continue;
+
+			list_del(&waiter->list);
+			kfree(waiter);
+		}
+	}
+}
+
+void elf_image_unmap(struct process *proc)
+{
+	struct elf_image *image = proc->elf_image;
+	struct file_vma *fvma;
+	int i;
+
+	if (!image)
+		return;
+
+	fvma = &image->ro_vma;
+	page_in_cancel(proc, fvma);
+	page_in_cancel(proc, &proc->elf_rw_vma);
+
+	/*
+	 * the chunks of the image are shared with other process,
+	 * unmap them from this process one by one, the private
+	 * chunks will be unmapped when the pma is closed.
+	 */
+	for (i = 0; i < fvma->nr_chunks; i++) {
+		if (!proc->elf_ro_mapped[i])
+			continue;
+
+		sys_unmap(proc->proc_handle, fvma->chunks[i],
+				chunk_start(fvma, i), chunk_size(fvma, i));
+	}
+
+	file_vma_release(&proc->elf_rw_vma);
+	if (proc->elf_ro_mapped)
+		kfree(proc->elf_ro_mapped);
+
+	proc->elf_ro_mapped = NULL;
+	proc->elf_image = NULL;
+	elf_image_put(image);
+}
@@ -19,6 +19,7 @@
 #include <pangu/kmalloc.h>
 #include <pangu/proc.h>
 #include <pangu/mm.h>
+#include <pangu/elf_image.h>
 
 #define vma_init(vma, _base, _end)	\
 	do {				\
@@ -341,33 +342,75 @@ out:
 	return kobject_reply_errcode(proc->proc_handle, proto->token, ret);
 }
 
-static int get_fault_addr(struct process *proc, unsigned long virt, int *perm)
+/*
+ * check the range is inside the stack, heap or an anon
+ * mmap region, these memory is mapped on demand.
+ */
+static int get_anon_range(struct process *proc, unsigned long start,
+		unsigned long end, int *perm)
 {
 	struct vma *vma;
 
-	/*
-	 * check the address is stack or heap or mmap.
-	 */
-	if ((virt >= proc->brk_start) && (virt < proc->brk_cur)) {
+	if ((start >= proc->brk_start) && (end <= PAGE_BALIGN(proc->brk_cur))) {
 		*perm = KR_RWX;
 		return 0;
 	}
 
 	vma = &proc->anon_stack_vma;
-	if ((virt >= vma->start) && (virt < vma->end)) {
+	if ((start >= vma->start) && (end <= vma->end)) {
 		*perm = vma->perm;
-		return virt;
+		return 0;
 	}
 
-	vma = find_vma(proc, virt);
-	if (!vma || !vma->anon)
+	vma = find_vma(proc, start);
+	if (!vma || !vma->anon || (end > vma->end))
 		return -ENOENT;
 	*perm = vma->perm;
 
 	return 0;
 }
 
-static void page_fault_ack(struct process *proc, int ret, long token)
+long pangu_madvise(struct process *proc, struct proto *proto, void *data)
+{
+	unsigned long start = (unsigned long)proto->madvise.addr;
+	unsigned long end = start + proto->madvise.len;
+	int ret, perm;
+
+	if (!IS_PAGE_ALIGN(start) || !IS_PAGE_ALIGN(end) || (end <= start)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = get_anon_range(proc, start, end, &perm);
+	if (ret) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	switch (proto->madvise.advice) {
+	case MADV_DONTNEED:
+	case MADV_FREE:
+		/*
+		 * the kernel flush the tlb for the whole range then
+		 * free the pages, the next access will fault in a zero
+		 * page. there is no dirty tracking for the page, so
+		 * MADV_FREE can not be deferred safely and discards the
+		 * pages at once.
+		 */
+		ret = sys_unmap(proc->proc_handle, -1, start, end - start);
+		break;
+	case MADV_WILLNEED:
+		ret = sys_map(proc->proc_handle, -1, start, end - start, perm);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+out:
+	return kobject_reply_errcode(proc->proc_handle, proto->token, ret);
+}
+
+void page_fault_ack(struct process *proc, int ret, long token)
 {
 	/*
 	 * if the page fault handle is fail the process will
@@ -384,7 +427,21 @@ long handle_user_page_fault(struct process *proc, uint64_t virt_addr,
 	unsigned long start = PAGE_ALIGN(virt_addr);
 	int ret, perm = 0, right = info & KOBJ_RIGHT_MASK;
 
-	ret = get_fault_addr(proc, start, &perm);
+	/*
+	 * the fault in the elf image may need to wait nvwa to
+	 * load the content, the fault will be acked later.
+	 */
+	ret = elf_page_fault(proc, start, right, token);
+	if (ret == ELF_FAULT_PENDING)
+		return 0;
+	if (ret != -ENOENT) {
+		if (ret)
+			pr_err("P%d elf page fault 0x%lx failed %d\n",
+					proc_pid(proc), virt_addr, ret);
+		goto out;
+	}
+
+	ret = get_anon_range(proc, start, start + PAGE_SIZE, &perm);
 	if (ret) {
 		pr_err("can not get fault address 0x%lx for %d\n",
 				virt_addr, proc_pid(proc));
@@ -438,10 +495,17 @@ void vspace_init(struct process *proc, unsigned long elf_end)
 }
 
 static int elf_vma_init(struct process *proc, int elf_pma,
-		unsigned long ebase, size_t esize)
+		struct elf_image *image, unsigned long ebase, size_t esize)
 {
 	struct vma *vma = &proc->elf_vma;
 
+	/*
+	 * the elf loaded from the file system is paged in by
+	 * nvwa when the process touch it.
+	 */
+	if (image)
+		return elf_image_map(proc, image);
+
 	vma->start = ebase;
 	vma->end = ebase + esize;
 	vma->anon = 0;
@@ -491,11 +555,12 @@ static int stack_vma_init(struct process *proc)
 }
 
 int process_mm_init(struct process *proc, int elf_pma,
-		unsigned long elf_base, size_t elf_size)
+		struct elf_image *image, unsigned long elf_base,
+		size_t elf_size)
 {
 	vspace_init(proc, elf_base + elf_size);
 
-	if (elf_vma_init(proc, elf_pma, elf_base, elf_size)) {
+	if (elf_vma_init(proc, elf_pma, image, elf_base, elf_size)) {
 		pr_err("init elf vma for process failed\n");
 		return -ENOMEM;
 	}
@@ -43,7 +43,9 @@ extern void ramdisk_init(unsigned long base, unsigned long end);
 extern void of_init(unsigned long base, unsigned long end);
 extern void pangu_main(void);
 extern void procfs_init(void);
-extern void procinfo_init(int max_proc, int t);
+extern void procinfo_init(int max_proc, int t, int i, int s);
+extern void ipcstat_init(void);
+extern void sysstat_init(void);
 
 static struct bootdata *bootdata;
 static char *rootfs_default = "rootfs.drv";
@@ -138,6 +140,8 @@ static void dump_boot_info(void)
 
 	pr_info("sys max proc %d\n", bootdata->max_proc);
 	pr_info("task_stat %d\n", bootdata->task_stat_handle);
+	pr_info("ipc_stat %d\n", bootdata->ipc_stat_handle);
+	pr_info("sys_stat %d\n", bootdata->sys_stat_handle);
 }
 
 static int start_and_wait_process(const char *name, struct process *proc)
@@ -305,8 +309,11 @@ int main(int argc, char **argv)
 
 	ramdisk_init(bootdata->ramdisk_start, bootdata->ramdisk_end);
 	of_init(bootdata->dtb_start, bootdata->dtb_end);
-	procinfo_init(bootdata->max_proc, bootdata->task_stat_handle);
+	procinfo_init(bootdata->max_proc, bootdata->task_stat_handle,
+			bootdata->ipc_stat_handle, bootdata->sys_stat_handle);
 	self_init(0, bootdata->vmap_start, bootdata->vmap_end);
+	ipcstat_init();
+	sysstat_init();
 
 	/*
 	 * create the epoll fd for pangu, pangu will use this handle
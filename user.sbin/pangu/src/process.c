@@ -24,9 +24,9 @@
 #include <pangu/ramdisk.h>
 #include <pangu/elf.h>
 #include <pangu/mm.h>
+#include <pangu/elf_image.h>
 
 struct execv_request {
-	int pma_handle;
 	char *name;
 	struct process *parent;
 	uint64_t token;
@@ -35,12 +35,6 @@ struct execv_request {
 	struct list_head list;
 };
 
-struct nvwa_proto {
-	char path[FILENAME_MAX];
-	uint64_t token;
-	int pma_handle;
-};
-
 static LIST_HEAD(execv_request_list);
 static char proto_buf[PAGE_SIZE];
 static char argv_buf[512];
@@ -72,8 +66,8 @@ static int sys_create_process(int pid, unsigned long entry,
 
 static struct process *create_new_process(char *name,
 		struct process *parent, unsigned long entry,
-		int elf_pma, unsigned long elf_base,
-		size_t elf_size, int flags)
+		int elf_pma, struct elf_image *image,
+		unsigned long elf_base, size_t elf_size, int flags)
 {
 	struct process *proc;
 	int pid;
@@ -95,7 +89,7 @@ static struct process *create_new_process(char *name,
 		return NULL;
 	}
 
-	if (process_mm_init(proc, elf_pma, elf_base, elf_size))
+	if (process_mm_init(proc, elf_pma, image, elf_base, elf_size))
 		goto err_out;
 
 	if (name)
@@ -381,7 +375,7 @@ struct process *load_ramdisk_process(char *path,
 	if (ret)
 		return NULL;
 
-	proc = create_new_process(path, self, ctx.ehdr.e_entry, 0,
+	proc = create_new_process(path, self, ctx.ehdr.e_entry, 0, NULL,
 			ctx.base_load_vbase, ctx.memsz, flags);
 	if (!proc)
 		return NULL;
@@ -470,7 +464,10 @@ static void proc_mm_deinit(struct process *proc)
 		kfree(vma);
 	}
 
-	kobject_close(proc->elf_vma.pma_handle);
+	elf_image_unmap(proc);
+
+	if (proc->elf_vma.pma_handle > 0)
+		kobject_close(proc->elf_vma.pma_handle);
 	kobject_close(proc->init_stack_vma.pma_handle);
 }
 
@@ -601,7 +598,7 @@ static inline struct execv_request *alloc_execv_request(void *data)
 static inline void free_execv_request(struct execv_request *er)
 {
 	free_pages(er->data);
-	free(er);
+	kfree(er);
 }
 
 static int send_elf_load_request(struct process *proc, const char *path, struct execv_request *er)
@@ -611,20 +608,11 @@ static int send_elf_load_request(struct process *proc, const char *path, struct
 	int ret;
 
 	/*
-	 * create an empty PMA handle for the target process, then
-	 * grant the pma handle to the nvwa process, so that nvwa
-	 * can allocate memory for the elf file.
+	 * nvwa will only parse the elf file and reply the layout
+	 * of the image, the content is paged in on demand.
 	 */
-	er->pma_handle = create_pma(PMA_TYPE_NORMAL, KR_RWX, 0, 0);
-	if (er->pma_handle <= 0)
-		return er->pma_handle;
-
-	proto.pma_handle = grant(nvwa_proc->proc_handle, er->pma_handle, KR_RWC);
-	if (proto.pma_handle <= 0) {
-		kobject_close(er->pma_handle);
-		return proto.pma_handle;
-	}
-
+	memset(&proto, 0, sizeof(struct nvwa_proto));
+	proto.type = NVWA_REQ_ELF_INFO;
 	strcpy(proto.path, path);
 	er->parent = proc;
 	er->token = proto.token = nvwa_token++;
@@ -736,18 +724,43 @@ static void handle_process_kernel_request(struct process *proc, struct epoll_eve
 	}
 }
 
+static struct elf_image *get_execv_image(struct proto *proto,
+		struct execv_request *er)
+{
+	struct proto_elf_info *info = &proto->elf_info;
+	struct execv_extra *extra = er->data;
+	struct elf_image *image;
+
+	/*
+	 * reuse the cached image if the file is not changed, then
+	 * the chunks which have been loaded can be shared.
+	 */
+	image = elf_image_lookup(extra->path, info->file_size, info->file_sum);
+	if (image)
+		return image;
+
+	return elf_image_create(extra->path, proto);
+}
+
 static int __do_execv(struct proto *proto, struct execv_request *er)
 {
 	struct execv_extra *extra = er->data;
 	int i, ret = -EINVAL, flags;
+	struct elf_image *image;
 	struct process *new;
 	char *string;
 	char **argv;
 
-	argv = kzalloc(sizeof(char *) * extra->argc);
-	if (!argv)
+	image = get_execv_image(proto, er);
+	if (!image)
 		return -ENOMEM;
 
+	argv = kzalloc(sizeof(char *) * extra->argc);
+	if (!argv) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
 	/*
 	 * only chiyou service can load the driver process
 	 * now.
@@ -766,23 +779,33 @@ static int __do_execv(struct proto *proto, struct execv_request *er)
 		pr_debug("argv %d is 0x%p\n", i, argv[i]);
 	}
 
+	/*
+	 * the process will take its own reference of the image.
+	 */
 	new = create_new_process(extra->path, er->parent, proto->elf_info.entry,
-			er->pma_handle, proto->elf_info.elf_base,
+			0, image, proto->elf_info.elf_base,
 			proto->elf_info.elf_size, flags);
-	if (!new)
-		return -ENOMEM;
+	if (!new) {
+		ret = -ENOMEM;
+		goto out_free_argv;
+	}
 
 	ret = setup_process(new, extra->path, extra->argc, argv, flags);
 	if (ret) {
 		release_process(new);
-		return ret;
+		goto out_free_argv;
 	}
 
 	register_request_entry(new->proc_handle, new);
 	wakeup_process(new);
+	ret = new->pid;
+
+out_free_argv:
 	kfree(argv);
+out:
+	elf_image_put(image);
 
-	return new->pid;
+	return ret;
 }
 
 static int do_execv(struct proto *proto, struct execv_request *er)
@@ -805,6 +828,7 @@ static int do_execv(struct proto *proto, struct execv_request *er)
 static long pangu_elf_info(struct process *proc, struct proto *proto, void *data)
 {
 	struct execv_request *er, *next;
+	long ret;
 
 	/*
 	 * reply nvwa service.
@@ -828,10 +852,14 @@ static long pangu_elf_info(struct process *proc, struct proto *proto, void *data
 			pr_err("nvwa load elf failed\n");
 			kobject_reply_errcode(er->parent->proc_handle,
 					er->reply_token, proto->elf_info.ret_code);
+			free_execv_request(er);
 			return -EPERM;
 		}
 
-		return do_execv(proto, er);
+		ret = do_execv(proto, er);
+		free_execv_request(er);
+
+		return ret;
 	}
 
 	pr_err("handle_nvwa_request fail no such request\n");
@@ -893,6 +921,10 @@ static syscall_hdl proc_syscall_handles[] = {
 	[PROTO_TASKSTAT_ID]	= pangu_taskstat,
 	[PROTO_MPROTECT_ID]	= pangu_mprotect,
 	[PROTO_WAITPID_ID]	= pangu_waitpid,
+	[PROTO_PAGE_IN_ID]	= pangu_page_in,
+	[PROTO_MADVISE_ID]	= pangu_madvise,
+	[PROTO_IPCSTAT_ID]	= pangu_ipcstat,
+	[PROTO_SYSSTAT_ID]	= pangu_sysstat,
 };
 
 static void handle_process_in_request(struct process *proc, struct epoll_event *event)
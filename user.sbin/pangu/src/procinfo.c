@@ -31,6 +31,10 @@ static unsigned char *bitmap;
 static int proc_bytes;
 
 static int ktask_stat_handle;
+static int kipc_stat_handle;
+static int ksys_stat_handle;
+static struct ipc_trace_ring *kipc_trace_ring;
+static struct syscall_stat_header *ksys_stat_header;
 
 int8_t const ffs_one_table[256] = { 
         -1, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, /* 0x00 to 0x0F */
@@ -68,10 +72,62 @@ int alloc_pid(void)
 	return -1;
 }
 
-void procinfo_init(int max_proc, int ktask_handle)
+/*
+ * the ipc stat memory is only writable by the root service, the
+ * others can only ask it to turn the trace on and off.
+ */
+void ipcstat_init(void)
+{
+	size_t size = IPC_TRACE_OFFSET + sizeof(struct ipc_trace_ring);
+	void *addr;
+
+	if (kipc_stat_handle <= 0)
+		return;
+
+	addr = map_self_memory(kipc_stat_handle,
+			PAGE_BALIGN(size), KOBJ_RIGHT_RW);
+	if (!addr) {
+		pr_err("map ipc stat memory failed\n");
+		return;
+	}
+
+	kipc_trace_ring = addr + IPC_TRACE_OFFSET;
+}
+
+/*
+ * the size of the syscall stat memory depends on the number of
+ * cpus, map the header first to get it.
+ */
+void sysstat_init(void)
+{
+	struct syscall_stat_header *hdr;
+	size_t size;
+
+	if (ksys_stat_handle <= 0)
+		return;
+
+	hdr = map_self_memory(ksys_stat_handle, PAGE_SIZE, KOBJ_RIGHT_RW);
+	if (!hdr) {
+		pr_err("map syscall stat memory failed\n");
+		return;
+	}
+
+	size = SYSCALL_STAT_OFFSET + SYSCALL_STAT_CPU_SIZE * hdr->nr_cpus;
+	unmap_self_memory(hdr);
+
+	ksys_stat_header = map_self_memory(ksys_stat_handle,
+			PAGE_BALIGN(size), KOBJ_RIGHT_RW);
+	if (!ksys_stat_header)
+		pr_err("map syscall stat memory failed\n");
+}
+
+void procinfo_init(int max_proc, int ktask_handle,
+		int kipc_handle, int ksys_handle)
 {
 	proc_cnt = max_proc;
 	ktask_stat_handle = ktask_handle;
+	kipc_stat_handle = kipc_handle;
+	ksys_stat_handle = ksys_handle;
 	proc_bytes = proc_cnt / 8;
 
 	bitmap = kmalloc(proc_bytes);
@@ -98,6 +154,67 @@ long pangu_taskstat(struct process *proc, struct proto *proto, void *data)
 			proto->token, ktask_stat_handle, KR_RM);
 }
 
+long pangu_ipcstat(struct process *proc, struct proto *proto, void *data)
+{
+	long ret = 0;
+
+	if (!kipc_trace_ring)
+		return kobject_reply_errcode(proc->proc_handle,
+				proto->token, -ENOENT);
+
+	switch (proto->stat.op) {
+	case PROTO_STAT_HANDLE:
+		return kobject_reply_handle(proc->proc_handle,
+				proto->token, kipc_stat_handle, KR_RM);
+	case PROTO_STAT_ON:
+		kipc_trace_ring->enabled = 1;
+		break;
+	case PROTO_STAT_OFF:
+		kipc_trace_ring->enabled = 0;
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	return kobject_reply_errcode(proc->proc_handle, proto->token, ret);
+}
+
+/*
+ * the kernel may update the table at the same time, turn it off
+ * before reset to get a clean result.
+ */
+long pangu_sysstat(struct process *proc, struct proto *proto, void *data)
+{
+	struct syscall_stat_header *hdr = ksys_stat_header;
+	long ret = 0;
+
+	if (!hdr)
+		return kobject_reply_errcode(proc->proc_handle,
+				proto->token, -ENOENT);
+
+	switch (proto->stat.op) {
+	case PROTO_STAT_HANDLE:
+		return kobject_reply_handle(proc->proc_handle,
+				proto->token, ksys_stat_handle, KR_RM);
+	case PROTO_STAT_ON:
+		hdr->enabled = 1;
+		break;
+	case PROTO_STAT_OFF:
+		hdr->enabled = 0;
+		break;
+	case PROTO_STAT_RESET:
+		memset(syscall_stat_table(hdr, 0), 0,
+				SYSCALL_STAT_CPU_SIZE * hdr->nr_cpus);
+		break;
+	default:
+		ret = -EINVAL;
+		break;
+	}
+
+	return kobject_reply_errcode(proc->proc_handle, proto->token, ret);
+}
+
 long pangu_proccnt(struct process *proc, struct proto *proto, void *data)
 {
 	return kobject_reply_errcode(proc->proc_handle, proto->token, proc_cnt);